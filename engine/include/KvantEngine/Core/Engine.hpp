@@ -15,6 +15,7 @@
 #include <KvantEngine/Core/StateManager.hpp>
 #include <KvantEngine/Core/Window.hpp>
 #include <KvantEngine/imgui/imgui_impl_sdl_gl3.h>
+#include <KvantEngine/util/ThreadPool.hpp>
 
 namespace Kvant {
 
@@ -28,6 +29,7 @@ namespace Kvant {
     bool show_imgui_debug {false};
     bool show_node_tree {false};
     bool show_inspector {false};
+    bool show_gpu_memory {false};
   };
 
   class Engine {
@@ -42,6 +44,7 @@ namespace Kvant {
     StateManager& get_state_manager () { return m_state_manager; }
     Window& get_window () { return m_window; }
     Logger& get_logger () { return m_log; }
+    ThreadPool& get_thread_pool () { return m_thread_pool; }
 
     ImGuiState& get_imgui_state() { return m_imgui_state; }
 
@@ -58,6 +61,7 @@ namespace Kvant {
     Window m_window;
     StateManager m_state_manager;
     Logger m_log;
+    ThreadPool m_thread_pool;
 
     bool m_running {true};
     ImGuiState m_imgui_state;
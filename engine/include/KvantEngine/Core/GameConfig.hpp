@@ -25,7 +25,16 @@ namespace Kvant {
   struct ResourcesConfig : public BaseConfig {
     static const std::string get_yaml_id () { return "resources"; }
     
-    std::string textures_path, shaders_path;
+    std::string textures_path, shaders_path, materials_path;
+
+    // Linked program binaries, empty disables the cache
+    std::string shader_cache_path;
+
+    // Decoded textures, empty disables the cache
+    std::string texture_cache_path;
+
+    // Video memory textures may use in bytes, 0 keeps every level resident
+    std::size_t texture_budget{0};
   };
 
   class GameConfig {
@@ -112,6 +121,13 @@ namespace YAML {
       static bool decode (const Node& node, Kvant::ResourcesConfig& config) {
         config.textures_path = node["textures"].as<std::string>();
         config.shaders_path = node["shaders"].as<std::string>();
+        config.materials_path = node["materials"] ? node["materials"].as<std::string>() : config.shaders_path;
+        if (node["shader_cache"])
+          config.shader_cache_path = node["shader_cache"].as<std::string>();
+        if (node["texture_cache"])
+          config.texture_cache_path = node["texture_cache"].as<std::string>();
+        if (node["texture_budget_mb"])
+          config.texture_budget = node["texture_budget_mb"].as<std::size_t>() << 20;
         return true;
       }
     };
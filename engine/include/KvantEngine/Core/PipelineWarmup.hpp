@@ -0,0 +1,138 @@
+#pragma once
+
+// C++ Headers
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+// Kvant Headers
+#include <KvantEngine/Core/ResourceManager.hpp>
+#include <KvantEngine/CoreTypes/Material.hpp>
+#include <KvantEngine/util/Hash.hpp>
+
+namespace Kvant {
+
+  //! Vertex format a mesh is drawn with
+  enum class VertexLayout : std::uint8_t {
+    MESH,  //!< Own VAO, CMeshRenderer
+    POOL   //!< GeometryPool VAO with the instanced model matrix
+  };
+
+  //! Combination of state the driver specializes programs for on their first draw
+  struct PipelineKey {
+    ResourceHandle material;
+    VertexLayout layout{VertexLayout::MESH};
+
+    // Internal format of the texture on unit 0, 0 without one
+    GLenum texture_format{0};
+
+    bool operator== (const PipelineKey& other) const {
+      return material == other.material && layout == other.layout && texture_format == other.texture_format;
+    }
+  };
+
+  /*! Moves first draw stalls from gameplay to loading
+   *
+   *  Drivers finish compiling a program on its first draw, once the vertex
+   *  format and bound textures are known. States declare the combinations
+   *  they use, or load the ones RenderSystem recorded in an earlier run,
+   *  and every loading frame a few of them are drawn into a 1x1 off-screen
+   *  target with dummy buffers and textures. Materials still compiling are
+   *  retried on later frames.
+   */
+  class PipelineWarmup {
+  public:
+    PipelineWarmup () {}
+    ~PipelineWarmup ();
+
+    PipelineWarmup (const PipelineWarmup&) = delete;
+    PipelineWarmup& operator= (const PipelineWarmup&) = delete;
+
+    //! Queues a combination, duplicates are ignored
+    void declare (const PipelineKey& key);
+
+    /*! Queues the combinations recorded in file and saves this run's there on save ()
+     *
+     *  A missing file is not an error, it is written on the first save.
+     */
+    void set_record_file (const boost::filesystem::path& file);
+    bool save () const;
+
+    //! Only records while there is a file to save to
+    bool is_recording () const { return !m_record_file.empty(); }
+
+    /*! Called by RenderSystem for every drawn combination, GL thread only
+     *
+     *  material_id only speeds up the lookup of already known combinations.
+     */
+    void record (MaterialId material_id, const Material& material, VertexLayout layout, GLenum texture_format) {
+      if (m_recorded_ids.insert(RecordedId{material_id, layout, texture_format}).second) add_recorded(PipelineKey{material.get_handle(), layout, texture_format});
+    }
+
+    //! Warms up at most the frame budget of queued combinations, returns true once nothing is left
+    bool step (ResourceManager<Material>& materials);
+
+    //! Dummy draws per frame
+    void set_budget (unsigned int draws) { m_budget = draws; }
+
+    bool is_done () const { return m_queue.empty(); }
+    std::size_t get_pending_count () const { return m_queue.size(); }
+
+  private:
+    struct Pending {
+      PipelineKey key;
+      unsigned int frames{0};
+    };
+
+    //! PipelineKey by MaterialId, which is cheaper to look up than the handle
+    struct RecordedId {
+      MaterialId material;
+      VertexLayout layout;
+      GLenum texture_format;
+
+      bool operator== (const RecordedId& other) const {
+        return material == other.material && layout == other.layout && texture_format == other.texture_format;
+      }
+
+      struct Hash {
+        std::size_t operator() (const RecordedId& id) const {
+          auto hash = hash_bytes(&id.material, sizeof(id.material));
+          hash = hash_bytes(&id.layout, sizeof(id.layout), hash);
+          return hash_bytes(&id.texture_format, sizeof(id.texture_format), hash);
+        }
+      };
+    };
+
+    void add_recorded (const PipelineKey& key);
+    bool contains (const std::vector<PipelineKey>& keys, const PipelineKey& key) const;
+
+    void setup ();
+    GLuint get_texture (GLenum format);
+    void draw (const Material& material, const PipelineKey& key);
+
+    std::deque<Pending> m_queue;
+    // Everything queued so far, warmed up or not
+    std::vector<PipelineKey> m_known;
+    unsigned int m_budget{4};
+
+    boost::filesystem::path m_record_file;
+    std::vector<PipelineKey> m_recorded;
+    std::unordered_set<RecordedId, RecordedId::Hash> m_recorded_ids;
+
+    // Dummy state, created on the first step with work to do
+    GLuint m_fbo{0}, m_color{0};
+    GLuint m_uniforms{0};
+    GLuint m_vbo{0}, m_ebo{0}, m_draw_data{0};
+    GLuint m_mesh_vao{0}, m_pool_vao{0};
+    std::unordered_map<GLenum, GLuint> m_textures;
+  };
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+// C++ Headers
+#include <functional>
+#include <string>
+#include <vector>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+namespace Kvant {
+
+  //! Description of a transient render target, pooled targets are aliased by it
+  struct RenderTargetDesc {
+    // 0 follows the size of the backbuffer
+    GLsizei width{0};
+    GLsizei height{0};
+    GLenum internal_format{GL_RGBA8};
+
+    bool operator== (const RenderTargetDesc& other) const {
+      return width == other.width && height == other.height && internal_format == other.internal_format;
+    }
+  };
+
+  using RenderResource = int;
+
+  /*! Declarative description of a frame
+   *
+   *  Passes are added every frame with a setup function, declaring the
+   *  render targets they create, read and write, and an execute function
+   *  issuing the actual draws. compile () drops passes whose output never
+   *  reaches the backbuffer and orders the rest so every read comes after
+   *  the writes it depends on. During execute () transient targets are
+   *  taken from a pool when first used and returned after their last use,
+   *  so targets with disjoint lifetimes share the same texture.
+   */
+  class RenderGraph {
+  public:
+    static constexpr RenderResource BACKBUFFER = 0;
+
+    class PassBuilder {
+    public:
+      //! Creates a transient target, written by this pass
+      RenderResource create (const std::string& name, const RenderTargetDesc& desc);
+      RenderResource read (RenderResource resource);
+      RenderResource write (RenderResource resource);
+
+      //! Keeps the pass alive even if nothing reads its output
+      void set_side_effect ();
+
+    private:
+      friend class RenderGraph;
+      PassBuilder (RenderGraph& graph, std::size_t pass) : m_graph(graph), m_pass(pass) {}
+
+      RenderGraph& m_graph;
+      std::size_t m_pass;
+    };
+
+    class PassResources {
+    public:
+      //! Texture currently backing a resource the pass reads or writes
+      GLuint get_texture (RenderResource resource) const;
+
+      GLsizei get_width () const { return m_width; }
+      GLsizei get_height () const { return m_height; }
+
+    private:
+      friend class RenderGraph;
+      PassResources (const RenderGraph& graph, GLsizei width, GLsizei height)
+        : m_graph(graph), m_width(width), m_height(height) {}
+
+      const RenderGraph& m_graph;
+      GLsizei m_width, m_height;
+    };
+
+    using SetupFunction = std::function<void (PassBuilder&)>;
+    using ExecuteFunction = std::function<void (const PassResources&)>;
+
+    RenderGraph ();
+    ~RenderGraph ();
+
+    RenderGraph (const RenderGraph&) = delete;
+    RenderGraph& operator= (const RenderGraph&) = delete;
+
+    void add_pass (const std::string& name, SetupFunction setup, ExecuteFunction execute);
+
+    //! Culls and orders the passes, returns false if they depend on each other in a cycle
+    bool compile ();
+    void execute ();
+
+    //! Drops all passes and resources, pooled targets are kept for the next frame
+    void reset ();
+
+    std::size_t get_pass_count () const { return m_passes.size(); }
+    std::size_t get_executed_count () const { return m_order.size(); }
+    std::size_t get_pool_size () const { return m_pool.size(); }
+
+  private:
+    struct Resource {
+      std::string name;
+      RenderTargetDesc desc;
+      std::vector<std::size_t> writers, readers;
+
+      // Positions in m_order, -1 while unused
+      int first_use{-1}, last_use{-1};
+      int target{-1};
+    };
+
+    struct Pass {
+      std::string name;
+      ExecuteFunction execute;
+      std::vector<RenderResource> creates, reads, writes;
+      bool side_effect{false};
+      bool culled{true};
+    };
+
+    struct PooledTarget {
+      RenderTargetDesc desc;
+      GLuint texture{0};
+      bool in_use{false};
+      unsigned int last_frame{0};
+    };
+
+    struct Framebuffer {
+      std::vector<GLuint> attachments;
+      GLuint fbo{0};
+      unsigned int last_frame{0};
+    };
+
+    bool valid (RenderResource resource) const {
+      return resource >= 0 && resource < (RenderResource)m_resources.size();
+    }
+
+    void cull ();
+    bool sort ();
+    void compute_lifetimes ();
+
+    int acquire_target (const RenderTargetDesc& desc);
+    void release_target (int target);
+    GLuint get_framebuffer (const std::vector<GLuint>& attachments);
+    void evict_unused ();
+
+    std::vector<Pass> m_passes;
+    std::vector<Resource> m_resources;
+    std::vector<std::size_t> m_order;
+    bool m_compiled{false};
+
+    std::vector<PooledTarget> m_pool;
+    std::vector<Framebuffer> m_framebuffers;
+    unsigned int m_frame{0};
+  };
+}
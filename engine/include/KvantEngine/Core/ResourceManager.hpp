@@ -1,11 +1,13 @@
 #pragma once
 
 // C++ Headers
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <memory>
 #include <unordered_map>
 #include <chrono>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 
@@ -31,13 +33,32 @@ namespace Kvant {
     virtual ~ResourceManager () {}
 
     std::shared_ptr<T> get (const ResourceHandle handle) {
-      auto found_it = m_resources.find(handle);
-      if (found_it != m_resources.end()) {
-        return m_resources[handle];
+      // Lookup must not insert, RenderSystem workers call this concurrently
+      auto found_it = m_indices.find(handle);
+      if (found_it != m_indices.end()) {
+        return m_slots[found_it->second].resource;
       }
       return nullptr;
     }
 
+    //! Slot of the resource named handle, invalid if it isn't loaded
+    ResourceId get_id (const ResourceHandle& handle) const {
+      auto found_it = m_indices.find(handle);
+      if (found_it == m_indices.end()) return ResourceId();
+      return ResourceId{found_it->second, m_slots[found_it->second].generation};
+    }
+
+    /*! Resource in slot id, nullptr once it was removed
+     *
+     *  Only indexes the slot table and takes no reference, for the draw
+     *  path. The pointer stays valid until the resource is removed.
+     */
+    T* get (ResourceId id) const {
+      if (id.index >= m_slots.size()) return nullptr;
+      auto& slot = m_slots[id.index];
+      return slot.generation == id.generation ? slot.resource.get() : nullptr;
+    }
+
     ResourceHandle add (const std::string& file) {
       ResourceHandle handle = file;
       // If resource already exists, return it
@@ -46,16 +67,45 @@ namespace Kvant {
         return handle;
       }
 
-      m_resources[handle] = std::make_shared<T>( handle, m_base_path / fs::path(file) );
+      auto resource = std::make_shared<T>( handle, m_base_path / fs::path(file) );
+      insert(handle, resource);
+
+      // Some resources finish loading over the next frames, polled like reloads
+      if (!resource->finish_reload()) m_reloading.push_back(resource);
+      return handle;
+    }
+
+    //! Adds a resource built from several files, T::make_handle names it
+    template<typename... Args>
+    ResourceHandle add (const std::string& file, const std::string& other_file, Args&&... args) {
+      ResourceHandle handle = T::make_handle(file, other_file, args...);
+      // If resource already exists, return it
+      auto element = get(handle);
+      if (element) {
+        return handle;
+      }
+
+      auto resource = std::make_shared<T>( handle, m_base_path, file, other_file, std::forward<Args>(args)... );
+      insert(handle, resource);
+
+      // Some resources finish loading over the next frames, polled like reloads
+      if (!resource->finish_reload()) m_reloading.push_back(resource);
       return handle;
     }
 
     bool try_remove (const ResourceHandle handle) {
       auto resource = get (handle);
+      if (!resource) return true;
 
       // if resource is not being referenced by reource in stack and this, destroy it.
       if (resource.use_count() <= 2) {
-        m_resources.erase (handle);
+        auto index = m_indices[handle];
+        m_indices.erase (handle);
+
+        // Ids of the removed resource stop resolving
+        m_slots[index].resource.reset();
+        m_slots[index].generation++;
+        m_free_slots.push_back(index);
         return true;
       }
       return false;
@@ -68,7 +118,7 @@ namespace Kvant {
         if (m_watch_id != INVALID) m_filewatcher.remove_watch(m_watch_id);
         m_base_path = base_filepath;
         using namespace std::placeholders;
-        m_watch_id = m_filewatcher.add_watch(base_filepath, true, std::bind(&ResourceManager::handle_file_update<T>, this, _1, _2, _3, _4));
+        m_watch_id = m_filewatcher.add_watch(base_filepath, true, std::bind(&ResourceManager::handle_file_update, this, _1, _2, _3, _4));
       }
     }
 
@@ -79,33 +129,65 @@ namespace Kvant {
     void update () {
       if (m_watch_id != INVALID)
         m_filewatcher.update();
+
+      // Reloads that finish in the background are completed here, on the GL thread
+      m_reloading.erase(std::remove_if(m_reloading.begin(), m_reloading.end(), [] (const std::shared_ptr<T>& resource) {
+        return resource->finish_reload();
+      }), m_reloading.end());
     }
 
-    template<class Texture>
     void handle_file_update(FW::WatchId, const std::string& dir, const std::string& filename,
                FW::Action action) {
-      // Return if texture is not an observed resource
-      if (!m_resources[filename]) return;
-
-      switch(action) {
-        case FW::Action::Add:
-          std::cout << "Texture (" << dir + filename << ") Reappeared! " <<  std::endl;
-          break;
-        case FW::Action::Delete:
-          std::cout << "Texture (" << dir + filename << ") Deleted! " << std::endl;
-          m_resources[filename]->load_image(m_base_path / fs::path("removed.png"));
-          break;
-        case FW::Action::Modified:
-          std::cout << "Texture (" << dir + filename << ") Modified! " << std::endl;
-          m_resources[filename]->load_image(dir + filename);
-          break;
-        default:
-          std::cout << "Should never happen!" << std::endl;
-     }
+      // Several resources can share a file, e.g. programs using the same shader
+      for (auto& slot : m_slots) {
+        auto& resource = slot.resource;
+        if (!resource || !resource->depends_on(filename)) continue;
+
+        switch(action) {
+          case FW::Action::Add:
+            std::cout << "Resource (" << dir + filename << ") Reappeared! " <<  std::endl;
+            break;
+          case FW::Action::Delete:
+            std::cout << "Resource (" << dir + filename << ") Deleted! " << std::endl;
+            resource->on_file_deleted(m_base_path);
+            break;
+          case FW::Action::Modified:
+            std::cout << "Resource (" << dir + filename << ") Modified! " << std::endl;
+            resource->on_file_modified(dir + filename);
+            if (std::find(m_reloading.begin(), m_reloading.end(), resource) == m_reloading.end())
+              m_reloading.push_back(resource);
+            break;
+          default:
+            std::cout << "Should never happen!" << std::endl;
+        }
+      }
     }
 
   private:
-    std::unordered_map<ResourceHandle, std::shared_ptr<T>> m_resources;
+    struct Slot {
+      std::shared_ptr<T> resource;
+      std::uint32_t generation{0};
+    };
+
+    void insert (const ResourceHandle& handle, const std::shared_ptr<T>& resource) {
+      std::uint32_t index;
+      if (!m_free_slots.empty()) {
+        index = m_free_slots.back();
+        m_free_slots.pop_back();
+      }
+      else {
+        index = m_slots.size();
+        m_slots.emplace_back();
+      }
+      m_slots[index].resource = resource;
+      m_indices[handle] = index;
+    }
+
+    // Removed resources leave their slot empty for the next one
+    std::vector<Slot> m_slots;
+    std::vector<std::uint32_t> m_free_slots;
+    std::unordered_map<ResourceHandle, std::uint32_t> m_indices;
+    std::vector<std::shared_ptr<T>> m_reloading;
 
     FW::FileWatcher m_filewatcher;
     const FW::WatchId INVALID{std::numeric_limits<FW::WatchId>::max()};
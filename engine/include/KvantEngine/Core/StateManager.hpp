@@ -25,10 +25,7 @@ namespace Kvant {
     template <typename T, typename... TArgs>
     void change_state (TArgs&&... _args) {
       // cleanup current state
-      if (!m_states.empty()) {
-        m_states.back()->cleanup();
-        m_states.pop_back();
-      }
+      if (!m_states.empty()) destroy_state();
 
       // Store and init new state
       m_states.emplace_back ( make_unique<T>(forward<TArgs>(_args)...) );
@@ -56,6 +53,9 @@ namespace Kvant {
     void draw (const float dt);
 
     private:
+      //! Cleans up and destroys the current state, reporting the GL objects it leaked
+      void destroy_state ();
+
       // Stores stack of states
       vector<unique_ptr<Kvant::State>> m_states;
 
@@ -0,0 +1,71 @@
+#pragma once
+
+// C++ Headers
+#include <memory>
+#include <unordered_map>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/Texture.hpp>
+
+namespace Kvant {
+
+  /*! Keeps the textures of a state within a video memory budget
+   *
+   *  RenderSystem requests every drawn texture with the size it covers on
+   *  screen, which gives the largest mip level worth keeping: one texel
+   *  per pixel, assuming the texture spans the mesh once. Textures get that
+   *  level as soon as they need it and keep it while they are drawn.
+   *
+   *  Once per frame the levels wanted add up against the budget. If they
+   *  don't fit, the least recently drawn textures lose their largest
+   *  levels first, down to MIN_RESIDENT_SIZE so nothing drops to the
+   *  placeholder. Textures not drawn for EVICT_FRAMES, or tracked and
+   *  never drawn, are always lowered to that size. Changes stream in
+   *  through Texture::set_resident_level.
+   */
+  class TextureStreamer {
+  public:
+    //! Largest side of the smallest level textures keep
+    static constexpr GLsizei MIN_RESIDENT_SIZE = 64;
+
+    //! Frames a texture stays at its level without being drawn
+    static constexpr unsigned int EVICT_FRAMES = 300;
+
+    //! Bytes of video memory textures may use, 0 only evicts unused textures
+    void set_budget (std::size_t bytes) { m_budget = bytes; }
+    std::size_t get_budget () const { return m_budget; }
+
+    //! Bytes the resident levels of tracked textures use
+    std::size_t get_resident_bytes () const { return m_resident_bytes; }
+
+    //! Starts managing texture before it is drawn, it is lowered if it never is
+    void track (const std::shared_ptr<Texture>& texture);
+
+    //! Notes texture is drawn this frame covering screen_size pixels on its larger side, ignored unless tracked
+    void request (const Texture& texture, float screen_size);
+
+    //! Picks resident levels for the next frames and polls their uploads, once per frame
+    void update ();
+
+  private:
+    struct Entry {
+      std::weak_ptr<Texture> texture;
+      // Level the draws of the last frame it was requested in needed
+      GLsizei wanted{0};
+      // 0 until it is first requested, frames count from 1
+      unsigned int last_used{0};
+    };
+
+    GLsizei get_min_level (const Texture& texture) const;
+
+    std::unordered_map<const Texture*, Entry> m_entries;
+    unsigned int m_frame{1};
+
+    std::size_t m_budget{0};
+    std::size_t m_resident_bytes{0};
+  };
+}
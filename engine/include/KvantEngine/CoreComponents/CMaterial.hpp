@@ -1,7 +1,9 @@
 #pragma once
 
 // C++ Headers
+#include <memory>
 #include <string>
+#include <vector>
 
 // OpenGL / glew Headers
 #define GL3_PROTOTYPES 1
@@ -11,17 +13,126 @@
 #include <entityx/entityx.h>
 
 // Kvant Headers
-#include <KvantEngine/CoreTypes/Program.hpp>
+#include <KvantEngine/CoreTypes/Material.hpp>
+#include <KvantEngine/CoreTypes/MaterialParams.hpp>
 
 namespace Kvant {
   using namespace std;
   namespace ex = entityx;
 
+  /*! Instance of a Material template
+   *
+   *  Without overrides an instance is just a pointer to the template and
+   *  draws with its parameter buffer and material id, so any number of
+   *  entities using it batch together. Parameter overrides draw with a
+   *  buffer starting from the template's values, shared with every
+   *  instance of the template overriding the same values. A texture
+   *  override gives the instance its own id.
+   */
   class CMaterial : ex::Component<CMaterial> {
   public:
-    CMaterial(const Shader _shader) : m_program{_shader} { }
-    const Program& getProgram() const { return m_program; }
+    //! Get materials from State::add_material
+    CMaterial(std::shared_ptr<Material> _material) : m_material{_material} {}
+
+    /*! Picks up compiled and reloaded programs, call on the GL thread before getProgram
+     *
+     *  Overridden parameters are uploaded here, and only if they changed.
+     */
+    void resolve() {
+      m_material->resolve();
+      if (!m_overrides) return;
+
+      if (!m_params || m_revision != m_material->get_revision()) {
+        m_params = m_material->share_params(*m_overrides);
+        m_revision = m_material->get_revision();
+      }
+      m_params->params.upload();
+    }
+
+    //! Overrides a member of the program's MaterialParams block for this instance
+    template<typename T>
+    void set_param(const char* name, const T& value) {
+      // Copies of the component share the overrides until one of them changes
+      auto overrides = std::make_shared<MaterialParams>();
+      if (m_overrides) overrides->copy_values(*m_overrides);
+      overrides->set(name, value);
+      m_overrides = overrides;
+      m_params.reset();
+    }
+
+    //! Overrides the texture the template binds to unit, the image has to be added to the state before it is drawn
+    void set_texture(std::size_t unit, const ResourceHandle& texture) {
+      if (m_textures.size() <= unit) m_textures.resize(unit + 1);
+      m_textures[unit] = texture;
+      m_texture_ids.resize(m_textures.size(), INVALID_TEXTURE);
+      m_texture_ids[unit] = INVALID_TEXTURE;
+      m_textures_resolved = false;
+      make_unique_id();
+    }
+
+    //! Looks up the ids of overrides not resolved yet, again whenever texture_count changed, like CMeshRenderer
+    template<typename F>
+    void resolve_textures(F resolve, std::size_t texture_count) {
+      if (m_textures_resolved && texture_count == m_texture_count) return;
+      for (std::size_t unit = 0; unit < m_textures.size(); unit++) {
+        if (!m_textures[unit].empty() && m_texture_ids[unit] == INVALID_TEXTURE) m_texture_ids[unit] = resolve(m_textures[unit]);
+      }
+      m_textures_resolved = true;
+      m_texture_count = texture_count;
+    }
+
+    //! True if the instance or the template set a texture for unit
+    bool has_texture(std::size_t unit) const { return !get_texture(unit).empty(); }
+
+    //! Id of the texture on unit, INVALID_TEXTURE if there is none or it is unresolved
+    TextureId get_texture_id(std::size_t unit) const {
+      if (unit < m_textures.size() && !m_textures[unit].empty()) return m_texture_ids[unit];
+      return m_material->get_texture_id(unit);
+    }
+
+    //! Texture bound to unit, empty if neither the instance nor the template set one
+    const ResourceHandle& get_texture(std::size_t unit) const {
+      static const ResourceHandle none;
+      if (unit < m_textures.size() && !m_textures[unit].empty()) return m_textures[unit];
+
+      auto& textures = m_material->get_textures();
+      return unit < textures.size() ? textures[unit] : none;
+    }
+
+    SamplerId get_sampler(std::size_t unit) const { return m_material->get_sampler(unit); }
+
+    const Program& getProgram() const { return m_material->get_program(); }
+    bool is_ready() const { return m_material->is_ready(); }
+
+    //! 0 if the program has no MaterialParams block
+    GLuint get_params_buffer() const {
+      return m_params ? m_params->params.get_buffer_id() : m_material->get_params().get_buffer_id();
+    }
+
+    //! Equal ids draw with the same program, parameters and textures
+    MaterialId get_material_id() const {
+      if (m_id) return m_id;
+      return m_params ? m_params->id : m_material->get_id();
+    }
+
+    const std::shared_ptr<Material>& get_material() const { return m_material; }
+
   private:
-    Program m_program;
+    void make_unique_id() {
+      if (!m_id) m_id = Material::next_id();
+    }
+
+    std::shared_ptr<Material> m_material;
+
+    // Overrides, empty until the first set_param or set_texture
+    MaterialId m_id{0};
+    // Behind pointers, components have to stay copyable. The overrides are never laid out, only copied
+    std::shared_ptr<const MaterialParams> m_overrides;
+    std::shared_ptr<Material::SharedParams> m_params;
+    std::vector<ResourceHandle> m_textures;
+    std::vector<TextureId> m_texture_ids;
+    bool m_textures_resolved{true};
+    std::size_t m_texture_count{0};
+    unsigned int m_revision{0};
   };
 }
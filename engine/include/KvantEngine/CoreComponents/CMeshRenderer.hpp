@@ -15,6 +15,8 @@
 // Kvant Headers
 #include <KvantEngine/CoreTypes/Vertex.hpp>
 #include <KvantEngine/CoreTypes/Texture.hpp>
+#include <KvantEngine/CoreTypes/AABB.hpp>
+#include <KvantEngine/CoreTypes/GeometryPool.hpp>
 
 namespace Kvant {
 
@@ -28,17 +30,49 @@ namespace Kvant {
   public:
     CMeshRenderer(const vector<Vertex> &_vertices,
                   const vector<GLuint> &_indices,
-                  const vector<string> &_textures);
+                  const vector<string> &_textures,
+                  bool _is_static = false);
+    //! Copies the mesh into buffers of its own
+    CMeshRenderer(const CMeshRenderer& other);
+    //! Deletes the buffers
     ~CMeshRenderer();
 
+    CMeshRenderer& operator= (const CMeshRenderer&) = delete;
+
     const vector<Vertex>& get_vertices () { return m_vertices; }
     const vector<GLuint>& get_indices () { return m_indices; }
     const vector<string>& get_textures () { return m_textures; }
+    const AABB& get_local_bounds () { return m_local_bounds; }
+
+    //! Static meshes are copied into the shared GeometryPool and drawn with multi draw indirect
+    bool is_static () const { return m_is_static; }
 
+    //! The image has to be added to the state before the mesh is drawn
     void add_texture(string texture) {
       m_textures.push_back(texture);
     }
 
+    //! Id of the texture on unit, INVALID_TEXTURE until RenderSystem resolved it
+    TextureId get_texture_id (std::size_t unit) const {
+      return unit < m_texture_ids.size() ? m_texture_ids[unit] : INVALID_TEXTURE;
+    }
+
+    /*! Looks up the ids of textures added since the last call, resolve maps an image to its TextureId
+     *
+     *  texture_count is State::get_texture_count, whenever it changed
+     *  images that weren't in the state yet are looked up again.
+     */
+    template<typename F>
+    void resolve_textures (F resolve, std::size_t texture_count) {
+      if (texture_count != m_texture_count) {
+        for (std::size_t unit = 0; unit < m_texture_ids.size(); unit++) {
+          if (m_texture_ids[unit] == INVALID_TEXTURE) m_texture_ids[unit] = resolve(m_textures[unit]);
+        }
+        m_texture_count = texture_count;
+      }
+      while (m_texture_ids.size() < m_textures.size()) m_texture_ids.push_back(resolve(m_textures[m_texture_ids.size()]));
+    }
+
   private:
     /*  Render data  */
     GLuint m_vao, m_vbo, m_ebo;
@@ -46,6 +80,14 @@ namespace Kvant {
     vector<Vertex> m_vertices;
     vector<GLuint> m_indices;
     vector<string> m_textures;
+    // Resolved from m_textures on the GL thread, so drawing doesn't look names up
+    vector<TextureId> m_texture_ids;
+    // State::get_texture_count when m_texture_ids were last resolved
+    std::size_t m_texture_count{0};
+    AABB m_local_bounds;
+
+    bool m_is_static;
+    GeometryPool::Allocation m_pool_allocation;
 
     void setup_mesh ();
   };
@@ -12,6 +12,10 @@
 // Third-party
 #include <entityx/entityx.h>
 
+// Kvant Headers
+#include <KvantEngine/CoreTypes/AABB.hpp>
+#include <KvantEngine/CoreTypes/DynamicAABBTree.hpp>
+
 
 namespace Kvant {
 
@@ -41,6 +45,8 @@ namespace Kvant {
 
     glm::mat4 get_transform ();
     glm::mat4 get_world_transform () { return m_world_transform; };
+    const AABB& get_world_bounds () { return m_world_bounds; }
+    ProxyId get_proxy_id () { return m_proxy_id; }
 
     const glm::vec3& get_position () { return m_position; }
     const glm::vec3& get_rotation () { return m_rotation; }
@@ -93,6 +99,10 @@ namespace Kvant {
     glm::mat4 m_transform;
     glm::mat4 m_world_transform;
 
+    // Spatial index entry, only nodes with a mesh have one
+    ProxyId m_proxy_id{NULL_PROXY};
+    AABB m_world_bounds;
+
     glm::vec3 m_position;
     glm::vec3 m_rotation;
     glm::vec3 m_scale;
@@ -12,6 +12,7 @@
 
 // Kvant Headers
 #include <KvantEngine/CoreComponents/CNode.hpp>
+#include <KvantEngine/CoreTypes/DynamicAABBTree.hpp>
 #include <KvantEngine/imgui/imgui_impl_sdl_gl3.h>
 
 namespace Kvant {
@@ -32,8 +33,16 @@ namespace Kvant {
     void receive (const entityx::ComponentRemovedEvent<CNode>& event);
     void receive (const entityx::EntityDestroyedEvent& event);
 
+    //! Bounding volume hierarchy over all active nodes with a mesh
+    const DynamicAABBTree& get_spatial_index () const { return m_spatial_index; }
+
+    //! Returns closest entity whose world bounds are hit by ray
+    entityx::Entity pick (const Ray& ray, float max_distance = 1000.f) const;
+
   private:
-    void update_world_transform (entityx::Entity entity);
+    bool update_world_transform (entityx::Entity entity);
+    void update_spatial_proxy (entityx::Entity entity, bool transform_changed);
+    void destroy_spatial_proxy (entityx::Entity entity);
 
     void assess_node_removals (entityx::Entity entity);
     void assess_node_additions (entityx::Entity entity);
@@ -42,6 +51,7 @@ namespace Kvant {
     void draw_imgui_node (entityx::ComponentHandle<Kvant::CNode, entityx::EntityManager>& node);
 
     Engine *m_engine;
+    DynamicAABBTree m_spatial_index;
 
   };
 
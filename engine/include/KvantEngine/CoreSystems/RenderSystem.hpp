@@ -2,6 +2,8 @@
 
 // C++ Headers
 #include <chrono>
+#include <memory>
+#include <vector>
 
 // SDL2 Headers
 #include <SDL2/SDL.h>
@@ -11,23 +13,98 @@
 
 // Kvant Headers
 #include <KvantEngine/Core/Engine.hpp>
+#include <KvantEngine/Core/PipelineWarmup.hpp>
+#include <KvantEngine/Core/ResourceManager.hpp>
+#include <KvantEngine/CoreTypes/DynamicAABBTree.hpp>
+#include <KvantEngine/CoreTypes/GeometryPool.hpp>
+#include <KvantEngine/CoreTypes/RenderCommand.hpp>
+#include <KvantEngine/CoreTypes/UniformBlocks.hpp>
+#include <KvantEngine/CoreTypes/UniformRingBuffer.hpp>
 
 namespace Kvant {
 
   namespace ex = entityx;
 
+  // Forward declarations
+  class CMaterial;
+  class State;
+  class CMeshRenderer;
+  class CNode;
+
+  /*! Draws the node tree below the render root
+   *
+   *  Rendering happens in three steps: the visible entities are collected,
+   *  worker threads record a RenderCommand per entity into their own bucket,
+   *  and the merged and sorted commands are replayed on the GL thread.
+   *
+   *  When multi draw indirect is available, static meshes live in a shared
+   *  GeometryPool and runs of commands with the same program and textures
+   *  are issued as a single glMultiDrawElementsIndirect.
+   */
   class RenderSystem : public ex::System<RenderSystem> {
   public:
+    enum class SortMode {
+      PAINTER,  //!< Back to front by origin depth, by program and material at equal depth, needed without depth testing
+      STATE     //!< Group by program and material to minimize state changes
+    };
+
     RenderSystem (Engine* engine);
     ~RenderSystem ();
 
     void set_render_root (ex::Entity root);
     void set_camera (ex::Entity camera);
+    void set_sort_mode (SortMode mode) { m_sort_mode = mode; }
+
+    //! Has no effect if the driver lacks multi draw indirect or base instance
+    void set_indirect_enabled (bool enabled) { m_indirect_enabled = enabled && m_geometry_pool; }
+    bool is_indirect_enabled () const { return m_indirect_enabled; }
+
+    //! Must be called once at the start of every frame before any update
+    void begin_frame ();
+
     void update (ex::EntityManager& entities, ex::EventManager& events, ex::TimeDelta dt) override;
 
   private:
-    void render_entity (ex::Entity entity);
+    void cull (const glm::mat4& view_projection);
+    bool is_culled (ProxyId proxy) const;
+
+    void collect_entity (ex::Entity entity);
+    void record_pipeline (const CMaterial& material, const CMeshRenderer& mesh_renderer);
+    void request_textures (CNode& node, const CMaterial* material, CMeshRenderer& mesh_renderer);
+    void record_commands ();
+    void record_command (ex::Entity entity, std::uint32_t sequence, std::vector<RenderCommand>& bucket);
+    //! Sorts the origin of model back to front in the upper half of PAINTER keys
+    std::uint32_t get_depth_key (const glm::mat4& model) const;
+    void submit_commands ();
+
     ex::Entity m_render_root, m_camera;
+    SortMode m_sort_mode{SortMode::PAINTER};
+
+    std::vector<ex::Entity> m_draw_list;
+    std::vector<std::vector<RenderCommand>> m_buckets;
+    std::vector<RenderCommand> m_commands;
+
+    // Frame constants followed by every command's object constants, uploaded at once
+    UniformRingBuffer m_uniform_ring;
+    std::vector<unsigned char> m_uniform_staging;
+    GLsizeiptr m_frame_constants_size, m_object_stride;
+
+    // Only created when the driver supports multi draw indirect
+    std::unique_ptr<GeometryPool> m_geometry_pool;
+    bool m_indirect_enabled{false};
+    std::vector<DrawElementsIndirectCommand> m_indirect_commands;
+    std::vector<ObjectConstants> m_indirect_objects;
+
+    // Set for the duration of update when the state records its pipelines
+    PipelineWarmup* m_pipeline_warmup{nullptr};
+    // State being drawn for the duration of update, textures are looked up through it
+    State* m_state{nullptr};
+    glm::mat4 m_view_projection;
+    glm::vec2 m_viewport_size;
+
+    // Frame in which each proxy was last found inside the view frustum
+    std::vector<unsigned int> m_proxy_frames;
+    unsigned int m_cull_frame{0};
 
     Engine* m_engine;
 
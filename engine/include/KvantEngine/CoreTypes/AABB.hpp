@@ -0,0 +1,146 @@
+#pragma once
+
+// C++ Headers
+#include <array>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+// OpenGL / glew Headers
+#include <glm/glm.hpp>
+
+namespace Kvant {
+
+  //! Axis aligned bounding box
+  struct AABB {
+    glm::vec3 lower{0.f, 0.f, 0.f};
+    glm::vec3 upper{0.f, 0.f, 0.f};
+
+    AABB () {}
+    AABB (const glm::vec3& _lower, const glm::vec3& _upper) : lower(_lower), upper(_upper) {}
+
+    glm::vec3 get_center () const { return 0.5f * (lower + upper); }
+    glm::vec3 get_extents () const { return 0.5f * (upper - lower); }
+
+    //! Half the surface area, used as cost metric by the tree
+    float get_perimeter () const {
+      glm::vec3 d = upper - lower;
+      return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+
+    bool contains (const AABB& other) const {
+      return lower.x <= other.lower.x && lower.y <= other.lower.y && lower.z <= other.lower.z &&
+             other.upper.x <= upper.x && other.upper.y <= upper.y && other.upper.z <= upper.z;
+    }
+
+    bool overlaps (const AABB& other) const {
+      return !(other.lower.x > upper.x || other.lower.y > upper.y || other.lower.z > upper.z ||
+               lower.x > other.upper.x || lower.y > other.upper.y || lower.z > other.upper.z);
+    }
+
+    //! Squared distance from point to box, 0 if the point is inside
+    float distance_squared (const glm::vec3& point) const {
+      glm::vec3 d = glm::max(glm::max(lower - point, point - upper), glm::vec3(0.f));
+      return glm::dot(d, d);
+    }
+
+    static AABB merge (const AABB& a, const AABB& b) {
+      return AABB(glm::min(a.lower, b.lower), glm::max(a.upper, b.upper));
+    }
+
+    /*! Returns the box enclosing this box after transformation
+     *
+     *  Transforms center and extents separately (Arvo), which is exact for
+     *  translations and conservative under rotation.
+     */
+    AABB transformed (const glm::mat4& m) const {
+      glm::vec3 center = get_center();
+      glm::vec3 extents = get_extents();
+
+      glm::vec3 new_center(m[3].x, m[3].y, m[3].z);
+      glm::vec3 new_extents(0.f);
+      for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+          new_center[i] += m[j][i] * center[j];
+          new_extents[i] += std::abs(m[j][i]) * extents[j];
+        }
+      }
+      return AABB(new_center - new_extents, new_center + new_extents);
+    }
+  };
+
+  struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+
+    Ray (const glm::vec3& _origin, const glm::vec3& _direction) : origin(_origin), direction(_direction) {}
+
+    /*! Slab test against box
+     *
+     *  @param [out] t  Distance along ray to entry point
+     *  @retval TRUE    Ray hits box within [0, max_t]
+     */
+    bool intersects (const AABB& box, float max_t, float& t) const {
+      float t_min = 0.f;
+      float t_max = max_t;
+      for (int i = 0; i < 3; i++) {
+        if (std::abs(direction[i]) < std::numeric_limits<float>::epsilon()) {
+          if (origin[i] < box.lower[i] || origin[i] > box.upper[i]) return false;
+          continue;
+        }
+        float inv = 1.f / direction[i];
+        float t1 = (box.lower[i] - origin[i]) * inv;
+        float t2 = (box.upper[i] - origin[i]) * inv;
+        if (t1 > t2) std::swap(t1, t2);
+        t_min = glm::max(t_min, t1);
+        t_max = glm::min(t_max, t2);
+        if (t_min > t_max) return false;
+      }
+      t = t_min;
+      return true;
+    }
+  };
+
+  //! View frustum as six inward facing planes (xyz = normal, w = distance)
+  struct Frustum {
+    enum class Result { OUTSIDE, INTERSECTS, INSIDE };
+
+    std::array<glm::vec4, 6> planes;
+
+    //! Extracts planes from a projection * view matrix (Gribb/Hartmann)
+    static Frustum from_matrix (const glm::mat4& m) {
+      auto row = [&m] (int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+
+      Frustum frustum;
+      frustum.planes[0] = row(3) + row(0); // left
+      frustum.planes[1] = row(3) - row(0); // right
+      frustum.planes[2] = row(3) + row(1); // bottom
+      frustum.planes[3] = row(3) - row(1); // top
+      frustum.planes[4] = row(3) + row(2); // near
+      frustum.planes[5] = row(3) - row(2); // far
+
+      for (auto& p : frustum.planes) {
+        p = p / glm::length(glm::vec3(p.x, p.y, p.z));
+      }
+      return frustum;
+    }
+
+    Result classify (const AABB& box) const {
+      glm::vec3 center = box.get_center();
+      glm::vec3 extents = box.get_extents();
+
+      Result result = Result::INSIDE;
+      for (const auto& p : planes) {
+        glm::vec3 normal(p.x, p.y, p.z);
+        float distance = glm::dot(normal, center) + p.w;
+        float radius = glm::dot(glm::abs(normal), extents);
+
+        if (distance < -radius) return Result::OUTSIDE;
+        if (distance < radius) result = Result::INTERSECTS;
+      }
+      return result;
+    }
+
+    bool intersects (const AABB& box) const { return classify(box) != Result::OUTSIDE; }
+  };
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+// C++ Headers
+#include <vector>
+#include <functional>
+
+// OpenGL / glew Headers
+#include <glm/glm.hpp>
+
+// Third-party
+#include <entityx/entityx.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/AABB.hpp>
+
+namespace Kvant {
+
+  namespace ex = entityx;
+
+  using ProxyId = int;
+  constexpr ProxyId NULL_PROXY = -1;
+
+  /*! Dynamic bounding volume hierarchy
+   *
+   *  Leaves store "fat" boxes enlarged by a margin so that small movements
+   *  don't require touching the tree. Internal nodes are kept balanced with
+   *  tree rotations on insertion and removal.
+   */
+  class DynamicAABBTree {
+  public:
+    //! Return false from a callback to stop the query
+    using QueryCallback = std::function<bool(ProxyId)>;
+    //! Return the new max distance of the ray, 0 stops the cast and a negative value ignores the proxy
+    using RayCallback = std::function<float(ProxyId, const Ray&, float max_t)>;
+
+    DynamicAABBTree (float margin = 0.1f);
+
+    ProxyId create_proxy (const AABB& aabb, ex::Entity entity);
+    void destroy_proxy (ProxyId proxy);
+
+    /*! Refits proxy to new bounds
+     *
+     *  @param [in] displacement   Expected movement, used to predict fat box
+     *  @retval TRUE  The proxy was reinserted
+     *  @retval FALSE New bounds still fit inside the fat box
+     */
+    bool move_proxy (ProxyId proxy, const AABB& aabb, const glm::vec3& displacement);
+
+    void query (const AABB& aabb, const QueryCallback& callback) const;
+    void query (const Frustum& frustum, const QueryCallback& callback) const;
+    void ray_cast (const Ray& ray, float max_t, const RayCallback& callback) const;
+
+    //! Returns closest proxy to point within max_distance or NULL_PROXY
+    ProxyId query_nearest (const glm::vec3& point, float max_distance) const;
+
+    ex::Entity get_entity (ProxyId proxy) const { return m_nodes[proxy].entity; }
+    const AABB& get_fat_aabb (ProxyId proxy) const { return m_nodes[proxy].aabb; }
+
+    int get_height () const;
+    int get_proxy_count () const { return m_proxy_count; }
+
+  private:
+    struct Node {
+      AABB aabb;
+      ex::Entity entity;
+
+      // Parent when in tree, next free node when in free list
+      int parent{NULL_PROXY};
+      int child1{NULL_PROXY};
+      int child2{NULL_PROXY};
+
+      // Leaf = 0, free node = -1
+      int height{-1};
+
+      bool is_leaf () const { return child1 == NULL_PROXY; }
+    };
+
+    int allocate_node ();
+    void free_node (int node);
+
+    void insert_leaf (int leaf);
+    void remove_leaf (int leaf);
+    void refit (int node);
+    int balance (int node);
+
+    void query_all (int node, const QueryCallback& callback, bool& proceed) const;
+
+    std::vector<Node> m_nodes;
+    int m_root{NULL_PROXY};
+    int m_free_list{NULL_PROXY};
+    int m_proxy_count{0};
+    float m_margin;
+  };
+}
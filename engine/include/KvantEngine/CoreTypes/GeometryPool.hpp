@@ -0,0 +1,72 @@
+#pragma once
+
+// C++ Headers
+#include <vector>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/Vertex.hpp>
+#include <KvantEngine/CoreTypes/UniformBlocks.hpp>
+
+namespace Kvant {
+
+  //! Layout consumed by glMultiDrawElementsIndirect
+  struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+  };
+
+  /*! Shared vertex and index buffers for static meshes
+   *
+   *  All meshes in the pool share one VAO, so a material bucket can be
+   *  drawn with a single glMultiDrawElementsIndirect. Per draw data is fed
+   *  through the instanced attributes INSTANCE_MODEL_LOCATION and
+   *  INSTANCE_LAYER_LOCATION, selected by the base instance of each
+   *  indirect command. Append only, the storage
+   *  is released with the pool.
+   */
+  class GeometryPool {
+  public:
+    struct Allocation {
+      GLuint first_index{0};
+      GLsizei index_count{0};
+      GLint base_vertex{0};
+
+      bool valid () const { return index_count > 0; }
+    };
+
+    GeometryPool (GLsizeiptr vertex_capacity = 1 << 16, GLsizeiptr index_capacity = 1 << 18);
+    ~GeometryPool ();
+
+    GeometryPool (const GeometryPool&) = delete;
+    GeometryPool& operator= (const GeometryPool&) = delete;
+
+    Allocation add (const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+
+    //! Orphans and refills the indirect and per draw buffers, one entry per draw
+    void upload_draws (const std::vector<DrawElementsIndirectCommand>& commands,
+                       const std::vector<ObjectConstants>& objects);
+
+    //! Draws commands [first, first + count) of the last upload
+    void draw (std::size_t first, std::size_t count) const;
+
+    GLuint get_vao () const { return m_vao; }
+
+  private:
+    void setup_vao ();
+    void reserve (GLuint& buffer, GLsizeiptr& capacity, GLsizeiptr used, GLsizeiptr required);
+
+    GLuint m_vao{0}, m_vbo{0}, m_ebo{0};
+    GLuint m_draw_data_buffer{0}, m_indirect_buffer{0};
+
+    // In bytes
+    GLsizeiptr m_vertex_capacity, m_index_capacity;
+    GLsizeiptr m_vertex_used{0}, m_index_used{0};
+  };
+}
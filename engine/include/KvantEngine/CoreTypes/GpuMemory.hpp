@@ -0,0 +1,130 @@
+#pragma once
+
+// C++ Headers
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+//! Registers a GL object with GpuMemory, recording this line as where it was created
+#define KVANT_GPU_TRACK(category, id, bytes, owner) \
+  Kvant::GpuMemory::instance().track(category, id, bytes, owner, __FILE__, __LINE__)
+
+namespace Kvant {
+
+  // Forward declarations
+  class State;
+
+  enum class GpuCategory : std::uint8_t {
+    TEXTURE,
+    BUFFER,
+    VERTEX_ARRAY,
+    PROGRAM,
+    FRAMEBUFFER,
+    SAMPLER,
+    COUNT
+  };
+
+  const char* get_category_name (GpuCategory category);
+
+  //! One GL object and the video memory its storage takes
+  struct GpuAllocation {
+    GpuCategory category{GpuCategory::TEXTURE};
+    GLuint id{0};
+    // Estimated from sizes and formats, drivers add padding and alignment on top
+    std::size_t bytes{0};
+    std::string owner;
+    const char* file{""};
+    int line{0};
+    // Scope active when it was created, nullptr for engine wide objects
+    const State* state{nullptr};
+  };
+
+  /*! Every GL object the engine creates, with its size, owner and creation site
+   *
+   *  Objects are registered with KVANT_GPU_TRACK after glGen*, updated
+   *  with resize when their storage is reallocated and removed with
+   *  untrack before glDelete*. Each is counted against the State whose
+   *  Scope was active when it was created, State sets one around init,
+   *  update and draw. GL thread only, like the objects it counts.
+   *
+   *  draw_imgui shows totals per category and State and the largest
+   *  objects. Objects a State still holds once it is destroyed are logged
+   *  as leaks and counted as engine wide from then on.
+   */
+  class GpuMemory {
+  public:
+    static GpuMemory& instance ();
+
+    //! Attributes objects created while it lives to state, nullptr for engine wide ones
+    class Scope {
+    public:
+      explicit Scope (const State* state);
+      ~Scope ();
+
+      Scope (const Scope&) = delete;
+      Scope& operator= (const Scope&) = delete;
+
+    private:
+      const State* m_previous;
+    };
+
+    //! Adds or replaces the entry of id, ids of 0 are ignored
+    void track (GpuCategory category, GLuint id, std::size_t bytes, const std::string& owner, const char* file, int line);
+    //! New storage size of a tracked object
+    void resize (GpuCategory category, GLuint id, std::size_t bytes);
+    void untrack (GpuCategory category, GLuint id);
+
+    //! Bytes of every object in category
+    std::size_t get_total (GpuCategory category) const { return m_totals[(std::size_t)category]; }
+    //! Bytes of every object
+    std::size_t get_total () const;
+    //! Bytes of the objects of state in category, nullptr for engine wide ones
+    std::size_t get_total (const State* state, GpuCategory category) const;
+    //! Bytes of the objects of state in every category
+    std::size_t get_total (const State* state) const;
+    std::size_t get_count (GpuCategory category) const { return m_counts[(std::size_t)category]; }
+
+    const GpuAllocation* find (GpuCategory category, GLuint id) const;
+
+    //! Calls f with every GpuAllocation, in no particular order
+    template <typename F>
+    void for_each (F f) const {
+      for (auto& entry : m_allocations) f(entry.second);
+    }
+
+    //! Logs what state still holds and counts it as engine wide, called as states are destroyed
+    void release_state (const State* state);
+
+    //! The inspector window, open is cleared when it is closed
+    void draw_imgui (bool* open);
+
+    //! Bytes of width x height with levels mips and layers layers of internal_format
+    static std::size_t get_texture_size (GLenum internal_format, GLsizei width, GLsizei height, GLsizei levels = 1, GLsizei layers = 1);
+
+  private:
+    GpuMemory () {}
+
+    using Totals = std::array<std::size_t, (std::size_t)GpuCategory::COUNT>;
+
+    static std::uint64_t make_key (GpuCategory category, GLuint id) { return (std::uint64_t)category << 32 | id; }
+    void add (const GpuAllocation& allocation, std::size_t bytes);
+    void remove (const GpuAllocation& allocation, std::size_t bytes);
+
+    std::unordered_map<std::uint64_t, GpuAllocation> m_allocations;
+    Totals m_totals{};
+    Totals m_counts{};
+    std::unordered_map<const State*, Totals> m_state_totals;
+    const State* m_scope{nullptr};
+
+    // Inspector filters, set by clicking a category or State
+    int m_category_filter{-1};
+    bool m_filter_state{false};
+    const State* m_state_filter{nullptr};
+  };
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+// C++ Headers
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// Third-party
+#include <yaml-cpp/yaml.h>
+
+// Kvant Headers
+#include <KvantEngine/Core/ResourceManager.hpp>
+#include <KvantEngine/CoreTypes/MaterialParams.hpp>
+#include <KvantEngine/CoreTypes/Resource.hpp>
+#include <KvantEngine/CoreTypes/SamplerCache.hpp>
+#include <KvantEngine/CoreTypes/ShaderProgram.hpp>
+#include <KvantEngine/CoreTypes/Texture.hpp>
+
+namespace Kvant {
+
+  using MaterialId = std::uint32_t;
+
+  /*! Material template loaded from a yaml file
+   *
+   *  Names the program, the variant defines, the default textures and the
+   *  default MaterialParams values:
+   *
+   *      program:
+   *        vertex: default.vs
+   *        fragment: default.frag
+   *        defines: [KVANT_INDIRECT]
+   *      textures: [brick.png]
+   *      samplers:
+   *        - {filter: trilinear, wrap: clamp, anisotropy: 8}
+   *      params:
+   *        tint: [1.0, 1.0, 1.0, 1.0]
+   *
+   *  Parameters are floats, or vec2, vec3, vec4 and mat4 given as lists of
+   *  2, 3, 4 and 16 floats, matrices in column order. Samplers are listed
+   *  per texture unit as described in SamplerDesc::from_yaml, units
+   *  without one use SamplerCache::DEFAULT. Entities refer to a material
+   *  through a CMaterial instance, every instance without overrides
+   *  shares the template's parameter buffer and material id. Instances
+   *  overriding parameters with the same values share one buffer and id
+   *  through share_params.
+   */
+  class Material : public Resource {
+  public:
+    Material (const ResourceHandle handle, const boost::filesystem::path& filepath);
+
+    //! Identifies the template for sorting, never reused while the program runs
+    static MaterialId next_id ();
+
+    //! Makes the image available for drawing, e.g. adds it to a ResourceManager<Texture>, and returns its id
+    using TextureLoadFunc = std::function<TextureId (const ResourceHandle&)>;
+
+    /*! Loads the program and textures the file names
+     *
+     *  Both are kept so a reload of the file can load new ones.
+     */
+    void bind (ResourceManager<ShaderProgram>& shaders, TextureLoadFunc load_texture);
+
+    void on_file_modified (const boost::filesystem::path&) override;
+    void on_file_deleted (const boost::filesystem::path&) override;
+
+    /*! Picks up compiled and reloaded variants and uploads changed defaults
+     *
+     *  GL thread only. Until the variant has linked the material draws with
+     *  ShaderProgram::get_fallback.
+     */
+    void resolve ();
+
+    const Program& get_program () const { return *m_resolved; }
+    bool is_ready () const { return m_ready; }
+    MaterialId get_id () const { return m_id; }
+
+    //! Changes whenever instances have to rebuild their parameters
+    unsigned int get_revision () const { return m_revision; }
+
+    const MaterialParams& get_params () const { return *m_params; }
+
+    //! Parameter buffer and material id shared by the instances overriding the same values
+    struct SharedParams {
+      MaterialParams params;
+      MaterialId id{next_id()};
+      unsigned int revision{0};
+    };
+
+    /*! Buffer holding the defaults with overrides applied, laid out for the current program
+     *
+     *  Call after resolve. Instances with equal overrides get the same
+     *  SharedParams, and so keep batching. Ask again whenever the revision
+     *  changed.
+     */
+    std::shared_ptr<SharedParams> share_params (const MaterialParams& overrides);
+    const std::vector<ResourceHandle>& get_textures () const { return m_textures; }
+
+    //! Id the load function returned for the texture on unit, INVALID_TEXTURE before bind
+    TextureId get_texture_id (std::size_t unit) const {
+      return unit < m_texture_ids.size() ? m_texture_ids[unit] : INVALID_TEXTURE;
+    }
+
+    SamplerId get_sampler (std::size_t unit) const {
+      return unit < m_samplers.size() ? m_samplers[unit] : SamplerCache::DEFAULT;
+    }
+
+  private:
+    bool load ();
+    void load_param (const std::string& name, const YAML::Node& node);
+
+    MaterialId m_id;
+
+    std::string m_vertex_file, m_fragment_file;
+    std::vector<std::string> m_defines;
+    VariantKey m_variant_key{0};
+    std::vector<ResourceHandle> m_textures;
+    std::vector<TextureId> m_texture_ids;
+    std::vector<SamplerId> m_samplers;
+
+    ResourceManager<ShaderProgram>* m_shader_resources{nullptr};
+    TextureLoadFunc m_load_texture;
+    std::shared_ptr<ShaderProgram> m_program;
+
+    std::shared_ptr<Program> m_resolved;
+    bool m_ready{false};
+    unsigned int m_generation{0};
+    unsigned int m_revision{0};
+
+    std::unique_ptr<MaterialParams> m_params{new MaterialParams()};
+    // By MaterialParams::hash_values of the overrides, entries die with their last instance
+    std::unordered_multimap<std::uint64_t, std::weak_ptr<SharedParams>> m_shared_params;
+  };
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+// C++ Headers
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/Program.hpp>
+#include <KvantEngine/CoreTypes/UniformTypes.hpp>
+#include <KvantEngine/util/Hash.hpp>
+
+namespace Kvant {
+
+  /*! Per material values of the MaterialParams uniform block
+   *
+   *  Values are kept by name, then packed with the std140 offsets the
+   *  program reports into a uniform buffer owned by the material. The
+   *  buffer is only rewritten after a value or the layout changed, so
+   *  switching materials costs a single glBindBufferBase. Members nobody
+   *  set are zero.
+   */
+  class MaterialParams {
+  public:
+    MaterialParams () {}
+    ~MaterialParams ();
+
+    MaterialParams (const MaterialParams&) = delete;
+    MaterialParams& operator= (const MaterialParams&) = delete;
+
+    //! Type has to match the block member, members the program lacks are kept for other variants
+    template<typename T>
+    void set (NameHash name, const T& value) {
+      auto& stored = m_values[name];
+      stored.type = UniformType<T>::value;
+      stored.data.resize(sizeof(T));
+      std::memcpy(stored.data.data(), &value, sizeof(T));
+
+      if (m_block) write(name, stored);
+    }
+
+    template<typename T>
+    void set (const char* name, const T& value) { set(hash_name(name), value); }
+
+    /*! Takes the MaterialParams layout from program, repacking every value
+     *
+     *  Call whenever the material switched programs. Programs without the
+     *  block release the buffer. Members not set here start from the
+     *  values packed in defaults, which must use the same program.
+     */
+    void set_layout (const Program& program, const MaterialParams* defaults = nullptr);
+
+    //! Forgets every value, the buffer keeps its contents until the next set_layout
+    void clear () { m_values.clear(); }
+
+    bool empty () const { return m_values.empty(); }
+
+    //! Takes the values of other, packed by the next set_layout
+    void copy_values (const MaterialParams& other) { m_values = other.m_values; }
+
+    //! True if both hold the same values, regardless of layout
+    bool same_values (const MaterialParams& other) const { return m_values == other.m_values; }
+
+    //! Equal for the same values, regardless of the order they were set in
+    std::uint64_t hash_values () const;
+
+    //! Uploads to the uniform buffer if anything changed, GL thread only
+    void upload ();
+
+    //! 0 if the program has no MaterialParams block
+    GLuint get_buffer_id () const { return m_buffer_id; }
+
+  private:
+    struct Value {
+      GLenum type;
+      std::vector<unsigned char> data;
+
+      bool operator== (const Value& other) const { return type == other.type && data == other.data; }
+    };
+
+    void write (NameHash name, const Value& value);
+
+    std::unordered_map<NameHash, Value> m_values;
+
+    // Layout of the program the values were last packed for
+    bool m_block{false};
+    std::vector<UniformBlockMember> m_members;
+    std::vector<unsigned char> m_data;
+
+    GLuint m_buffer_id{0};
+    GLsizeiptr m_buffer_size{0};
+    bool m_dirty{false};
+  };
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// C++ Headers
+#include <vector>
+
+namespace Kvant {
+
+  struct PackedRect {
+    int x{0}, y{0}, width{0}, height{0};
+  };
+
+  /*! Packs rectangles into a fixed size bin with the MaxRects algorithm
+   *
+   *  Keeps the maximal free rectangles left in the bin and places every
+   *  rectangle where it leaves the shortest leftover side, which packs
+   *  sprite sheets tightly without sorting the input first, although
+   *  inserting larger rectangles first still helps. Rectangles are never
+   *  rotated, so UVs stay simple.
+   */
+  class MaxRectsPacker {
+  public:
+    MaxRectsPacker (int width, int height);
+
+    //! Returns false if the rectangle no longer fits, the bin is unchanged then
+    bool insert (int width, int height, PackedRect& result);
+
+    //! Fraction of the bin covered by inserted rectangles
+    float get_occupancy () const;
+
+    int get_width () const { return m_width; }
+    int get_height () const { return m_height; }
+
+  private:
+    void split (const PackedRect& used);
+    void prune ();
+
+    int m_width, m_height;
+    long m_used_area{0};
+    std::vector<PackedRect> m_free;
+  };
+}
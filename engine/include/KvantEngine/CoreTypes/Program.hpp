@@ -1,18 +1,88 @@
 #pragma once
 
 // C++ Headers
+#include <algorithm>
 #include <array>
+#include <vector>
 
 // OpenGL / glew Headers
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// SDL2 Headers
+#include <SDL2/SDL.h>
+
 // Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
 #include <KvantEngine/CoreTypes/Shader.hpp>
+#include <KvantEngine/CoreTypes/UniformBlocks.hpp>
+#include <KvantEngine/CoreTypes/Vertex.hpp>
+#include <KvantEngine/util/Hash.hpp>
+
+// Older glew headers predate GL_KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 namespace Kvant {
 
+  enum class LinkStatus {
+    PENDING,
+    LINKED,
+    FAILED
+  };
+
+  //! Uniform or attribute name hashed ahead of time with hash_name
+  struct HashedName {
+    NameHash value;
+  };
+
+  //! Location resolved once with Program::get_uniform or Program::get_attrib
+  struct ProgramLocation {
+    GLint value{-1};
+  };
+
+  //! Active uniform or attribute, reflected after linking
+  struct ProgramVariable {
+    NameHash hash;
+    GLint location;
+    GLenum type;
+    GLint size;
+  };
+
+  //! Member of a uniform block, offsets are in bytes from the start of the block
+  struct UniformBlockMember {
+    NameHash hash;
+    GLenum type;
+    GLint offset;
+    GLint size;
+    GLint array_stride;
+    GLint matrix_stride;
+  };
+
+  //! Active uniform block with its std140 layout as reported by the driver
+  struct UniformBlock {
+    NameHash hash;
+    GLuint index;
+    GLint data_size;
+    std::vector<UniformBlockMember> members;
+
+    const UniformBlockMember* find_member(NameHash member) const {
+      for (auto& m : members)
+        if (m.hash == member) return &m;
+      return nullptr;
+    }
+  };
+
+  /*! Linked GL program
+   *
+   *  Active uniforms and attributes are reflected once after linking into
+   *  tables sorted by name hash, so setters never query the driver. Every
+   *  setter takes a name, a HashedName or a ProgramLocation as key, the
+   *  latter two keep string hashing out of the draw loop as well. For
+   *  uniforms set every frame UniformHandle also checks the type.
+   */
   struct Program {
 
     /*! Generates program ID
@@ -27,7 +97,7 @@ namespace Kvant {
     Program(const char* vertex_path, const char* fragment_path) {
       m_program_id = glCreateProgram();
 
-      Shader shader = Shader(vertex_path, fragment_path);
+      Shader shader(vertex_path, fragment_path);
       attach_shaders(shader);
       link_program();
     }
@@ -44,6 +114,9 @@ namespace Kvant {
       delete_program();
     }
 
+    Program(const Program&) = delete;
+    Program& operator=(const Program&) = delete;
+
 
     /*! Attaches the given shaders
      *
@@ -73,21 +146,90 @@ namespace Kvant {
 
 
     //! Links program, assumes shaders have been attached
-    void link_program() const {
+    bool link_program() {
       glLinkProgram(m_program_id);
+      return finish_link(true);
+    }
 
-      // Print linkage errors if any
-      GLint success;
-      GLchar info_log[512];
-      glGetProgramiv(m_program_id, GL_LINK_STATUS, &success);
+    //! Starts linking without waiting for the driver, follow up with poll_link
+    void begin_link() {
+      glLinkProgram(m_program_id);
+      m_link_pending = true;
+    }
 
-      if(!success) {
-        glGetProgramInfoLog(m_program_id, 512, NULL, info_log);
-        spdlog::get("log")->error("ERROR::SHADER::PROGRAM::LINKING_FAILED\n {}", info_log);
-      };
+    /*! Checks on a link started with begin_link
+     *
+     *  Never blocks when parallel compilation is enabled. Without it the
+     *  first poll waits for the driver, like link_program would.
+     */
+    LinkStatus poll_link() {
+      if (m_link_pending) {
+        if (parallel_compile_enabled()) {
+          GLint completed = GL_FALSE;
+          glGetProgramiv(m_program_id, GL_COMPLETION_STATUS_KHR, &completed);
+          if (!completed) return LinkStatus::PENDING;
+        }
+        m_link_pending = false;
+        finish_link(true);
+      }
+      return m_linked ? LinkStatus::LINKED : LinkStatus::FAILED;
+    }
+
+    //! Turns on GL_KHR_parallel_shader_compile if the driver has it, once the context exists
+    static bool enable_parallel_compile() {
+      if (!SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile")) return false;
+
+      // Not every glew version knows the entry point
+      using MaxThreadsFunction = void (APIENTRY *)(GLuint);
+      auto max_threads = reinterpret_cast<MaxThreadsFunction>(SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR"));
+      if (max_threads) max_threads(0xFFFFFFFF);
+
+      parallel_compile_enabled() = true;
+      return true;
+    }
+
+    static bool& parallel_compile_enabled() {
+      static bool enabled{false};
+      return enabled;
+    }
+
+    /*! Loads a binary previously returned by get_binary
+     *
+     *  Fails quietly if the driver rejects it, the program can then still
+     *  be linked from source.
+     */
+    bool link_binary(GLenum format, const void* binary, GLsizei length) {
+      glProgramBinary(m_program_id, format, binary, length);
+      return finish_link(false);
+    }
+
+    //! Must be set before linking for get_binary to be reliable
+    void set_binary_retrievable() const {
+      glProgramParameteri(m_program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    bool get_binary(std::vector<char>& binary, GLenum& format) const {
+      GLint length = 0;
+      glGetProgramiv(m_program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+      if (length <= 0) return false;
+
+      binary.resize(length);
+      glGetProgramBinary(m_program_id, length, &length, &format, binary.data());
+      binary.resize(length);
+      return length > 0;
+    }
+
+    bool is_linked() const { return m_linked; }
+
+    //! Assigns uniform block to binding point, does nothing if program lacks the block
+    void bind_uniform_block(const GLchar* block_name, GLuint binding) const {
+      GLuint index = glGetUniformBlockIndex(m_program_id, block_name);
+      if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(m_program_id, index, binding);
     }
 
     void delete_program() const {
+      GpuMemory::instance().untrack(GpuCategory::PROGRAM, m_program_id);
       glDeleteProgram(m_program_id);
     }
 
@@ -118,82 +260,82 @@ namespace Kvant {
     // Setters
     #define ATTRIB_N_UNIFORM_SETTERS(OGL_TYPE, TYPE_PREFIX, TYPE_SUFFIX) \
 \
-    void set_attrib(const GLchar* name, OGL_TYPE v0) const \
-        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 1 ## TYPE_SUFFIX (get_attrib(name), v0); } \
-    void set_attrib(const GLchar* name, OGL_TYPE v0, OGL_TYPE v1) const \
-        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 2 ## TYPE_SUFFIX (get_attrib(name), v0, v1); } \
-    void set_attrib(const GLchar* name, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2) const \
-        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 3 ## TYPE_SUFFIX (get_attrib(name), v0, v1, v2); } \
-    void set_attrib(const GLchar* name, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2, OGL_TYPE v3) const \
-        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 4 ## TYPE_SUFFIX (get_attrib(name), v0, v1, v2, v3); } \
+    template<typename Key> void set_attrib(Key key, OGL_TYPE v0) const \
+        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 1 ## TYPE_SUFFIX (get_attrib(key), v0); } \
+    template<typename Key> void set_attrib(Key key, OGL_TYPE v0, OGL_TYPE v1) const \
+        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 2 ## TYPE_SUFFIX (get_attrib(key), v0, v1); } \
+    template<typename Key> void set_attrib(Key key, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2) const \
+        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 3 ## TYPE_SUFFIX (get_attrib(key), v0, v1, v2); } \
+    template<typename Key> void set_attrib(Key key, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2, OGL_TYPE v3) const \
+        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 4 ## TYPE_SUFFIX (get_attrib(key), v0, v1, v2, v3); } \
 \
-    void set_attrib1v(const GLchar* name, const OGL_TYPE* v) const \
-        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 1 ## TYPE_SUFFIX ## v (get_attrib(name), v); } \
-    void set_attrib2v(const GLchar* name, const OGL_TYPE* v) const \
-        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 2 ## TYPE_SUFFIX ## v (get_attrib(name), v); } \
-    void set_attrib3v(const GLchar* name, const OGL_TYPE* v) const \
-        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 3 ## TYPE_SUFFIX ## v (get_attrib(name), v); } \
-    void set_attrib4v(const GLchar* name, const OGL_TYPE* v) const \
-        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 4 ## TYPE_SUFFIX ## v (get_attrib(name), v); } \
+    template<typename Key> void set_attrib1v(Key key, const OGL_TYPE* v) const \
+        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 1 ## TYPE_SUFFIX ## v (get_attrib(key), v); } \
+    template<typename Key> void set_attrib2v(Key key, const OGL_TYPE* v) const \
+        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 2 ## TYPE_SUFFIX ## v (get_attrib(key), v); } \
+    template<typename Key> void set_attrib3v(Key key, const OGL_TYPE* v) const \
+        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 3 ## TYPE_SUFFIX ## v (get_attrib(key), v); } \
+    template<typename Key> void set_attrib4v(Key key, const OGL_TYPE* v) const \
+        { assert(is_in_use()); glVertexAttrib ## TYPE_PREFIX ## 4 ## TYPE_SUFFIX ## v (get_attrib(key), v); } \
 \
-    void set_uniform(const GLchar* name, OGL_TYPE v0) const \
-        { assert(is_in_use()); glUniform1 ## TYPE_SUFFIX (get_uniform(name), v0); } \
-    void set_uniform(const GLchar* name, OGL_TYPE v0, OGL_TYPE v1) const \
-        { assert(is_in_use()); glUniform2 ## TYPE_SUFFIX (get_uniform(name), v0, v1); } \
-    void set_uniform(const GLchar* name, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2) const \
-        { assert(is_in_use()); glUniform3 ## TYPE_SUFFIX (get_uniform(name), v0, v1, v2); } \
-    void set_uniform(const GLchar* name, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2, OGL_TYPE v3) const \
-        { assert(is_in_use()); glUniform4 ## TYPE_SUFFIX (get_uniform(name), v0, v1, v2, v3); } \
+    template<typename Key> void set_uniform(Key key, OGL_TYPE v0) const \
+        { assert(is_in_use()); glUniform1 ## TYPE_SUFFIX (get_uniform(key), v0); } \
+    template<typename Key> void set_uniform(Key key, OGL_TYPE v0, OGL_TYPE v1) const \
+        { assert(is_in_use()); glUniform2 ## TYPE_SUFFIX (get_uniform(key), v0, v1); } \
+    template<typename Key> void set_uniform(Key key, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2) const \
+        { assert(is_in_use()); glUniform3 ## TYPE_SUFFIX (get_uniform(key), v0, v1, v2); } \
+    template<typename Key> void set_uniform(Key key, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2, OGL_TYPE v3) const \
+        { assert(is_in_use()); glUniform4 ## TYPE_SUFFIX (get_uniform(key), v0, v1, v2, v3); } \
 \
-    void set_uniform1v(const GLchar* name, const OGL_TYPE* v, GLsizei count = 1) const \
-        { assert(is_in_use()); glUniform1 ## TYPE_SUFFIX ## v (get_uniform(name), count = 1, v); } \
-    void set_uniform2v(const GLchar* name, const OGL_TYPE* v, GLsizei count = 1) const \
-        { assert(is_in_use()); glUniform2 ## TYPE_SUFFIX ## v (get_uniform(name), count = 1, v); } \
-    void set_uniform3v(const GLchar* name, const OGL_TYPE* v, GLsizei count = 1) const \
-        { assert(is_in_use()); glUniform3 ## TYPE_SUFFIX ## v (get_uniform(name), count = 1, v); } \
-    void set_uniform4v(const GLchar* name, const OGL_TYPE* v, GLsizei count = 1) const \
-        { assert(is_in_use()); glUniform4 ## TYPE_SUFFIX ## v (get_uniform(name), count = 1, v); }
-
-ATTRIB_N_UNIFORM_SETTERS(GLfloat, , f);
-ATTRIB_N_UNIFORM_SETTERS(GLdouble, , d);
-ATTRIB_N_UNIFORM_SETTERS(GLint, I, i);
-ATTRIB_N_UNIFORM_SETTERS(GLuint, I, ui);
-
-    void set_uniform_matrix2(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose = GL_FALSE) const {
+    template<typename Key> void set_uniform1v(Key key, const OGL_TYPE* v, GLsizei count = 1) const \
+        { assert(is_in_use()); glUniform1 ## TYPE_SUFFIX ## v (get_uniform(key), count, v); } \
+    template<typename Key> void set_uniform2v(Key key, const OGL_TYPE* v, GLsizei count = 1) const \
+        { assert(is_in_use()); glUniform2 ## TYPE_SUFFIX ## v (get_uniform(key), count, v); } \
+    template<typename Key> void set_uniform3v(Key key, const OGL_TYPE* v, GLsizei count = 1) const \
+        { assert(is_in_use()); glUniform3 ## TYPE_SUFFIX ## v (get_uniform(key), count, v); } \
+    template<typename Key> void set_uniform4v(Key key, const OGL_TYPE* v, GLsizei count = 1) const \
+        { assert(is_in_use()); glUniform4 ## TYPE_SUFFIX ## v (get_uniform(key), count, v); }
+
+ATTRIB_N_UNIFORM_SETTERS(GLfloat, , f)
+ATTRIB_N_UNIFORM_SETTERS(GLdouble, , d)
+ATTRIB_N_UNIFORM_SETTERS(GLint, I, i)
+ATTRIB_N_UNIFORM_SETTERS(GLuint, I, ui)
+
+    template<typename Key> void set_uniform_matrix2(Key key, const GLfloat* v, GLsizei count, GLboolean transpose = GL_FALSE) const {
       assert(is_in_use());
-      glUniformMatrix2fv(get_uniform(name), count, transpose, v);
+      glUniformMatrix2fv(get_uniform(key), count, transpose, v);
     }
 
-    void set_uniform_matrix3(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose = GL_FALSE) const {
+    template<typename Key> void set_uniform_matrix3(Key key, const GLfloat* v, GLsizei count, GLboolean transpose = GL_FALSE) const {
       assert(is_in_use());
-      glUniformMatrix3fv(get_uniform(name), count, transpose, v);
+      glUniformMatrix3fv(get_uniform(key), count, transpose, v);
     }
 
-    void set_uniform_matrix4(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose = GL_FALSE) const {
+    template<typename Key> void set_uniform_matrix4(Key key, const GLfloat* v, GLsizei count, GLboolean transpose = GL_FALSE) const {
       assert(is_in_use());
-      glUniformMatrix4fv(get_uniform(name), count, transpose, v);
+      glUniformMatrix4fv(get_uniform(key), count, transpose, v);
     }
 
-    void set_uniform(const GLchar* name, const glm::mat2& m, GLboolean transpose = GL_FALSE) const {
+    template<typename Key> void set_uniform(Key key, const glm::mat2& m, GLboolean transpose = GL_FALSE) const {
       assert(is_in_use());
-      glUniformMatrix2fv(get_uniform(name), 1, transpose, glm::value_ptr(m));
+      glUniformMatrix2fv(get_uniform(key), 1, transpose, glm::value_ptr(m));
     }
 
-    void set_uniform(const GLchar* name, const glm::mat3& m, GLboolean transpose = GL_FALSE) const {
+    template<typename Key> void set_uniform(Key key, const glm::mat3& m, GLboolean transpose = GL_FALSE) const {
       assert(is_in_use());
-      glUniformMatrix3fv(get_uniform(name), 1, transpose, glm::value_ptr(m));
+      glUniformMatrix3fv(get_uniform(key), 1, transpose, glm::value_ptr(m));
     }
 
-    void set_uniform(const GLchar* name, const glm::mat4& m, GLboolean transpose = GL_FALSE) const {
+    template<typename Key> void set_uniform(Key key, const glm::mat4& m, GLboolean transpose = GL_FALSE) const {
       assert(is_in_use());
-      glUniformMatrix4fv(get_uniform(name), 1, transpose, glm::value_ptr(m));
+      glUniformMatrix4fv(get_uniform(key), 1, transpose, glm::value_ptr(m));
     }
-    void set_uniform(const GLchar* uniformName, const glm::vec3& v) const {
-      set_uniform3v(uniformName, glm::value_ptr(v));
+    template<typename Key> void set_uniform(Key key, const glm::vec3& v) const {
+      set_uniform3v(key, glm::value_ptr(v));
     }
 
-    void set_uniform(const GLchar* uniformName, const glm::vec4& v) const {
-      set_uniform4v(uniformName, glm::value_ptr(v));
+    template<typename Key> void set_uniform(Key key, const glm::vec4& v) const {
+      set_uniform4v(key, glm::value_ptr(v));
     }
 
 
@@ -202,30 +344,258 @@ ATTRIB_N_UNIFORM_SETTERS(GLuint, I, ui);
 
     //! Returns Opengl generated program ID
     GLuint get_program_id() const { return m_program_id; }
+    /*! Location the UniformHandle with index resolved in this program, nullptr until it is stored
+     *
+     *  The cache lives and dies with the program, so reloads don't leave
+     *  stale entries in the handles.
+     */
+    const ProgramLocation* find_handle_location(std::size_t index) const {
+      return index < m_handle_locations.size() && m_handle_locations[index].bound ? &m_handle_locations[index].location : nullptr;
+    }
 
-    GLint get_attrib(const GLchar* attrib_name) const {
-      if(!attrib_name)
-        spdlog::get("log")->error("ERROR::SHADER::ATTRIB_NAME_IS_NULL");
+    void store_handle_location(std::size_t index, ProgramLocation location) const {
+      if (m_handle_locations.size() <= index) m_handle_locations.resize(index + 1);
+      m_handle_locations[index] = HandleLocation{true, location};
+    }
 
-      GLint attrib = glGetAttribLocation(m_program_id, attrib_name);
-      if(attrib == -1)
-        spdlog::get("log")->error("ERROR::SHADER::ATTRIB_NOT_FOUND");
+    //! True if the model matrix is read from the instance_model attribute, see GeometryPool
+    bool supports_indirect() const { return m_supports_indirect; }
 
-      return attrib;
-    }
+    //! Reflected uniforms, sorted by name hash
+    const std::vector<ProgramVariable>& get_uniforms() const { return m_uniforms; }
+    const std::vector<ProgramVariable>& get_attribs() const { return m_attribs; }
+
+    //! Returns -1 if the program has no such active attribute
+    GLint get_attrib(const GLchar* attrib_name) const { return find(m_attribs, hash_name(attrib_name)); }
+    GLint get_attrib(HashedName attrib_name) const { return find(m_attribs, attrib_name.value); }
+    GLint get_attrib(ProgramLocation location) const { return location.value; }
 
-    GLint get_uniform(const GLchar* uniform_name) const {
-      if(!uniform_name)
-        spdlog::get("log")->error("ERROR::SHADER::UNIFORM_NAME_IS_NULL");
+    //! Returns -1 if the program has no such active uniform, setters then do nothing
+    GLint get_uniform(const GLchar* uniform_name) const { return find(m_uniforms, hash_name(uniform_name)); }
+    GLint get_uniform(HashedName uniform_name) const { return find(m_uniforms, uniform_name.value); }
+    GLint get_uniform(ProgramLocation location) const { return location.value; }
 
-      GLint uniform = glGetUniformLocation(m_program_id, uniform_name);
-      if(uniform == -1)
-        spdlog::get("log")->error("ERROR::SHADER::UNIFORM_NOT_FOUND {}", uniform_name);
+    template<typename Key>
+    bool has_uniform(Key key) const { return get_uniform(key) != -1; }
 
-      return uniform;
+    //! Reflected location, type and size of a uniform, nullptr if it isn't active
+    const ProgramVariable* find_uniform(HashedName uniform_name) const { return find_variable(m_uniforms, uniform_name.value); }
+
+    //! Returns nullptr if the program has no such active block
+    const UniformBlock* get_uniform_block(const GLchar* block_name) const { return get_uniform_block(HashedName{hash_name(block_name)}); }
+    const UniformBlock* get_uniform_block(HashedName block_name) const {
+      for (auto& block : m_blocks)
+        if (block.hash == block_name.value) return &block;
+      return nullptr;
     }
 
-    private:
+    /*! Checks a C++ struct against the block layout the driver chose
+     *
+     *  Every listed member the program uses must have the same type and
+     *  offset, and the block may not be larger than the struct. Blocks
+     *  the program doesn't use pass.
+     */
+    template<std::size_t N>
+    bool validate_block(const GLchar* block_name, const Std140Member (&layout)[N], std::size_t struct_size) const {
+      auto block = get_uniform_block(block_name);
+      if (!block) return true;
+
+      bool valid = true;
+      if ((std::size_t)block->data_size > struct_size) {
+        spdlog::get("log")->error("ERROR::SHADER::BLOCK_SIZE {} is {} bytes, C++ struct {}", block_name, block->data_size, struct_size);
+        valid = false;
+      }
+      for (auto& expected : layout) {
+        auto member = block->find_member(hash_name(expected.name));
+        if (!member) continue;
+        if (member->type != expected.type || member->offset != expected.offset) {
+          spdlog::get("log")->error("ERROR::SHADER::BLOCK_LAYOUT {}.{} at offset {}, C++ struct expects {}",
+                                    block_name, expected.name, member->offset, expected.offset);
+          valid = false;
+        }
+      }
+      return valid;
+    }
+
+        private:
+      //! Checks the link status and sets up everything that depends on a linked program
+      bool finish_link(bool log_errors) {
+        // Print linkage errors if any
+        GLint success;
+        GLchar info_log[512];
+        glGetProgramiv(m_program_id, GL_LINK_STATUS, &success);
+
+        m_linked = success;
+        if(!success) {
+          if (log_errors) {
+            glGetProgramInfoLog(m_program_id, 512, NULL, info_log);
+            spdlog::get("log")->error("ERROR::SHADER::PROGRAM::LINKING_FAILED\n {}", info_log);
+          }
+          return false;
+        };
+
+        bind_uniform_block("FrameConstants", FRAME_CONSTANTS_BINDING);
+        bind_uniform_block("ObjectConstants", OBJECT_CONSTANTS_BINDING);
+        bind_uniform_block("MaterialParams", MATERIAL_PARAMS_BINDING);
+
+        reflect();
+        validate_block("FrameConstants", FRAME_CONSTANTS_LAYOUT, sizeof(FrameConstants));
+        validate_block("ObjectConstants", OBJECT_CONSTANTS_LAYOUT, sizeof(ObjectConstants));
+        m_supports_indirect = get_attrib("instance_model") == (GLint)INSTANCE_MODEL_LOCATION;
+
+        // The closest the driver tells to what the linked code takes, 0 where binaries aren't supported
+        GLint binary_length = 0;
+        glGetProgramiv(m_program_id, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+        GpuMemory::instance().resize(GpuCategory::PROGRAM, m_program_id, std::max(binary_length, 0));
+        return true;
+      }
+
+      static const ProgramVariable* find_variable(const std::vector<ProgramVariable>& table, NameHash hash) {
+        auto it = std::lower_bound(table.begin(), table.end(), hash, [] (const ProgramVariable& variable, NameHash h) {
+          return variable.hash < h;
+        });
+        return it != table.end() && it->hash == hash ? &*it : nullptr;
+      }
+
+      static GLint find(const std::vector<ProgramVariable>& table, NameHash hash) {
+        auto variable = find_variable(table, hash);
+        return variable ? variable->location : -1;
+      }
+
+      //! Fills the uniform and attribute tables, only called after a successful link
+      void reflect() {
+        GLint count = 0, max_length = 0;
+
+        m_uniforms.clear();
+        glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+        std::vector<GLchar> name(std::max(max_length, 1));
+        for (GLint i = 0; i < count; i++) {
+          GLsizei length = 0;
+          ProgramVariable variable;
+          glGetActiveUniform(m_program_id, i, name.size(), &length, &variable.size, &variable.type, name.data());
+
+          // Members of uniform blocks have no location
+          variable.location = glGetUniformLocation(m_program_id, name.data());
+          if (variable.location == -1) continue;
+          add_variable(m_uniforms, variable, name.data(), length);
+        }
+
+        m_attribs.clear();
+        glGetProgramiv(m_program_id, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(m_program_id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+        name.resize(std::max(max_length, 1));
+        for (GLint i = 0; i < count; i++) {
+          GLsizei length = 0;
+          ProgramVariable variable;
+          glGetActiveAttrib(m_program_id, i, name.size(), &length, &variable.size, &variable.type, name.data());
+
+          // Built-ins like gl_VertexID are reported as active but have no location
+          variable.location = glGetAttribLocation(m_program_id, name.data());
+          if (variable.location == -1) continue;
+          add_variable(m_attribs, variable, name.data(), length);
+        }
+
+        reflect_blocks();
+
+        auto by_hash = [] (const ProgramVariable& a, const ProgramVariable& b) { return a.hash < b.hash; };
+        std::sort(m_uniforms.begin(), m_uniforms.end(), by_hash);
+        std::sort(m_attribs.begin(), m_attribs.end(), by_hash);
+
+        auto same_hash = [] (const ProgramVariable& a, const ProgramVariable& b) { return a.hash == b.hash; };
+        if (std::adjacent_find(m_uniforms.begin(), m_uniforms.end(), same_hash) != m_uniforms.end() ||
+            std::adjacent_find(m_attribs.begin(), m_attribs.end(), same_hash) != m_attribs.end())
+          spdlog::get("log")->error("ERROR::SHADER::PROGRAM::NAME_HASH_COLLISION in program {}", m_program_id);
+      }
+
+      void reflect_blocks() {
+        GLint count = 0, max_length = 0;
+
+        m_blocks.clear();
+        glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_length);
+        std::vector<GLchar> name(std::max(max_length, 1));
+
+        for (GLint i = 0; i < count; i++) {
+          GLsizei length = 0;
+          glGetActiveUniformBlockName(m_program_id, i, name.size(), &length, name.data());
+
+          UniformBlock block;
+          block.hash = hash_name(name.data(), length);
+          block.index = i;
+          glGetActiveUniformBlockiv(m_program_id, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.data_size);
+
+          GLint member_count = 0;
+          glGetActiveUniformBlockiv(m_program_id, i, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &member_count);
+          std::vector<GLint> indices(member_count);
+          if (member_count > 0)
+            glGetActiveUniformBlockiv(m_program_id, i, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, indices.data());
+
+          std::vector<GLuint> uniform_indices(indices.begin(), indices.end());
+          auto query = [&] (GLenum property) {
+            std::vector<GLint> values(member_count);
+            if (member_count > 0)
+              glGetActiveUniformsiv(m_program_id, member_count, uniform_indices.data(), property, values.data());
+            return values;
+          };
+          auto types = query(GL_UNIFORM_TYPE);
+          auto offsets = query(GL_UNIFORM_OFFSET);
+          auto sizes = query(GL_UNIFORM_SIZE);
+          auto array_strides = query(GL_UNIFORM_ARRAY_STRIDE);
+          auto matrix_strides = query(GL_UNIFORM_MATRIX_STRIDE);
+
+          GLint uniform_max_length = 0;
+          glGetProgramiv(m_program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &uniform_max_length);
+          std::vector<GLchar> member_name(std::max(uniform_max_length, 1));
+
+          for (GLint m = 0; m < member_count; m++) {
+            GLsizei member_length = 0;
+            glGetActiveUniformName(m_program_id, uniform_indices[m], member_name.size(), &member_length, member_name.data());
+
+            // Arrays are reported as "name[0]"
+            if (member_length > 3 && std::string(member_name.data() + member_length - 3, 3) == "[0]")
+              member_length -= 3;
+
+            UniformBlockMember member;
+            member.hash = hash_name(member_name.data(), member_length);
+            member.type = types[m];
+            member.offset = offsets[m];
+            member.size = sizes[m];
+            member.array_stride = array_strides[m];
+            member.matrix_stride = matrix_strides[m];
+            block.members.push_back(member);
+          }
+
+          m_blocks.push_back(block);
+        }
+      }
+
+      static void add_variable(std::vector<ProgramVariable>& table, ProgramVariable variable,
+                               const GLchar* name, GLsizei length) {
+        variable.hash = hash_name(name, length);
+        table.push_back(variable);
+
+        // Arrays are reported as "name[0]", make them reachable by their plain name too
+        if (length > 3 && std::string(name + length - 3, 3) == "[0]") {
+          variable.hash = hash_name(name, length - 3);
+          table.push_back(variable);
+        }
+      }
+
       GLuint m_program_id;
+      bool m_linked{false};
+      bool m_link_pending{false};
+      bool m_supports_indirect{false};
+
+      std::vector<ProgramVariable> m_uniforms;
+      std::vector<ProgramVariable> m_attribs;
+      std::vector<UniformBlock> m_blocks;
+
+      struct HandleLocation {
+        bool bound{false};
+        ProgramLocation location;
+      };
+      // Indexed by UniformHandle index, filled as handles are first set on the program
+      mutable std::vector<HandleLocation> m_handle_locations;
   };
 }
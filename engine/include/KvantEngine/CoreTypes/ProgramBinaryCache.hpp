@@ -0,0 +1,50 @@
+#pragma once
+
+// C++ Headers
+#include <cstdint>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/Program.hpp>
+
+namespace Kvant {
+
+  /*! Stores linked programs on disk with glGetProgramBinary
+   *
+   *  Entries are keyed by a hash of the final shader sources and the
+   *  driver's vendor, renderer and version strings, so a driver update
+   *  simply misses instead of feeding the driver a stale binary. Shared by
+   *  every ShaderProgram, the directory is set once the GL context exists.
+   */
+  class ProgramBinaryCache {
+  public:
+    static ProgramBinaryCache& instance ();
+
+    //! An empty directory or a driver without binary formats disables the cache
+    void set_directory (const std::string& directory);
+    bool is_enabled () const { return m_enabled; }
+
+    std::uint64_t make_key (const std::string& vertex_code, const std::string& fragment_code) const;
+
+    //! Links program from the cached binary, false on a miss or if the driver rejects it
+    bool load (Program& program, std::uint64_t key) const;
+
+    //! Program has to be linked with set_binary_retrievable
+    void store (const Program& program, std::uint64_t key) const;
+
+  private:
+    ProgramBinaryCache () {}
+
+    boost::filesystem::path get_entry_path (std::uint64_t key) const;
+
+    boost::filesystem::path m_directory;
+    std::uint64_t m_driver_hash{0};
+    bool m_enabled{false};
+  };
+}
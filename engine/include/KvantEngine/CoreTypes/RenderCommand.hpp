@@ -0,0 +1,50 @@
+#pragma once
+
+// C++ Headers
+#include <array>
+#include <cstdint>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/Program.hpp>
+
+namespace Kvant {
+
+  constexpr std::size_t MAX_TEXTURE_UNITS = 8;
+
+  /*! Everything needed to issue one draw call
+   *
+   *  Recorded on worker threads with all resources already resolved, so
+   *  replaying it on the GL thread doesn't touch the entity manager.
+   */
+  struct RenderCommand {
+    std::uint64_t sort_key{0};
+
+    // nullptr keeps the previously bound program
+    const Program* program{nullptr};
+
+    GLuint vao{0};
+    GLsizei index_count{0};
+
+    // 0 leaves whatever texture is bound to that unit
+    std::array<GLuint, MAX_TEXTURE_UNITS> textures{};
+    // GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY for a TextureArray
+    std::array<GLenum, MAX_TEXTURE_UNITS> texture_targets{};
+    // Sampler objects for the units with a texture
+    std::array<GLuint, MAX_TEXTURE_UNITS> samplers{};
+
+    // MaterialParams uniform buffer, 0 if the program has none
+    GLuint material_params{0};
+
+    // ObjectConstants location relative to the start of the frame's uniform upload
+    GLintptr object_offset{0};
+
+    // Mesh lives in the GeometryPool and can be batched into a multi draw
+    bool indirect{false};
+    GLuint first_index{0};
+    GLint base_vertex{0};
+  };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 // C++ Headers
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <boost/filesystem.hpp>
@@ -11,6 +12,22 @@ namespace Kvant {
 
   using ResourceHandle = std::string;
 
+  /*! Names a resource by its slot in a ResourceManager, looked up without hashing
+   *
+   *  The slot's generation changes when its resource is removed, so ids
+   *  handed out before stop resolving instead of naming a newer resource.
+   */
+  struct ResourceId {
+    static constexpr std::uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+    std::uint32_t index{INVALID_INDEX};
+    std::uint32_t generation{0};
+
+    bool valid () const { return index != INVALID_INDEX; }
+    bool operator== (const ResourceId& other) const { return index == other.index && generation == other.generation; }
+    bool operator!= (const ResourceId& other) const { return !(*this == other); }
+  };
+
   class Resource {
   public:
     Resource(const ResourceHandle handle, const fs::path& filepath) {
@@ -24,8 +41,20 @@ namespace Kvant {
     virtual ~Resource() {
     }
 
-    const fs::path& get_filepath () { return m_filepath; }
-    const ResourceHandle& get_handle () { return m_handle; }
+    //! True if a change to file, relative to the watched directory, affects this resource
+    virtual bool depends_on (const std::string& file) const { return file == m_handle; }
+
+    //! Called by ResourceManager when a file the resource depends on changed on disk
+    virtual void on_file_modified (const fs::path&) {}
+
+    //! Called by ResourceManager when the file was removed, base_path is the watched directory
+    virtual void on_file_deleted (const fs::path&) {}
+
+    //! Polled by ResourceManager after a file event until it returns true, for reloads finishing later
+    virtual bool finish_reload () { return true; }
+
+    const fs::path& get_filepath () const { return m_filepath; }
+    const ResourceHandle& get_handle () const { return m_handle; }
 
   protected:
     fs::path m_filepath;
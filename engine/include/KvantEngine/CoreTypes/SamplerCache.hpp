@@ -0,0 +1,73 @@
+#pragma once
+
+// C++ Headers
+#include <cstdint>
+#include <vector>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+// Third-party
+#include <yaml-cpp/yaml.h>
+
+namespace Kvant {
+
+  using SamplerId = std::uint32_t;
+
+  //! Filtering and wrapping of a texture unit
+  struct SamplerDesc {
+    GLenum min_filter{GL_LINEAR_MIPMAP_LINEAR};
+    GLenum mag_filter{GL_LINEAR};
+    GLenum wrap_s{GL_REPEAT};
+    GLenum wrap_t{GL_REPEAT};
+
+    // 1 disables anisotropic filtering, clamped to what the driver supports
+    GLfloat anisotropy{1.0f};
+
+    bool operator== (const SamplerDesc& other) const {
+      return min_filter == other.min_filter && mag_filter == other.mag_filter &&
+             wrap_s == other.wrap_s && wrap_t == other.wrap_t && anisotropy == other.anisotropy;
+    }
+
+    /*! Reads a description written as
+     *
+     *      filter: trilinear   # nearest, linear, trilinear
+     *      wrap: repeat        # repeat, clamp, mirror
+     *      anisotropy: 8
+     *
+     *  Missing keys keep their defaults.
+     */
+    static SamplerDesc from_yaml (const YAML::Node& node);
+  };
+
+  /*! Sampler objects shared by everything using the same description
+   *
+   *  Materials look their samplers up once when loaded and keep the id,
+   *  RenderSystem binds the sampler per texture unit. Samplers are never
+   *  destroyed, there are only ever a handful. GL thread only, except
+   *  get_sampler, which may be called from workers while nothing is added.
+   */
+  class SamplerCache {
+  public:
+    static SamplerCache& instance ();
+
+    //! Trilinear filtering with repeat wrapping
+    static constexpr SamplerId DEFAULT = 0;
+
+    SamplerId get_id (const SamplerDesc& desc);
+    GLuint get_sampler (SamplerId id) const;
+    const SamplerDesc& get_desc (SamplerId id) const { return m_samplers[id].desc; }
+
+  private:
+    SamplerCache ();
+
+    struct Sampler {
+      SamplerDesc desc;
+      GLuint sampler{0};
+    };
+
+    std::vector<Sampler> m_samplers;
+    GLfloat m_max_anisotropy{1.0f};
+  };
+}
@@ -17,16 +17,38 @@ namespace Kvant {
 
   struct Shader {
 
-    Shader(const char* vertex_path, const char* fragment_path) {
-      compile_shader(vertex_path, fragment_path);
+    /*! Reads and compiles both stages
+     *
+     *  @param [in] defines   Lines inserted right after the #version directive,
+     *                        usually a list of #define NAME
+     */
+    Shader(const char* vertex_path, const char* fragment_path, const std::string& defines = "") {
+      compile_shader(vertex_path, fragment_path, defines);
     }
 
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
+    //! Creates empty stages, see compile_source
+    Shader() {}
+
     //! Reads and build the shader, sets vertex and fragment id if successfull
-    void compile_shader(const char* vertex_path, const char* fragment_path) {
+    void compile_shader(const char* vertex_path, const char* fragment_path, const std::string& defines = "") {
+      std::string vertex_code, fragment_code;
+      read_sources(vertex_path, fragment_path, vertex_code, fragment_code);
+
+      if (!defines.empty()) {
+        insert_defines(vertex_code, defines);
+        insert_defines(fragment_code, defines);
+      }
+
+      compile_source(vertex_code, fragment_code);
+    }
+
+    //! Reads both stages from disk, logs and leaves the strings empty on failure
+    static bool read_sources(const char* vertex_path, const char* fragment_path,
+                             std::string& vertex_code, std::string& fragment_code) {
       using namespace std;
-      // 1. Retrieve the vertex/fragment source code from filePath
-      string vertex_code;
-      string fragment_code;
       ifstream v_shader_file;
       ifstream f_shader_file;
       // ensures ifstream objects can throw exceptions:
@@ -49,36 +71,55 @@ namespace Kvant {
       }
       catch(std::ifstream::failure e) {
         spdlog::get("log")->error("ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ  shaders: {}, {}", vertex_path, fragment_path);
+        return false;
       }
+      return true;
+    }
+
+    //! Compiles already loaded sources, sets vertex and fragment id
+    void compile_source(const std::string& vertex_code, const std::string& fragment_code) {
+      submit_source(vertex_code, fragment_code);
+      check_status();
+    }
 
+    /*! Hands both stages to the driver without waiting for the result
+     *
+     *  With GL_KHR_parallel_shader_compile the compile runs in the
+     *  background until something queries its status.
+     */
+    void submit_source(const std::string& vertex_code, const std::string& fragment_code) {
       const GLchar* v_shader_code = vertex_code.c_str();
       const GLchar* f_shader_code = fragment_code.c_str();
 
-      // 2. Compile shaders
-      GLint success;
-      GLchar info_log[512];
-
       // Vertex Shader
       m_vertex_id = glCreateShader(GL_VERTEX_SHADER);
       glShaderSource(m_vertex_id, 1, &v_shader_code, NULL);
       glCompileShader(m_vertex_id);
-      // Print compile errors if any
-      glGetShaderiv(m_vertex_id, GL_COMPILE_STATUS, &success);
-      if(!success) {
-        glGetShaderInfoLog(m_vertex_id, 512, NULL, info_log);
-        spdlog::get("log")->error("ERROR::SHADER::VERTEX::COMPILATION_FAILED\n {}", info_log);
-      };
 
       // Fragment Shader
       m_fragment_id = glCreateShader(GL_FRAGMENT_SHADER);
       glShaderSource(m_fragment_id, 1, &f_shader_code, NULL);
       glCompileShader(m_fragment_id);
-      // Print compile errors if any
-      glGetShaderiv(m_fragment_id, GL_COMPILE_STATUS, &success);
-      if(!success) {
+    }
+
+    //! Waits for the compile and prints errors if any, returns true if both stages compiled
+    bool check_status() const {
+      GLint vertex_success, fragment_success;
+      GLchar info_log[512];
+
+      glGetShaderiv(m_vertex_id, GL_COMPILE_STATUS, &vertex_success);
+      if(!vertex_success) {
+        glGetShaderInfoLog(m_vertex_id, 512, NULL, info_log);
+        spdlog::get("log")->error("ERROR::SHADER::VERTEX::COMPILATION_FAILED\n {}", info_log);
+      };
+
+      glGetShaderiv(m_fragment_id, GL_COMPILE_STATUS, &fragment_success);
+      if(!fragment_success) {
         glGetShaderInfoLog(m_fragment_id, 512, NULL, info_log);
         spdlog::get("log")->error("ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n {}", info_log);
       };
+
+      return vertex_success && fragment_success;
     }
 
     ~Shader() {
@@ -87,12 +128,22 @@ namespace Kvant {
       glDeleteShader(m_fragment_id);
     }
 
+    //! #version has to stay the first statement, so defines go on the line after it
+    static void insert_defines(std::string& code, const std::string& defines) {
+      std::size_t position = 0;
+      if (code.compare(0, 8, "#version") == 0) {
+        position = code.find('\n');
+        position = position == std::string::npos ? code.size() : position + 1;
+      }
+      code.insert(position, defines);
+    }
+
     GLuint get_vertex_id() const { return m_vertex_id; }
     GLuint get_fragment_id() const { return m_fragment_id; }
 
   private:
     // Identifiers
-    GLuint m_vertex_id, m_fragment_id;
+    GLuint m_vertex_id{0}, m_fragment_id{0};
 
   };
 }
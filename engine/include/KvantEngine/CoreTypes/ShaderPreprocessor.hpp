@@ -0,0 +1,35 @@
+#pragma once
+
+// C++ Headers
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace Kvant {
+
+  /*! Resolves #include "file" directives in GLSL sources
+   *
+   *  Include paths are relative to the include directory, usually the
+   *  shaders directory. Every file is pasted at most once, so shared
+   *  headers don't need guards, and cycles are reported as errors.
+   *  #line directives keep compiler messages pointing at the right line,
+   *  the source string number indexes get_files ().
+   */
+  class ShaderPreprocessor {
+  public:
+    ShaderPreprocessor (const boost::filesystem::path& include_dir) : m_include_dir(include_dir) {}
+
+    //! Returns false and logs if a file is missing or includes itself
+    bool process (const std::string& file, std::string& output);
+
+    //! Every file pasted into the last output, the processed file first
+    const std::vector<std::string>& get_files () const { return m_files; }
+
+  private:
+    bool process_file (const std::string& file, std::string& output, std::vector<std::string>& stack);
+
+    boost::filesystem::path m_include_dir;
+    std::vector<std::string> m_files;
+  };
+}
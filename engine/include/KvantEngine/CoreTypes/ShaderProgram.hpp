@@ -0,0 +1,125 @@
+#pragma once
+
+// C++ Headers
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/Resource.hpp>
+#include <KvantEngine/CoreTypes/Program.hpp>
+#include <KvantEngine/CoreTypes/Shader.hpp>
+
+namespace Kvant {
+
+  using VariantKey = std::uint64_t;
+
+  /*! Program built from a vertex and fragment shader pair and a set of defines
+   *
+   *  Shared through ResourceManager<ShaderProgram>, so every material using
+   *  the same sources and defines points at a single GL program. Sources go
+   *  through ShaderPreprocessor, so they may #include shared files.
+   *
+   *  On top of the base defines, materials can ask for variants with extra
+   *  defines. A variant is submitted the first time it is requested and
+   *  cached by its VariantKey, so permutations nobody uses cost nothing.
+   *
+   *  Compiling never blocks: programs are submitted to the driver and
+   *  polled until they link, using GL_KHR_parallel_shader_compile when
+   *  available. Until then get_variant returns nullptr and materials draw
+   *  with get_fallback.
+   *
+   *  When a source file or one of its includes changes, the sources are
+   *  read on a background thread and every variant is resubmitted. A
+   *  variant only replaces the old one if it links, and get_generation
+   *  changes whenever one did.
+   */
+  class ShaderProgram : public Resource {
+  public:
+    ShaderProgram (const ResourceHandle handle, const boost::filesystem::path& base_path,
+                   const std::string& vertex_file, const std::string& fragment_file,
+                   const std::vector<std::string>& defines = {});
+
+    //! Resources with equal sources and defines share a handle, define order doesn't matter
+    static ResourceHandle make_handle (const std::string& vertex_file, const std::string& fragment_file,
+                                       std::vector<std::string> defines = {});
+
+    //! Sorts and deduplicates defines, equal sets give equal keys
+    static VariantKey make_variant_key (std::vector<std::string>& defines);
+
+    //! Minimal textured program compiled from embedded source, drawn while the real one compiles
+    static std::shared_ptr<Program> get_fallback ();
+
+    //! Deletes the fallback program, Engine calls it on shutdown while the GL context still exists
+    static void release_fallback ();
+
+    bool depends_on (const std::string& file) const override;
+    void on_file_modified (const boost::filesystem::path&) override;
+    void on_file_deleted (const boost::filesystem::path&) override;
+
+    //! Polls the sources and every pending variant, true once nothing is left in flight
+    bool finish_reload () override;
+
+    //! The variant without extra defines, nullptr until it linked
+    std::shared_ptr<Program> get_program_ptr () const;
+
+    /*! Returns the variant for a set of extra defines, nullptr while it compiles
+     *
+     *  Must be called on the GL thread. The first call submits the
+     *  variant, later calls poll it. defines have to be normalized by
+     *  make_variant_key, which also produced key.
+     */
+    std::shared_ptr<Program> get_variant (VariantKey key, const std::vector<std::string>& defines);
+
+    //! Changes whenever a variant finished linking
+    unsigned int get_generation () const { return m_generation; }
+
+    const std::vector<std::string>& get_defines () const { return m_defines; }
+
+  protected:
+    struct Sources {
+      std::string vertex_code, fragment_code;
+      std::vector<std::string> files;
+      bool valid{false};
+    };
+
+    struct Variant {
+      std::vector<std::string> defines;
+
+      // Last program that linked
+      std::shared_ptr<Program> program;
+
+      // Submitted and not done linking yet, the shaders are kept for their logs
+      std::shared_ptr<Program> pending;
+      std::unique_ptr<Shader> pending_shader;
+      std::uint64_t pending_cache_key{0};
+    };
+
+    static Sources load_sources (const boost::filesystem::path& base_path,
+                                 const std::string& vertex_file, const std::string& fragment_file);
+
+    //! Starts building variant from sources, from the binary cache if it holds these exact sources
+    void submit (Variant& variant, const Sources& sources);
+
+    //! Returns true once variant has nothing in flight
+    bool poll (Variant& variant);
+
+    boost::filesystem::path m_base_path;
+    std::string m_vertex_file, m_fragment_file;
+    std::vector<std::string> m_defines;
+
+    Sources m_sources;
+    std::unordered_map<VariantKey, Variant> m_variants;
+    VariantKey m_default_key;
+    unsigned int m_generation{0};
+
+    std::future<Sources> m_pending_sources;
+    // Set when a file changed while m_pending_sources was still reading
+    bool m_reread_sources{false};
+  };
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 // C++ Headers
+#include <cstdint>
+#include <memory>
 #include <string>
 
 #include <boost/filesystem.hpp>
@@ -9,87 +11,94 @@
 #define GL3_PROTOTYPES 1
 #include <GL/glew.h>
 
-// SDL2 Headers
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
-
-// Third party
-#include <spdlog/spdlog.h>
-
 // Kvant Headers
 #include <KvantEngine/CoreTypes/Resource.hpp>
+#include <KvantEngine/CoreTypes/TextureLoader.hpp>
 
 namespace Kvant {
   using namespace std;
 
+  //! Index of an image in its State's texture table, see State::get_texture_id
+  using TextureId = std::uint32_t;
+  constexpr TextureId INVALID_TEXTURE = 0xFFFFFFFF;
+
+  /*! 2D texture loaded from an image file
+   *
+   *  Textures always have a full mip chain, filtering and wrapping come
+   *  from the sampler objects in SamplerCache. KTX files, e.g. made with
+   *  tools/texture_compressor, stay BC compressed in video memory and
+   *  bring their own mip levels.
+   *
+   *  Construction only starts decoding the file on a TextureLoader thread,
+   *  until it is uploaded m_id names the shared placeholder. ResourceManager
+   *  polls finish_reload, which streams the pixels into a new texture over
+   *  as many frames as the upload budget needs and then swaps it in. Reloads
+   *  work the same way and keep showing the previous image meanwhile.
+   *
+   *  The decoded pixels stay in system memory, so TextureStreamer can drop
+   *  the largest levels from video memory and bring them back without
+   *  touching the file. Changing the resident level uploads a new texture
+   *  with the remaining levels and swaps it in the same way.
+   */
   struct Texture : public Resource {
-    Texture (const ResourceHandle handle, const boost::filesystem::path& filepath) : Resource(handle, filepath) {
-      glGenTextures(1, &m_id);
-      glBindTexture(GL_TEXTURE_2D, m_id);
-
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-      glBindTexture(GL_TEXTURE_2D, 0);
-
-      load_image(filepath);
-    }
-
-    ~Texture () {
-      glDeleteTextures(1, &m_id);
-    }
-
-    void load_image (const boost::filesystem::path& filepath) {
-      string file = filepath.string();
-      SDL_Surface *tex = IMG_Load(file.c_str());
-      if(!tex) {
-        spdlog::get("log")->error("Failed to load texture {} with error:\n {}", file, IMG_GetError());
-        return;
-      }
-
-      if ( (tex->w & (tex->w-1)) != 0 ) {
-        spdlog::get("log")->warn("Warning: {}'s width is not a power of 2", file);
-      }
-      if ( (tex->h & (tex->h-1)) != 0 ) {
-        spdlog::get("log")->warn("Warning: {}'s height is not a power of 2", file);
-      }
-
-      auto number_of_colors = tex->format->BytesPerPixel;
-      GLenum texture_format;
-      switch (number_of_colors) {
-        case 4:
-          if (tex->format->Rmask == 0x000000ff)
-            texture_format = GL_RGBA;
-          else
-            texture_format = GL_BGRA;
-          break;
-        case 3:
-          if (tex->format->Rmask == 0x000000ff)
-            texture_format = GL_RGB;
-          else
-            texture_format = GL_BGR;
-          break;
-        default:
-          spdlog::get("log")->warn("Warning: {} is not truecolor.. could lead to undefined behavior", file);
-          texture_format = GL_RGB;
-          break;
-      }
-
-      glBindTexture(GL_TEXTURE_2D, m_id);
-
-      glTexImage2D(GL_TEXTURE_2D, 0, texture_format, tex->w, tex->h,
-                    0, texture_format, GL_UNSIGNED_BYTE, tex->pixels);
-
-      SDL_FreeSurface(tex);
-      glBindTexture(GL_TEXTURE_2D, 0);
-    }
-
-    void bind (GLuint unit) {
-      assert (unit <= 31);
-      glActiveTexture (GL_TEXTURE0 + unit);
-      glBindTexture (GL_TEXTURE_2D, m_id);
-    }
+    Texture (const ResourceHandle handle, const boost::filesystem::path& filepath);
+    ~Texture ();
+
+    Texture (const Texture&) = delete;
+    Texture& operator= (const Texture&) = delete;
+
+    //! Starts decoding filepath, the current image stays until the new one is uploaded
+    void load_image (const boost::filesystem::path& filepath);
+
+    void on_file_modified (const boost::filesystem::path& filepath) override;
+    void on_file_deleted (const boost::filesystem::path& base_path) override;
+
+    //! Uploads within this frame's budget, true once no decode or upload is left
+    bool finish_reload () override;
+
+    void bind (GLuint unit);
+
+    //! False while the placeholder is shown
+    bool is_loaded () const { return m_owns_id; }
+
+    /*! Keeps the mip levels from level on in video memory, level 0 is the full image
+     *
+     *  Takes effect once the new levels are uploaded, clamped to the
+     *  smallest level. Ignored until the image is decoded.
+     */
+    void set_resident_level (GLsizei level);
+
+    //! Resident level currently drawn
+    GLsizei get_resident_level () const { return m_resident_level; }
+
+    //! Level that is or will be resident once uploads finish
+    GLsizei get_target_level () const { return m_upload_id ? m_upload_level : m_resident_level; }
+
+    //! True while a reload or residency change is being uploaded
+    bool is_streaming () const { return m_decode || m_upload_id; }
+
+    //! Video memory the levels from level on take
+    std::size_t get_level_bytes (GLsizei level) const;
 
     GLuint m_id{0};
+    GLenum m_internal_format{0};
+    // Size of level 0 and levels in the image, whatever is resident
+    GLsizei m_width{0}, m_height{0};
+    GLsizei m_mip_levels{0};
+
+  private:
+    void start_upload (GLsizei level);
+
+    // m_id is the shared placeholder until the first upload finished
+    bool m_owns_id{false};
+
+    std::shared_ptr<DecodeJob> m_decode;
+    // Last decoded image, kept to stream levels in again
+    std::shared_ptr<DecodeJob> m_image;
+    GLsizei m_resident_level{0};
+
+    GLuint m_upload_id{0};
+    GLsizei m_upload_level{0};
+    UploadProgress m_upload_progress;
   };
 }
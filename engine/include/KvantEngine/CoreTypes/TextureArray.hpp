@@ -0,0 +1,87 @@
+#pragma once
+
+// C++ Headers
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/Resource.hpp>
+#include <KvantEngine/CoreTypes/TextureLoader.hpp>
+
+namespace Kvant {
+
+  /*! Images of the same size stacked into the layers of one GL_TEXTURE_2D_ARRAY
+   *
+   *  Loaded from a yaml file in the textures directory:
+   *
+   *      layers: [walk_0.png, walk_1.png, walk_2.png]
+   *
+   *  Every image keeps its own texture coordinates, sprites drawing
+   *  different layers bind the same texture and batch like sprites on one
+   *  atlas page, without remapping or bleeding between neighbours.
+   *  RenderSystem passes the layer per draw in ObjectConstants, programs
+   *  sample it with sampler2DArray under the KVANT_TEXTURE_ARRAY define.
+   *
+   *  Layers need the size and format of the first image that decodes,
+   *  others are left blank with an error. Decoding and mip generation run
+   *  on the TextureLoader threads and the layers are streamed in within
+   *  the upload budget, the array placeholder shows until all are in.
+   *  Arrays stay fully resident, TextureStreamer doesn't manage them.
+   */
+  class TextureArray : public Resource {
+  public:
+    TextureArray (const ResourceHandle handle, const boost::filesystem::path& filepath);
+    ~TextureArray ();
+
+    TextureArray (const TextureArray&) = delete;
+    TextureArray& operator= (const TextureArray&) = delete;
+
+    //! Layer holding image, -1 if it isn't part of the array
+    GLint get_layer (const ResourceHandle& image) const;
+
+    const std::vector<ResourceHandle>& get_images () const { return m_images; }
+
+    GLuint get_texture () const { return m_id; }
+    //! 0 while the placeholder is shown
+    GLenum get_internal_format () const { return m_owns_id ? m_internal_format : 0; }
+    bool is_loaded () const { return m_owns_id; }
+
+    //! Changes whenever images may have moved to other layers
+    unsigned int get_revision () const { return m_revision; }
+
+    bool depends_on (const std::string& file) const override;
+    void on_file_modified (const boost::filesystem::path&) override;
+
+    //! Uploads layers within this frame's budget, true once every layer is in
+    bool finish_reload () override;
+
+  private:
+    bool load ();
+    //! Makes every decoded layer match the first valid one, nullptr if none decoded
+    const DecodedImage* match_layers ();
+
+    std::vector<ResourceHandle> m_images;
+    // Layers of the texture shown, replaced along with it
+    std::unordered_map<ResourceHandle, GLint> m_layers;
+    std::unordered_map<ResourceHandle, GLint> m_pending_layers;
+    unsigned int m_revision{0};
+
+    GLuint m_id{0};
+    bool m_owns_id{false};
+    GLenum m_internal_format{0};
+
+    // One per layer, decoded and cached like any Texture
+    std::vector<std::shared_ptr<DecodeJob>> m_decodes;
+    GLuint m_upload_id{0};
+    GLsizei m_upload_layer{0};
+    UploadProgress m_upload_progress;
+  };
+}
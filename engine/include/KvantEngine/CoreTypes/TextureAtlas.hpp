@@ -0,0 +1,117 @@
+#pragma once
+
+// C++ Headers
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/Resource.hpp>
+#include <KvantEngine/CoreTypes/TextureLoader.hpp>
+#include <KvantEngine/CoreTypes/Vertex.hpp>
+
+namespace Kvant {
+
+  //! Where an image ended up inside an atlas
+  struct AtlasRegion {
+    std::size_t page{0};
+
+    // In pixels of the page, without padding
+    GLsizei x{0}, y{0}, width{0}, height{0};
+
+    // uv in the image maps to uv_offset + uv * uv_scale in the page
+    glm::vec2 uv_offset, uv_scale;
+
+    glm::vec2 remap (const glm::vec2& uv) const { return uv_offset + uv * uv_scale; }
+
+    //! Moves texture coordinates meant for the whole image into the region
+    void remap (std::vector<Vertex>& vertices) const {
+      for (auto& vertex : vertices) vertex.tex_coord = remap(vertex.tex_coord);
+    }
+
+    bool operator== (const AtlasRegion& other) const {
+      return page == other.page && x == other.x && y == other.y && width == other.width && height == other.height;
+    }
+  };
+
+  /*! Small images packed into a few shared textures
+   *
+   *  Loaded from a yaml file in the textures directory:
+   *
+   *      page_size: 1024
+   *      padding: 2
+   *      images: [icon_play.png, icon_stop.png]
+   *
+   *  Images are packed with MaxRectsPacker as soon as the atlas is created,
+   *  reading only the image headers, so regions are available right away
+   *  and meshes can be built with remapped UVs. The pixels are decoded and
+   *  composed into pages on the TextureLoader threads and streamed in like
+   *  any Texture, pages show the placeholder until then. Padding repeats
+   *  the edge pixels of every image to keep filtering from bleeding, pages
+   *  only get the mip levels it still covers, floor(log2(padding)) + 1.
+   */
+  class TextureAtlas : public Resource {
+  public:
+    TextureAtlas (const ResourceHandle handle, const boost::filesystem::path& filepath);
+    ~TextureAtlas ();
+
+    TextureAtlas (const TextureAtlas&) = delete;
+    TextureAtlas& operator= (const TextureAtlas&) = delete;
+
+    //! nullptr if image isn't part of the atlas
+    const AtlasRegion* get_region (const ResourceHandle& image) const;
+
+    const std::vector<ResourceHandle>& get_images () const { return m_images; }
+
+    std::size_t get_page_count () const { return m_pages.size(); }
+    GLuint get_page_texture (std::size_t page) const { return m_pages[page].id; }
+    bool is_loaded () const { return m_loaded; }
+
+    //! Changes whenever images may have moved to other pages
+    unsigned int get_revision () const { return m_revision; }
+
+    bool depends_on (const std::string& file) const override;
+    void on_file_modified (const boost::filesystem::path&) override;
+
+    //! Uploads pages within this frame's budget, true once every page is in
+    bool finish_reload () override;
+
+  private:
+    struct Page {
+      GLsizei width{0}, height{0};
+      GLuint id{0};
+      bool owns_id{false};
+
+      GLuint upload_id{0};
+      UploadProgress progress;
+    };
+
+    struct ComposeJob {
+      std::atomic<bool> done{false};
+      std::vector<DecodedImage> pages;
+    };
+
+    bool load ();
+    bool pack (std::unordered_map<ResourceHandle, AtlasRegion>& regions, std::vector<Page>& pages) const;
+    void compose ();
+
+    std::vector<ResourceHandle> m_images;
+    GLsizei m_page_size{1024};
+    GLsizei m_padding{2};
+
+    std::unordered_map<ResourceHandle, AtlasRegion> m_regions;
+    std::vector<Page> m_pages;
+    bool m_loaded{false};
+    unsigned int m_revision{0};
+
+    std::shared_ptr<ComposeJob> m_job;
+  };
+}
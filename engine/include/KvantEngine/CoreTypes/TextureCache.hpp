@@ -0,0 +1,51 @@
+#pragma once
+
+// C++ Headers
+#include <cstdint>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/TextureLoader.hpp>
+
+namespace Kvant {
+
+  /*! Stores decoded images with their mip chain on disk
+   *
+   *  Entries hold the levels exactly as they are uploaded behind a small
+   *  header, keyed by a hash of the source path, size and modification
+   *  time, so an edited image simply misses. Hits are memory mapped and
+   *  TextureLoader copies the levels straight from the mapping into its
+   *  pixel buffers, nothing is decoded or read into an intermediate
+   *  buffer. Entries of old versions of a file are left behind, deleting
+   *  the directory is always safe.
+   *
+   *  The directory is set once at startup, afterwards loader threads use
+   *  the cache concurrently.
+   */
+  class TextureCache {
+  public:
+    static TextureCache& instance ();
+
+    //! An empty directory disables the cache
+    void set_directory (const std::string& directory);
+    bool is_enabled () const { return m_enabled; }
+
+    //! Identifies the current contents of source, 0 if it can't be read
+    std::uint64_t make_key (const boost::filesystem::path& source) const;
+
+    //! Maps the entry for key into image, false on a miss or a damaged entry
+    bool load (std::uint64_t key, DecodedImage& image) const;
+
+    void store (std::uint64_t key, const DecodedImage& image) const;
+
+  private:
+    TextureCache () {}
+
+    boost::filesystem::path get_entry_path (std::uint64_t key) const;
+
+    boost::filesystem::path m_directory;
+    bool m_enabled{false};
+  };
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+// C++ Headers
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+// Kvant Headers
+#include <KvantEngine/util/JobQueue.hpp>
+#include <KvantEngine/util/MappedFile.hpp>
+
+namespace Kvant {
+
+  //! Decoded pixels with their mip chain, rows top to bottom
+  struct DecodedImage {
+    struct Level {
+      GLsizei width, height;
+      // Start of the level in bytes
+      std::size_t offset;
+    };
+
+    // Every level back to back, largest first
+    std::vector<unsigned char> pixels;
+    std::vector<Level> levels;
+
+    // Set instead of pixels when the levels are read straight from a TextureCache entry
+    std::shared_ptr<const MappedFile> mapping;
+    std::size_t mapping_offset{0};
+
+    //! Start of the levels, wherever they are stored
+    const unsigned char* get_data () const { return mapping ? mapping->get_data() + mapping_offset : pixels.data(); }
+    std::size_t get_size () const { return mapping ? mapping->get_size() - mapping_offset : pixels.size(); }
+
+    GLsizei width{0}, height{0};
+    // GL_RGBA8, or one of the block compressed formats for KTX files
+    GLenum internal_format{GL_RGBA8};
+    bool valid{false};
+  };
+
+  //! Pixels are stored in blocks of width by height, 1x1 for uncompressed RGBA8
+  struct BlockFormat {
+    GLsizei width, height;
+    std::size_t bytes;
+  };
+
+  //! Block layout of the formats DecodedImage can hold, compressed is false for GL_RGBA8
+  BlockFormat get_block_format (GLenum internal_format, bool* compressed = nullptr);
+
+  //! Progress of streaming a DecodedImage into a texture
+  struct UploadProgress {
+    // Level of the texture, not of the image
+    std::size_t level{0};
+    // In rows of blocks
+    GLsizei row{0};
+  };
+
+  //! Decodes file into level 0 of image as RGBA8, on any thread
+  bool decode_image (const std::string& file, DecodedImage& image);
+
+  /*! Reads a KTX 1 file holding a BC1, BC2, BC3 or BC7 texture, on any thread
+   *
+   *  The blocks are kept compressed and every mip level the file holds is
+   *  read, none are generated. Fails if the driver can't sample the format.
+   *  Sizes above max_size, GL_MAX_TEXTURE_SIZE, and more levels than such
+   *  a texture has are rejected before anything is allocated.
+   */
+  bool decode_ktx (const std::string& file, DecodedImage& image, GLsizei max_size);
+
+  //! Reads the size of an image without decoding it where the format allows
+  bool read_image_size (const boost::filesystem::path& file, GLsizei& width, GLsizei& height);
+
+  /*! Appends the mip chain down to 1x1 to an image holding only level 0
+   *
+   *  Every texel is the average of the 2x2 block above it, weighted by
+   *  alpha in linear space with downsample_srgb. Odd edges are clamped.
+   */
+  void build_mip_chain (DecodedImage& image);
+
+  //! Decode running on a loader thread, image may only be read once done is set
+  struct DecodeJob {
+    std::atomic<bool> done{false};
+    DecodedImage image;
+  };
+
+  /*! Decodes images off the GL thread and streams them into textures
+   *
+   *  Files are decoded by background threads, which also build the mip
+   *  chain and keep the result in the TextureCache for the next run, KTX
+   *  files are read as they are. Pixels are then copied into
+   *  textures through a small ring of pixel buffer objects, a few rows at a
+   *  time, so no frame uploads more than the upload budget. Shared by every
+   *  ResourceManager<Texture>, GL calls only happen on the GL thread.
+   */
+  class TextureLoader {
+  public:
+    static TextureLoader& instance ();
+
+    //! Starts decoding file on a loader thread, .ktx files stay block compressed
+    std::shared_ptr<DecodeJob> decode (const boost::filesystem::path& file);
+
+    /*! Creates a texture with the levels of image from first_level on allocated, ready for upload
+     *
+     *  Level first_level of image becomes level 0 of the texture, which
+     *  samples the same with less detail. It is tracked by GpuMemory under
+     *  owner, whoever deletes it untracks it.
+     */
+    GLuint allocate (const DecodedImage& image, const std::string& owner, std::size_t first_level = 0);
+
+    //! Runs other loading work on the loader threads
+    void run (JobQueue::Job job) { m_jobs.submit(std::move(job)); }
+
+    /*! Uploads the next rows of image into texture, continuing at progress
+     *
+     *  texture has to come from allocate with the same first_level.
+     *  Advances progress and returns true once every level is uploaded.
+     */
+    bool upload (GLuint texture, const DecodedImage& image, UploadProgress& progress, std::size_t first_level = 0);
+
+    //! Creates a GL_TEXTURE_2D_ARRAY of layers images with the size, format and levels of image, tracked like allocate
+    GLuint allocate_array (const DecodedImage& image, GLsizei layers, const std::string& owner);
+
+    //! Same as upload, into layer of a texture from allocate_array
+    bool upload_layer (GLuint texture, const DecodedImage& image, GLsizei layer, UploadProgress& progress);
+
+    //! Resets the upload budget, called once per frame
+    void begin_frame () { m_budget_left = m_budget; m_uploaded = false; }
+
+    //! Bytes uploaded per frame at most, at least one row is always uploaded
+    void set_upload_budget (std::size_t bytes) { m_budget = bytes; }
+
+    //! Transparent 1x1 texture drawn while the real one loads
+    GLuint get_placeholder ();
+
+    //! Placeholder for texture arrays, a single transparent layer
+    GLuint get_array_placeholder ();
+
+    std::size_t get_pending_decodes () { return m_jobs.get_pending_count(); }
+
+    //! Waits for the loader threads and deletes the upload buffers and placeholders, called by Engine on shutdown
+    void shutdown ();
+
+  private:
+    TextureLoader () : m_jobs(2) {}
+
+    //! Uploads rows of the current level, false once the budget is used up, layer is -1 for 2D textures
+    bool upload_rows (GLuint texture, const DecodedImage& image, UploadProgress& progress, std::size_t first_level,
+                      GLint layer = -1);
+
+    JobQueue m_jobs;
+
+    std::size_t m_budget{4 << 20};
+    std::size_t m_budget_left{4 << 20};
+    bool m_uploaded{false};
+
+    // Orphaned on every use, cycling keeps the driver from waiting for the previous copy
+    std::array<GLuint, 3> m_pbos{};
+    std::size_t m_next_pbo{0};
+
+    GLuint m_placeholder{0}, m_array_placeholder{0};
+
+    // GL_MAX_TEXTURE_SIZE, queried on the GL thread by the first decode for the loader threads
+    GLint m_max_texture_size{0};
+  };
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace Kvant {
+
+  //! Fixed binding points shared by every program
+  enum UniformBlockBinding : GLuint {
+    FRAME_CONSTANTS_BINDING = 0,
+    OBJECT_CONSTANTS_BINDING = 1,
+    MATERIAL_PARAMS_BINDING = 2
+  };
+
+  //! Member of a C++ struct mirroring a std140 block, checked against reflection
+  struct Std140Member {
+    const char* name;
+    GLenum type;
+    GLint offset;
+  };
+
+  /*! Uploaded once per camera and frame
+   *
+   *  Mirrors the std140 block
+   *    layout (std140) uniform FrameConstants { mat4 projection; mat4 camera; float time; };
+   */
+  struct FrameConstants {
+    glm::mat4 projection;
+    glm::mat4 camera;
+    float time;
+    float padding[3];
+  };
+
+  /*! Suballocated per draw from the uniform ring buffer
+   *
+   *  Mirrors the std140 block
+   *    layout (std140) uniform ObjectConstants { mat4 model; float texture_layer; };
+   *
+   *  texture_layer selects the layer of a TextureArray, 0 for other textures.
+   */
+  struct ObjectConstants {
+    glm::mat4 model;
+    float texture_layer{0.0f};
+    float padding[3];
+  };
+
+  static_assert(sizeof(FrameConstants) == 144, "FrameConstants doesn't match std140 layout");
+  static_assert(sizeof(ObjectConstants) == 80, "ObjectConstants doesn't match std140 layout");
+
+  //! Layouts validated by Program after every link
+  const Std140Member FRAME_CONSTANTS_LAYOUT[] = {
+    {"projection", GL_FLOAT_MAT4, 0},
+    {"camera", GL_FLOAT_MAT4, 64},
+    {"time", GL_FLOAT, 128}
+  };
+
+  const Std140Member OBJECT_CONSTANTS_LAYOUT[] = {
+    {"model", GL_FLOAT_MAT4, 0},
+    {"texture_layer", GL_FLOAT, 64}
+  };
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+// C++ Headers
+#include <cstddef>
+#include <type_traits>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Third-party
+#include <spdlog/spdlog.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/Program.hpp>
+#include <KvantEngine/CoreTypes/UniformTypes.hpp>
+#include <KvantEngine/util/Hash.hpp>
+
+namespace Kvant {
+
+  namespace detail {
+    inline void upload_uniform(GLint location, GLfloat v) { glUniform1f(location, v); }
+    inline void upload_uniform(GLint location, GLint v) { glUniform1i(location, v); }
+    inline void upload_uniform(GLint location, GLuint v) { glUniform1ui(location, v); }
+    inline void upload_uniform(GLint location, const glm::vec2& v) { glUniform2fv(location, 1, glm::value_ptr(v)); }
+    inline void upload_uniform(GLint location, const glm::vec3& v) { glUniform3fv(location, 1, glm::value_ptr(v)); }
+    inline void upload_uniform(GLint location, const glm::vec4& v) { glUniform4fv(location, 1, glm::value_ptr(v)); }
+    inline void upload_uniform(GLint location, const glm::ivec2& v) { glUniform2iv(location, 1, glm::value_ptr(v)); }
+    inline void upload_uniform(GLint location, const glm::ivec3& v) { glUniform3iv(location, 1, glm::value_ptr(v)); }
+    inline void upload_uniform(GLint location, const glm::ivec4& v) { glUniform4iv(location, 1, glm::value_ptr(v)); }
+    inline void upload_uniform(GLint location, const glm::mat4& v) { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(v)); }
+
+    //! Handles of every type share one index space, GL thread only like the handles
+    inline std::size_t next_handle_index() {
+      static std::size_t index{0};
+      return index++;
+    }
+
+    //! Samplers are set through their texture unit
+    inline bool is_sampler(GLenum type) {
+      switch (type) {
+        case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY:
+        case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D:
+          return true;
+        default:
+          return false;
+      }
+    }
+  }
+
+  /*! Typed uniform, looked up once per program instead of once per set
+   *
+   *  The name is hashed at compile time when the handle is constexpr or a
+   *  static, so nothing is hashed at runtime either:
+   *
+   *      static UniformHandle<glm::vec4> tint{"tint"};
+   *      tint.set(program, glm::vec4{1.0f});
+   *
+   *  Every program caches the location each handle resolved in it, at
+   *  the handle's index, so one handle can be shared by all programs and
+   *  finding the location is an index into a vector. Binding
+   *  resolves the location from the program's reflection table and
+   *  reports a missing uniform or a mismatching type once per program,
+   *  instead of every frame. The type check only runs in debug builds.
+   *  Handles are GL thread only.
+   */
+  template<typename T>
+  class UniformHandle {
+  public:
+    constexpr explicit UniformHandle(const char* name) : m_name(name), m_hash(hash_name(name)) {}
+
+    //! Location in program, -1 if it lacks the uniform and sets should be skipped
+    ProgramLocation bind(const Program& program) const {
+      auto variable = program.find_uniform(HashedName{m_hash});
+      if (!variable) {
+        spdlog::get("log")->warn("ERROR::SHADER::UNIFORM_NOT_FOUND {} in program {}", m_name, program.get_program_id());
+        return ProgramLocation{};
+      }
+
+#ifndef NDEBUG
+      bool sampler = std::is_same<T, GLint>::value && detail::is_sampler(variable->type);
+      if (variable->type != UniformType<T>::value && !sampler) {
+        spdlog::get("log")->error("ERROR::SHADER::UNIFORM_TYPE {} in program {} is 0x{:x}, set as 0x{:x}",
+                                  m_name, program.get_program_id(), variable->type, UniformType<T>::value);
+        return ProgramLocation{};
+      }
+#endif
+
+      return ProgramLocation{variable->location};
+    }
+
+    //! Sets the uniform of the program in use, location must come from bind on that program
+    void set(ProgramLocation location, const T& value) const {
+      if (location.value != -1) detail::upload_uniform(location.value, value);
+    }
+
+    //! Sets the uniform of program, which has to be in use, binding the first time it is set on program
+    void set(const Program& program, const T& value) const {
+      // Drawn on first use, so the constructor stays constexpr
+      if (m_index == NO_INDEX) m_index = detail::next_handle_index();
+
+      auto location = program.find_handle_location(m_index);
+      if (!location) {
+        program.store_handle_location(m_index, bind(program));
+        location = program.find_handle_location(m_index);
+      }
+      set(*location, value);
+    }
+
+    HashedName get_hash() const { return HashedName{m_hash}; }
+    const char* get_name() const { return m_name; }
+
+  private:
+    const char* m_name;
+    NameHash m_hash;
+
+    static constexpr std::size_t NO_INDEX = static_cast<std::size_t>(-1);
+    // Slot in Program's location cache
+    mutable std::size_t m_index{NO_INDEX};
+  };
+}
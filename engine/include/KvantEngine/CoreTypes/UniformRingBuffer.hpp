@@ -0,0 +1,68 @@
+#pragma once
+
+// C++ Headers
+#include <vector>
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+
+namespace Kvant {
+
+  /*! Streaming uniform buffer split into one region per frame in flight
+   *
+   *  Each region is guarded by a fence, so by the time the CPU wraps around
+   *  to a region the GPU is long done reading it and writes never stall.
+   *  Uses a persistently mapped buffer when ARB_buffer_storage is available
+   *  and unsynchronized glMapBufferRange otherwise.
+   */
+  class UniformRingBuffer {
+  public:
+    UniformRingBuffer (GLsizeiptr region_size = 1 << 20, unsigned int regions = 3);
+    ~UniformRingBuffer ();
+
+    UniformRingBuffer (const UniformRingBuffer&) = delete;
+    UniformRingBuffer& operator= (const UniformRingBuffer&) = delete;
+
+    //! Fences the current region and moves on to the next one
+    void next_frame ();
+
+    /*! Copies data into the current region
+     *
+     *  If the region is full the ring is reallocated, which invalidates
+     *  ranges uploaded earlier in the same frame that haven't been drawn
+     *  with yet. Upload everything a batch needs at once and bind afterwards.
+     *
+     *  @return Offset of the data in the buffer, suitable for glBindBufferRange
+     */
+    GLintptr upload (const void* data, GLsizeiptr size);
+
+    void bind_range (GLuint binding, GLintptr offset, GLsizeiptr size) const {
+      glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_buffer_id, offset, size);
+    }
+
+    //! Rounds size up to the offset alignment required by glBindBufferRange
+    GLsizeiptr align (GLsizeiptr size) const {
+      return (size + m_alignment - 1) / m_alignment * m_alignment;
+    }
+
+    GLuint get_buffer_id () const { return m_buffer_id; }
+
+  private:
+    void create_buffer ();
+    void delete_buffer ();
+    void wait_for_region (unsigned int region);
+
+    GLuint m_buffer_id{0};
+    GLsizeiptr m_region_size;
+    GLsizeiptr m_alignment{256};
+    unsigned int m_region_count;
+
+    unsigned int m_region{0};
+    GLsizeiptr m_cursor{0};
+    std::vector<GLsync> m_fences;
+
+    bool m_persistent{false};
+    unsigned char* m_mapped{nullptr};
+  };
+}
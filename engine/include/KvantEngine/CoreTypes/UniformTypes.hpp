@@ -0,0 +1,27 @@
+#pragma once
+
+// OpenGL / glew Headers
+#define GL3_PROTOTYPES 1
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace Kvant {
+
+  /*! GL type enum reported by reflection for a C++ type
+   *
+   *  Only types whose std140 representation matches their C++ memory
+   *  layout are listed, so values can be copied into blocks as is.
+   */
+  template<typename T> struct UniformType;
+
+  template<> struct UniformType<GLfloat> { static constexpr GLenum value = GL_FLOAT; };
+  template<> struct UniformType<GLint> { static constexpr GLenum value = GL_INT; };
+  template<> struct UniformType<GLuint> { static constexpr GLenum value = GL_UNSIGNED_INT; };
+  template<> struct UniformType<glm::vec2> { static constexpr GLenum value = GL_FLOAT_VEC2; };
+  template<> struct UniformType<glm::vec3> { static constexpr GLenum value = GL_FLOAT_VEC3; };
+  template<> struct UniformType<glm::vec4> { static constexpr GLenum value = GL_FLOAT_VEC4; };
+  template<> struct UniformType<glm::ivec2> { static constexpr GLenum value = GL_INT_VEC2; };
+  template<> struct UniformType<glm::ivec3> { static constexpr GLenum value = GL_INT_VEC3; };
+  template<> struct UniformType<glm::ivec4> { static constexpr GLenum value = GL_INT_VEC4; };
+  template<> struct UniformType<glm::mat4> { static constexpr GLenum value = GL_FLOAT_MAT4; };
+}
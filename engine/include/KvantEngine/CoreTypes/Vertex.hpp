@@ -11,4 +11,10 @@ namespace Kvant {
     vec3 normal;
     vec2 tex_coord;
   };
+
+  //! First of four attribute locations holding a per draw model matrix (mat4 instance_model)
+  constexpr unsigned int INSTANCE_MODEL_LOCATION = 3;
+
+  //! Attribute location of the per draw texture array layer (float instance_layer)
+  constexpr unsigned int INSTANCE_LAYER_LOCATION = INSTANCE_MODEL_LOCATION + 4;
 }
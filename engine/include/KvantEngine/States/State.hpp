@@ -1,6 +1,7 @@
 #pragma once
 
 // C++ Headers
+#include <unordered_map>
 #include <vector>
 
 // SDL2 Headers
@@ -11,8 +12,15 @@
 #include <entityx/deps/Dependencies.h>
 
 // Kvant Headers
+#include <KvantEngine/Core/PipelineWarmup.hpp>
+#include <KvantEngine/Core/RenderGraph.hpp>
 #include <KvantEngine/Core/ResourceManager.hpp>
+#include <KvantEngine/Core/TextureStreamer.hpp>
+#include <KvantEngine/CoreTypes/Material.hpp>
+#include <KvantEngine/CoreTypes/ShaderProgram.hpp>
 #include <KvantEngine/CoreTypes/Texture.hpp>
+#include <KvantEngine/CoreTypes/TextureArray.hpp>
+#include <KvantEngine/CoreTypes/TextureAtlas.hpp>
 
 namespace Kvant {
 
@@ -22,6 +30,18 @@ namespace Kvant {
   class Engine;
   struct StateManager;
 
+  //! What RenderSystem binds to draw an image
+  struct TextureBinding {
+    GLuint id{0};
+    GLenum target{GL_TEXTURE_2D};
+    // 0 while the placeholder is shown
+    GLenum internal_format{0};
+    // Layer of a TextureArray, 0 otherwise
+    GLint layer{0};
+    // Set for standalone textures, which TextureStreamer manages
+    Texture* texture{nullptr};
+  };
+
   class State {
   public:
 
@@ -52,6 +72,56 @@ namespace Kvant {
     ex::SystemManager& get_system_manager () { return m_entityx.systems; }
 
     ResourceManager<Texture>* get_texture_resources() { return &m_texture_resources; };
+    ResourceManager<ShaderProgram>* get_shader_resources() { return &m_shader_resources; };
+    ResourceManager<Material>* get_material_resources() { return &m_material_resources; };
+    ResourceManager<TextureAtlas>* get_atlas_resources() { return &m_atlas_resources; };
+    ResourceManager<TextureArray>* get_array_resources() { return &m_array_resources; };
+
+    //! Loads an image as its own texture, streamed, unless an atlas or array added before holds it
+    ResourceHandle add_texture (const std::string& file);
+
+    //! Loads an atlas file from the textures directory, its images are drawn from the atlas pages from then on
+    ResourceHandle add_atlas (const std::string& file);
+
+    //! Loads a texture array file from the textures directory, its images are drawn from their layers from then on
+    ResourceHandle add_texture_array (const std::string& file);
+
+    //! Where image is in its atlas, nullptr if it isn't in one
+    const AtlasRegion* get_atlas_region (const ResourceHandle& image);
+
+    /*! Id of image in the texture table, INVALID_TEXTURE if it was never added
+     *
+     *  Ids don't change and follow the image into atlases and arrays added
+     *  later, so components resolve their names once and drawing only
+     *  indexes tables.
+     */
+    TextureId get_texture_id (const ResourceHandle& image) const;
+
+    //! Images in the texture table, it only grows, so a change means ids that were invalid may resolve now
+    std::size_t get_texture_count () const { return m_texture_table.size(); }
+
+    /*! Texture to bind for image, its atlas page or texture array if it is in one
+     *
+     *  Returns false if nothing is loaded for image. Only reads, so
+     *  RenderSystem workers can call it concurrently.
+     */
+    bool find_texture (TextureId image, TextureBinding& binding) const;
+
+    //! Loads a material file along with the program and textures it names
+    ResourceHandle add_material (const std::string& file);
+    RenderGraph& get_render_graph () { return m_render_graph; }
+    PipelineWarmup& get_pipeline_warmup () { return m_pipeline_warmup; }
+    TextureStreamer& get_texture_streamer () { return m_texture_streamer; }
+
+    /*! Warms up the pipelines recorded under name in earlier runs, and records this run's
+     *
+     *  Recordings are kept next to the shader cache and saved on cleanup.
+     *  Does nothing if the shader cache is disabled.
+     */
+    void record_pipelines (const std::string& name);
+
+    //! False while pipelines are still being warmed up, e.g. to keep a loading screen up
+    bool is_warmed_up () const { return m_pipeline_warmup.is_done(); }
 
   protected:
     ex::EntityX m_entityx;
@@ -60,6 +130,47 @@ namespace Kvant {
     ex::Entity m_GUI_camera, m_game_camera;
 
     ResourceManager<Texture> m_texture_resources;
+    ResourceManager<ShaderProgram> m_shader_resources;
+    ResourceManager<Material> m_material_resources;
+    ResourceManager<TextureAtlas> m_atlas_resources;
+    ResourceManager<TextureArray> m_array_resources;
+
+    //! Where an image in the texture table is drawn from
+    struct TextureEntry {
+      enum Source : std::uint8_t {
+        NONE,
+        TEXTURE,
+        ATLAS,
+        ARRAY
+      };
+
+      Source source{NONE};
+      ResourceHandle image;
+      // Into the texture, atlas or array resources
+      ResourceId resource;
+      // Atlas page or array layer, -1 once the image was dropped from it
+      GLint index{0};
+      // Atlas or array revision index was read at
+      unsigned int revision{0};
+    };
+
+    //! Entry of image, added on first use
+    TextureEntry& get_texture_entry (const ResourceHandle& image);
+    //! Follows images moved by atlas and array reloads
+    void update_texture_entries ();
+
+    // Indexed by TextureId, entries are never removed
+    std::vector<TextureEntry> m_texture_table;
+    std::unordered_map<ResourceHandle, TextureId> m_texture_ids;
+
+    // Rebuilt every frame in draw ()
+    RenderGraph m_render_graph;
+
+    // Declared in on_init, warmed up over the first frames
+    PipelineWarmup m_pipeline_warmup;
+
+    // Budget from the resources config, textures drawn are requested by RenderSystem
+    TextureStreamer m_texture_streamer;
 
     Engine* m_engine;
     friend struct StateManager;
@@ -76,5 +187,12 @@ namespace Kvant {
     virtual void on_update (const float){};
     virtual void on_draw (const float){};
 
+    /*! Called every frame after the game and GUI passes are added
+     *
+     *  Passes added here can render into transient targets and read them
+     *  back, the graph takes care of ordering and target allocation.
+     */
+    virtual void on_setup_render_graph (RenderGraph&){};
+
   };
 }
@@ -0,0 +1,38 @@
+#pragma once
+
+// C++ Headers
+#include <cstdint>
+#include <string>
+
+namespace Kvant {
+
+  using NameHash = std::uint32_t;
+
+  //! 32 bit FNV-1a, hashes up to the terminator or length characters
+  constexpr NameHash hash_name (const char* str, std::size_t length = std::string::npos) {
+    NameHash hash = 2166136261u;
+    for (std::size_t i = 0; i < length && str[i] != '\0'; i++) {
+      hash ^= static_cast<unsigned char>(str[i]);
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  inline NameHash hash_name (const std::string& str) {
+    return hash_name(str.c_str(), str.size());
+  }
+
+  //! 64 bit FNV-1a over arbitrary bytes, pass the previous hash to chain several buffers
+  inline std::uint64_t hash_bytes (const void* data, std::size_t size, std::uint64_t hash = 14695981039346656037ull) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  inline std::uint64_t hash_bytes (const std::string& str, std::uint64_t hash = 14695981039346656037ull) {
+    return hash_bytes(str.data(), str.size(), hash);
+  }
+}
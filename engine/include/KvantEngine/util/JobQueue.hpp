@@ -0,0 +1,47 @@
+#pragma once
+
+// C++ Headers
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Kvant {
+
+  /*! Background threads running independent jobs in submission order
+   *
+   *  Meant for slow work like decoding files, which must not hold up
+   *  ThreadPool::parallel_for during a frame. Jobs still queued when the
+   *  queue is destroyed are dropped, running ones are waited for.
+   */
+  class JobQueue {
+  public:
+    using Job = std::function<void()>;
+
+    JobQueue (std::size_t threads = 1);
+    ~JobQueue ();
+
+    JobQueue (const JobQueue&) = delete;
+    JobQueue& operator= (const JobQueue&) = delete;
+
+    void submit (Job job);
+
+    //! Drops queued jobs and waits for the running ones, later jobs never run
+    void stop ();
+
+    //! Queued jobs not picked up by a thread yet
+    std::size_t get_pending_count ();
+
+  private:
+    void worker_loop ();
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Job> m_jobs;
+    bool m_quit{false};
+  };
+}
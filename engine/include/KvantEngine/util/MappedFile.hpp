@@ -0,0 +1,36 @@
+#pragma once
+
+// C++ Headers
+#include <cstddef>
+#include <string>
+
+namespace Kvant {
+
+  /*! Read only view of a whole file mapped into memory
+   *
+   *  Pages are read from disk when first touched, hint_will_need asks the
+   *  kernel to start reading them all in the background.
+   */
+  class MappedFile {
+  public:
+    MappedFile () {}
+    ~MappedFile ();
+
+    MappedFile (const MappedFile&) = delete;
+    MappedFile& operator= (const MappedFile&) = delete;
+
+    //! Maps file, false if it can't be opened or is empty
+    bool open (const std::string& file);
+    void close ();
+
+    void hint_will_need () const;
+
+    const unsigned char* get_data () const { return m_data; }
+    std::size_t get_size () const { return m_size; }
+    bool is_open () const { return m_data != nullptr; }
+
+  private:
+    const unsigned char* m_data{nullptr};
+    std::size_t m_size{0};
+  };
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// C++ Headers
+#include <cstddef>
+#include <cstdint>
+
+namespace Kvant {
+
+  //! Instruction sets the pixel kernels can use, each level includes the ones before it
+  enum class SimdLevel {
+    SCALAR,
+    SSSE3,
+    AVX2
+  };
+
+  /*! Best level the CPU supports, detected on first use
+   *
+   *  Kernels pick their implementation from it on every call, so
+   *  set_simd_level can force a lower one, e.g. to compare results.
+   */
+  SimdLevel get_simd_level ();
+  void set_simd_level (SimdLevel level);
+
+  //! count 3 byte RGB pixels to RGBA8 with opaque alpha
+  void convert_rgb_to_rgba (const std::uint8_t* src, std::uint8_t* dst, std::size_t count);
+
+  //! count 3 byte BGR pixels to RGBA8 with opaque alpha
+  void convert_bgr_to_rgba (const std::uint8_t* src, std::uint8_t* dst, std::size_t count);
+
+  //! count 4 byte BGRA pixels to RGBA8, src and dst may be the same
+  void convert_bgra_to_rgba (const std::uint8_t* src, std::uint8_t* dst, std::size_t count);
+
+  /*! Looks count 8 bit indices up in palette, 256 RGBA8 entries packed in memory order
+   *
+   *  Palettes with fewer colors have to be padded, there is no range check.
+   */
+  void expand_palette (const std::uint8_t* indices, const std::uint32_t* palette, std::uint8_t* dst, std::size_t count);
+
+  /*! Multiplies the color of count RGBA8 pixels by their alpha, in place, rounding to nearest
+   *
+   *  The engine blends straight alpha, so loading doesn't call it. It is
+   *  for tools and code preparing premultiplied images.
+   */
+  void premultiply_alpha (std::uint8_t* pixels, std::size_t count);
+
+  /*! Halves an RGBA8 image with sRGB colors, averaging every 2x2 block
+   *
+   *  Colors are averaged in linear space and weighted by alpha, the same
+   *  as filtering premultiplied pixels, so transparent texels don't bleed
+   *  their color into the edges. Alpha is averaged as is. Odd source
+   *  sizes clamp the last row or column, dst has to be
+   *  max(1, src_width / 2) by max(1, src_height / 2).
+   */
+  void downsample_srgb (const std::uint8_t* src, int src_width, int src_height, std::uint8_t* dst, int width, int height);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+// C++ Headers
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace Kvant {
+
+  /*! Fixed set of worker threads for data parallel work
+   *
+   *  The calling thread takes part in every job as worker 0, so a pool
+   *  constructed with 0 threads runs everything inline.
+   */
+  class ThreadPool {
+  public:
+    //! Called with the half open range [begin, end) and index of the worker running it
+    using RangeJob = std::function<void(std::size_t begin, std::size_t end, std::size_t worker)>;
+
+    ThreadPool (std::size_t threads = default_thread_count());
+    ~ThreadPool ();
+
+    ThreadPool (const ThreadPool&) = delete;
+    ThreadPool& operator= (const ThreadPool&) = delete;
+
+    //! Number of workers including the calling thread
+    std::size_t get_worker_count () const { return m_threads.size() + 1; }
+
+    /*! Splits [0, count) into batches and blocks until all are processed
+     *
+     *  @param [in] min_batch   Smallest number of items handed to a worker at once
+     */
+    void parallel_for (std::size_t count, std::size_t min_batch, const RangeJob& job);
+
+    static std::size_t default_thread_count ();
+
+  private:
+    void worker_loop (std::size_t worker);
+    void run_batches (std::size_t worker);
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_start_cv, m_done_cv;
+
+    const RangeJob* m_job{nullptr};
+    std::size_t m_count{0}, m_batch{1};
+    std::atomic<std::size_t> m_next{0};
+    std::size_t m_busy_workers{0};
+    unsigned int m_generation{0};
+    bool m_quit{false};
+  };
+}
@@ -1,11 +1,29 @@
 #include <KvantEngine/Core/Engine.hpp>
 
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+#include <KvantEngine/CoreTypes/ProgramBinaryCache.hpp>
+#include <KvantEngine/CoreTypes/SamplerCache.hpp>
+#include <KvantEngine/CoreTypes/ShaderProgram.hpp>
+#include <KvantEngine/CoreTypes/TextureCache.hpp>
+#include <KvantEngine/CoreTypes/TextureLoader.hpp>
+
 namespace Kvant {
 
   Engine::Engine (std::string config_dir) : m_game_config(config_dir), m_window(this), m_state_manager(this), m_log(spd::stdout_color_mt("log")) {
     m_log->info("Welcome to KvantEngine.");
     m_window.init();
 
+    auto resources = m_game_config.get<ResourcesConfig>();
+    ProgramBinaryCache::instance().set_directory(resources->shader_cache_path);
+    TextureCache::instance().set_directory(resources->texture_cache_path);
+
+    if (Program::enable_parallel_compile())
+      m_log->info("Compiling shaders in parallel with GL_KHR_parallel_shader_compile");
+
+    // Creates the default sampler, RenderSystem workers only ever read the cache
+    SamplerCache::instance();
+
     // bind imgui to window
     ImGui_ImplSdlGL3_Init (get_window().get_sdl_window());
   }
@@ -51,6 +69,7 @@ namespace Kvant {
 
   void Engine::update_phase () {
     ImGui_ImplSdlGL3_NewFrame(get_window().get_sdl_window());
+    TextureLoader::instance().begin_frame();
     m_state_manager.update(m_dt);
   }
 
@@ -66,8 +85,11 @@ namespace Kvant {
   }
 
   void Engine::cleanup_phase () {
-    m_window.cleanup();
+    // States delete their GL objects, the context has to outlive them
     m_state_manager.cleanup();
+    ShaderProgram::release_fallback();
+    TextureLoader::instance().shutdown();
+    m_window.cleanup();
   }
 
   bool Engine::handle_quit_events (const SDL_Event& event) {
@@ -104,8 +126,16 @@ namespace Kvant {
 
     ImGui::Checkbox("Node tree", &m_imgui_state.show_node_tree);
     ImGui::Checkbox("Inspector", &m_imgui_state.show_inspector);
+
+    auto& gpu_memory = GpuMemory::instance();
+    ImGui::Checkbox("GPU memory", &m_imgui_state.show_gpu_memory);
+    ImGui::SameLine();
+    ImGui::Text("%.2f MB", gpu_memory.get_total() / (1024.0 * 1024.0));
     ImGui::End();
 
+    if (m_imgui_state.show_gpu_memory)
+      gpu_memory.draw_imgui(&m_imgui_state.show_gpu_memory);
+
     ImGui::Render();
   }
 
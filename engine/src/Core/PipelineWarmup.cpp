@@ -0,0 +1,267 @@
+#include <KvantEngine/Core/PipelineWarmup.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <fstream>
+
+// Third party
+#include <spdlog/spdlog.h>
+#include <yaml-cpp/yaml.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+#include <KvantEngine/CoreTypes/UniformBlocks.hpp>
+#include <KvantEngine/CoreTypes/Vertex.hpp>
+
+namespace Kvant {
+
+  namespace fs = boost::filesystem;
+
+  // Materials not ready after this many frames probably failed to compile
+  constexpr unsigned int MAX_PENDING_FRAMES = 600;
+
+  // Guaranteed minimum of GL_MAX_UNIFORM_BLOCK_SIZE, enough for any block
+  constexpr GLsizeiptr DUMMY_UNIFORMS_SIZE = 16384;
+
+  PipelineWarmup::~PipelineWarmup () {
+    if (!m_fbo) return;
+
+    auto& memory = GpuMemory::instance();
+    memory.untrack(GpuCategory::FRAMEBUFFER, m_fbo);
+    memory.untrack(GpuCategory::TEXTURE, m_color);
+    for (auto buffer : {m_uniforms, m_vbo, m_ebo, m_draw_data}) memory.untrack(GpuCategory::BUFFER, buffer);
+    for (auto vao : {m_mesh_vao, m_pool_vao}) memory.untrack(GpuCategory::VERTEX_ARRAY, vao);
+    for (auto& entry : m_textures) memory.untrack(GpuCategory::TEXTURE, entry.second);
+
+    glDeleteFramebuffers(1, &m_fbo);
+    glDeleteTextures(1, &m_color);
+    glDeleteBuffers(1, &m_uniforms);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ebo);
+    glDeleteBuffers(1, &m_draw_data);
+    glDeleteVertexArrays(1, &m_mesh_vao);
+    glDeleteVertexArrays(1, &m_pool_vao);
+    for (auto& entry : m_textures) glDeleteTextures(1, &entry.second);
+  }
+
+  bool PipelineWarmup::contains (const std::vector<PipelineKey>& keys, const PipelineKey& key) const {
+    return std::find(keys.begin(), keys.end(), key) != keys.end();
+  }
+
+  void PipelineWarmup::declare (const PipelineKey& key) {
+    if (contains(m_known, key)) return;
+
+    m_known.push_back(key);
+    m_queue.push_back(Pending{key, 0});
+  }
+
+  void PipelineWarmup::add_recorded (const PipelineKey& key) {
+    if (!contains(m_recorded, key)) m_recorded.push_back(key);
+  }
+
+  void PipelineWarmup::set_record_file (const fs::path& file) {
+    m_record_file = file;
+    if (!fs::exists(file)) return;
+
+    YAML::Node root;
+    try {
+      root = YAML::LoadFile(file.string());
+    }
+    catch (const YAML::Exception& e) {
+      spdlog::get("log")->warn("Ignoring recorded pipelines {}: {}", file.string(), e.what());
+      return;
+    }
+
+    for (auto node : root) {
+      PipelineKey key;
+      // Stale or hand edited files lose the broken entries only
+      try {
+        key.material = node["material"].as<std::string>();
+        key.layout = node["layout"].as<std::string>() == "pool" ? VertexLayout::POOL : VertexLayout::MESH;
+        key.texture_format = node["texture_format"].as<GLenum>();
+      }
+      catch (const YAML::Exception& e) {
+        spdlog::get("log")->warn("Skipping a recorded pipeline in {}: {}", file.string(), e.what());
+        continue;
+      }
+
+      // Kept even if this run never draws it, a later state might
+      add_recorded(key);
+      declare(key);
+    }
+  }
+
+  bool PipelineWarmup::save () const {
+    if (m_record_file.empty()) return false;
+
+    YAML::Node root;
+    for (auto& key : m_recorded) {
+      YAML::Node node;
+      node["material"] = key.material;
+      node["layout"] = key.layout == VertexLayout::POOL ? "pool" : "mesh";
+      node["texture_format"] = key.texture_format;
+      root.push_back(node);
+    }
+
+    boost::system::error_code error;
+    fs::create_directories(m_record_file.parent_path(), error);
+
+    std::ofstream file(m_record_file.string());
+    if (!file) {
+      spdlog::get("log")->warn("Couldn't write recorded pipelines to {}", m_record_file.string());
+      return false;
+    }
+    file << root;
+    return true;
+  }
+
+  bool PipelineWarmup::step (ResourceManager<Material>& materials) {
+    if (m_queue.empty()) return true;
+    if (!m_fbo) setup();
+
+    GLint previous_fbo = 0;
+    GLint previous_viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_fbo);
+    glGetIntegerv(GL_VIEWPORT, previous_viewport);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
+    glViewport(0, 0, 1, 1);
+    for (GLuint binding : {FRAME_CONSTANTS_BINDING, OBJECT_CONSTANTS_BINDING, MATERIAL_PARAMS_BINDING})
+      glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_uniforms);
+
+    // Every entry is looked at once per frame at most, compiling ones go to the back
+    std::size_t remaining = m_queue.size();
+    unsigned int drawn = 0;
+    while (remaining-- > 0 && drawn < m_budget) {
+      auto pending = m_queue.front();
+      m_queue.pop_front();
+
+      auto material = materials.get(pending.key.material);
+      if (!material) {
+        spdlog::get("log")->warn("Skipping warm-up of unknown material {}", pending.key.material);
+        continue;
+      }
+
+      material->resolve();
+      if (!material->is_ready()) {
+        if (++pending.frames < MAX_PENDING_FRAMES) m_queue.push_back(pending);
+        else spdlog::get("log")->warn("Gave up warming up material {}, it never finished compiling", pending.key.material);
+        continue;
+      }
+
+      draw(*material, pending.key);
+      drawn++;
+    }
+
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous_fbo);
+    glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+
+    return m_queue.empty();
+  }
+
+  void PipelineWarmup::draw (const Material& material, const PipelineKey& key) {
+    material.get_program().use();
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, key.texture_format ? get_texture(key.texture_format) : 0);
+
+    // All vertices coincide, so nothing is rasterized
+    glBindVertexArray(key.layout == VertexLayout::POOL ? m_pool_vao : m_mesh_vao);
+    glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+  }
+
+  GLuint PipelineWarmup::get_texture (GLenum format) {
+    auto found_it = m_textures.find(format);
+    if (found_it != m_textures.end()) return found_it->second;
+
+    const unsigned char pixel[4] = {255, 255, 255, 255};
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    KVANT_GPU_TRACK(GpuCategory::TEXTURE, texture, GpuMemory::get_texture_size(format, 1, 1), "Pipeline warmup texture");
+
+    m_textures[format] = texture;
+    return texture;
+  }
+
+  void PipelineWarmup::setup () {
+    glGenTextures(1, &m_color);
+    glBindTexture(GL_TEXTURE_2D, m_color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    KVANT_GPU_TRACK(GpuCategory::TEXTURE, m_color, 4, "Pipeline warmup target");
+
+    GLint previous_fbo = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_fbo);
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_color, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous_fbo);
+    KVANT_GPU_TRACK(GpuCategory::FRAMEBUFFER, m_fbo, 0, "Pipeline warmup framebuffer");
+
+    std::vector<unsigned char> zeros(DUMMY_UNIFORMS_SIZE, 0);
+    glGenBuffers(1, &m_uniforms);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_uniforms);
+    glBufferData(GL_UNIFORM_BUFFER, DUMMY_UNIFORMS_SIZE, zeros.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    KVANT_GPU_TRACK(GpuCategory::BUFFER, m_uniforms, DUMMY_UNIFORMS_SIZE, "Pipeline warmup uniforms");
+
+    const Vertex vertices[3] = {};
+    const GLuint indices[3] = {0, 1, 2};
+    const ObjectConstants object = {};
+
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glGenBuffers(1, &m_draw_data);
+    glBindBuffer(GL_ARRAY_BUFFER, m_draw_data);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(object), &object, GL_STATIC_DRAW);
+    glGenBuffers(1, &m_ebo);
+    KVANT_GPU_TRACK(GpuCategory::BUFFER, m_vbo, sizeof(vertices), "Pipeline warmup vertices");
+    KVANT_GPU_TRACK(GpuCategory::BUFFER, m_draw_data, sizeof(object), "Pipeline warmup draw data");
+    KVANT_GPU_TRACK(GpuCategory::BUFFER, m_ebo, sizeof(indices), "Pipeline warmup indices");
+
+    // Same layouts as CMeshRenderer and GeometryPool
+    glGenVertexArrays(1, &m_mesh_vao);
+    glGenVertexArrays(1, &m_pool_vao);
+    KVANT_GPU_TRACK(GpuCategory::VERTEX_ARRAY, m_mesh_vao, 0, "Pipeline warmup mesh layout");
+    KVANT_GPU_TRACK(GpuCategory::VERTEX_ARRAY, m_pool_vao, 0, "Pipeline warmup pool layout");
+    for (GLuint vao : {m_mesh_vao, m_pool_vao}) {
+      glBindVertexArray(vao);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+      if (vao == m_mesh_vao)
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+      glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+      glEnableVertexAttribArray(0);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                       (GLvoid*)offsetof(Vertex, position.x));
+      glEnableVertexAttribArray(1);
+      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                       (GLvoid*)offsetof(Vertex, normal.x));
+      glEnableVertexAttribArray(2);
+      glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                       (GLvoid*)offsetof(Vertex, tex_coord.x));
+      if (vao == m_mesh_vao) continue;
+
+      glBindBuffer(GL_ARRAY_BUFFER, m_draw_data);
+      for (GLuint i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + i);
+        glVertexAttribPointer(INSTANCE_MODEL_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(ObjectConstants),
+                              (GLvoid*)(i * sizeof(glm::vec4)));
+        glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + i, 1);
+      }
+      glEnableVertexAttribArray(INSTANCE_LAYER_LOCATION);
+      glVertexAttribPointer(INSTANCE_LAYER_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(ObjectConstants),
+                            (GLvoid*)offsetof(ObjectConstants, texture_layer));
+      glVertexAttribDivisor(INSTANCE_LAYER_LOCATION, 1);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+}
@@ -0,0 +1,405 @@
+#include <KvantEngine/Core/RenderGraph.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <queue>
+
+// Third party
+#include <spdlog/spdlog.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+
+namespace Kvant {
+
+  namespace {
+    // Pooled targets unused for this many frames are deleted
+    constexpr unsigned int EVICT_AFTER_FRAMES = 60;
+
+    bool is_depth_stencil_format (GLenum format) {
+      return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    bool is_depth_format (GLenum format) {
+      return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 ||
+             format == GL_DEPTH_COMPONENT32F || is_depth_stencil_format(format);
+    }
+  }
+
+  constexpr RenderResource RenderGraph::BACKBUFFER;
+
+  RenderResource RenderGraph::PassBuilder::create (const std::string& name, const RenderTargetDesc& desc) {
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    m_graph.m_resources.push_back(resource);
+
+    RenderResource id = m_graph.m_resources.size() - 1;
+    m_graph.m_passes[m_pass].creates.push_back(id);
+    return write(id);
+  }
+
+  RenderResource RenderGraph::PassBuilder::read (RenderResource resource) {
+    if (!m_graph.valid(resource) || resource == BACKBUFFER) {
+      spdlog::get("log")->error("Render pass {} reads an invalid resource", m_graph.m_passes[m_pass].name);
+      return resource;
+    }
+
+    m_graph.m_passes[m_pass].reads.push_back(resource);
+    m_graph.m_resources[resource].readers.push_back(m_pass);
+    return resource;
+  }
+
+  RenderResource RenderGraph::PassBuilder::write (RenderResource resource) {
+    auto& pass = m_graph.m_passes[m_pass];
+    if (!m_graph.valid(resource)) {
+      spdlog::get("log")->error("Render pass {} writes an invalid resource", pass.name);
+      return resource;
+    }
+
+    // The default framebuffer can't be combined with texture attachments
+    bool backbuffer = std::find(pass.writes.begin(), pass.writes.end(), BACKBUFFER) != pass.writes.end();
+    if ((resource == BACKBUFFER && !pass.writes.empty()) || (resource != BACKBUFFER && backbuffer)) {
+      spdlog::get("log")->error("Render pass {} writes to the backbuffer and a render target", pass.name);
+      return resource;
+    }
+
+    pass.writes.push_back(resource);
+    m_graph.m_resources[resource].writers.push_back(m_pass);
+    return resource;
+  }
+
+  void RenderGraph::PassBuilder::set_side_effect () {
+    m_graph.m_passes[m_pass].side_effect = true;
+  }
+
+  GLuint RenderGraph::PassResources::get_texture (RenderResource resource) const {
+    if (!m_graph.valid(resource) || resource == BACKBUFFER) return 0;
+
+    int target = m_graph.m_resources[resource].target;
+    return target < 0 ? 0 : m_graph.m_pool[target].texture;
+  }
+
+  RenderGraph::RenderGraph () {
+    reset();
+  }
+
+  RenderGraph::~RenderGraph () {
+    auto& memory = GpuMemory::instance();
+    for (auto& framebuffer : m_framebuffers) {
+      memory.untrack(GpuCategory::FRAMEBUFFER, framebuffer.fbo);
+      glDeleteFramebuffers(1, &framebuffer.fbo);
+    }
+    for (auto& target : m_pool) {
+      memory.untrack(GpuCategory::TEXTURE, target.texture);
+      glDeleteTextures(1, &target.texture);
+    }
+  }
+
+  void RenderGraph::reset () {
+    m_passes.clear();
+    m_order.clear();
+    m_compiled = false;
+
+    m_resources.clear();
+    Resource backbuffer;
+    backbuffer.name = "Backbuffer";
+    m_resources.push_back(backbuffer);
+  }
+
+  void RenderGraph::add_pass (const std::string& name, SetupFunction setup, ExecuteFunction execute) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    m_passes.push_back(pass);
+    m_compiled = false;
+
+    PassBuilder builder(*this, m_passes.size() - 1);
+    if (setup) setup(builder);
+  }
+
+  bool RenderGraph::compile () {
+    cull();
+    if (!sort()) {
+      m_order.clear();
+      return false;
+    }
+    compute_lifetimes();
+    m_compiled = true;
+    return true;
+  }
+
+  void RenderGraph::cull () {
+    std::vector<std::size_t> stack;
+    for (auto i{0u}; i < m_passes.size(); i++) {
+      auto& pass = m_passes[i];
+      bool presents = std::find(pass.writes.begin(), pass.writes.end(), BACKBUFFER) != pass.writes.end();
+      pass.culled = !(presents || pass.side_effect);
+      if (!pass.culled) stack.push_back(i);
+    }
+
+    // Everything writing a resource a live pass reads is live as well. Writing
+    // a target created elsewhere keeps its contents, so that counts as a read.
+    while (!stack.empty()) {
+      auto& pass = m_passes[stack.back()];
+      stack.pop_back();
+
+      auto keep_writers = [&] (RenderResource resource) {
+        for (auto writer : m_resources[resource].writers) {
+          if (!m_passes[writer].culled) continue;
+          m_passes[writer].culled = false;
+          stack.push_back(writer);
+        }
+      };
+      for (auto resource : pass.reads) keep_writers(resource);
+      for (auto resource : pass.writes) {
+        if (resource != BACKBUFFER) keep_writers(resource);
+      }
+    }
+  }
+
+  bool RenderGraph::sort () {
+    std::vector<std::vector<std::size_t>> edges(m_passes.size());
+    std::vector<std::size_t> incoming(m_passes.size(), 0);
+
+    auto add_edge = [&] (std::size_t from, std::size_t to) {
+      if (from == to || m_passes[from].culled || m_passes[to].culled) return;
+      edges[from].push_back(to);
+      incoming[to]++;
+    };
+
+    for (auto& resource : m_resources) {
+      // Writes to the same resource keep declaration order, reads wait for all of them
+      for (auto i{1u}; i < resource.writers.size(); i++)
+        add_edge(resource.writers[i - 1], resource.writers[i]);
+      for (auto reader : resource.readers)
+        for (auto writer : resource.writers)
+          add_edge(writer, reader);
+    }
+
+    // Kahn's algorithm, ties broken by declaration order so the result is stable
+    std::priority_queue<std::size_t, std::vector<std::size_t>, std::greater<std::size_t>> ready;
+    std::size_t live = 0;
+    for (auto i{0u}; i < m_passes.size(); i++) {
+      if (m_passes[i].culled) continue;
+      live++;
+      if (incoming[i] == 0) ready.push(i);
+    }
+
+    m_order.clear();
+    while (!ready.empty()) {
+      auto pass = ready.top();
+      ready.pop();
+      m_order.push_back(pass);
+
+      for (auto next : edges[pass]) {
+        if (--incoming[next] == 0) ready.push(next);
+      }
+    }
+
+    if (m_order.size() != live) {
+      spdlog::get("log")->error("Render graph has a dependency cycle, skipping frame");
+      return false;
+    }
+    return true;
+  }
+
+  void RenderGraph::compute_lifetimes () {
+    for (auto i{0u}; i < m_order.size(); i++) {
+      auto& pass = m_passes[m_order[i]];
+
+      auto touch = [&] (RenderResource id) {
+        auto& resource = m_resources[id];
+        if (resource.first_use < 0) resource.first_use = i;
+        resource.last_use = i;
+      };
+      for (auto id : pass.writes) touch(id);
+      for (auto id : pass.reads) touch(id);
+    }
+  }
+
+  void RenderGraph::execute () {
+    if (!m_compiled && !compile()) return;
+    m_frame++;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    for (auto i{0u}; i < m_order.size(); i++) {
+      auto& pass = m_passes[m_order[i]];
+
+      for (auto id : pass.creates) {
+        auto& resource = m_resources[id];
+        RenderTargetDesc desc = resource.desc;
+        if (desc.width == 0) desc.width = viewport[2];
+        if (desc.height == 0) desc.height = viewport[3];
+        resource.target = acquire_target(desc);
+      }
+
+      GLsizei width = viewport[2], height = viewport[3];
+      std::vector<GLuint> attachments;
+      for (auto id : pass.writes) {
+        if (id == BACKBUFFER) continue;
+        auto& target = m_pool[m_resources[id].target];
+        attachments.push_back(target.texture);
+        width = target.desc.width;
+        height = target.desc.height;
+      }
+
+      if (attachments.empty()) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+      }
+      else {
+        glBindFramebuffer(GL_FRAMEBUFFER, get_framebuffer(attachments));
+        glViewport(0, 0, width, height);
+      }
+
+      // Pooled targets hold whatever their previous user left behind
+      GLint color_attachment = 0;
+      for (auto id : pass.writes) {
+        if (id == BACKBUFFER) continue;
+        bool created = std::find(pass.creates.begin(), pass.creates.end(), id) != pass.creates.end();
+        GLenum format = m_pool[m_resources[id].target].desc.internal_format;
+
+        if (is_depth_format(format)) {
+          const GLfloat clear_depth = 1.f;
+          if (created && is_depth_stencil_format(format)) glClearBufferfi(GL_DEPTH_STENCIL, 0, clear_depth, 0);
+          else if (created) glClearBufferfv(GL_DEPTH, 0, &clear_depth);
+          continue;
+        }
+        if (created) {
+          const GLfloat clear_color[] = {0.f, 0.f, 0.f, 0.f};
+          glClearBufferfv(GL_COLOR, color_attachment, clear_color);
+        }
+        color_attachment++;
+      }
+
+      if (pass.execute) pass.execute(PassResources(*this, width, height));
+
+      for (auto& resource : m_resources) {
+        if (resource.target >= 0 && resource.last_use == (int)i) {
+          release_target(resource.target);
+          resource.target = -1;
+        }
+      }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    evict_unused();
+  }
+
+  int RenderGraph::acquire_target (const RenderTargetDesc& desc) {
+    for (auto i{0u}; i < m_pool.size(); i++) {
+      auto& target = m_pool[i];
+      if (target.in_use || !(target.desc == desc)) continue;
+
+      target.in_use = true;
+      target.last_frame = m_frame;
+      return i;
+    }
+
+    PooledTarget target;
+    target.desc = desc;
+    target.in_use = true;
+    target.last_frame = m_frame;
+
+    GLenum format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+    if (is_depth_stencil_format(desc.internal_format)) {
+      format = GL_DEPTH_STENCIL;
+      type = GL_UNSIGNED_INT_24_8;
+    }
+    else if (is_depth_format(desc.internal_format)) {
+      format = GL_DEPTH_COMPONENT;
+      type = GL_FLOAT;
+    }
+
+    glGenTextures(1, &target.texture);
+    glBindTexture(GL_TEXTURE_2D, target.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, desc.internal_format, desc.width, desc.height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    KVANT_GPU_TRACK(GpuCategory::TEXTURE, target.texture,
+                    GpuMemory::get_texture_size(desc.internal_format, desc.width, desc.height), "Render graph target");
+
+    m_pool.push_back(target);
+    return m_pool.size() - 1;
+  }
+
+  void RenderGraph::release_target (int target) {
+    m_pool[target].in_use = false;
+  }
+
+  GLuint RenderGraph::get_framebuffer (const std::vector<GLuint>& attachments) {
+    for (auto& framebuffer : m_framebuffers) {
+      if (framebuffer.attachments != attachments) continue;
+      framebuffer.last_frame = m_frame;
+      return framebuffer.fbo;
+    }
+
+    Framebuffer framebuffer;
+    framebuffer.attachments = attachments;
+    framebuffer.last_frame = m_frame;
+
+    glGenFramebuffers(1, &framebuffer.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+    KVANT_GPU_TRACK(GpuCategory::FRAMEBUFFER, framebuffer.fbo, 0, "Render graph framebuffer");
+
+    std::vector<GLenum> draw_buffers;
+    for (auto texture : attachments) {
+      auto target = std::find_if(m_pool.begin(), m_pool.end(), [texture] (const PooledTarget& t) {
+        return t.texture == texture;
+      });
+      GLenum format = target->desc.internal_format;
+
+      GLenum attachment = GL_COLOR_ATTACHMENT0 + draw_buffers.size();
+      if (is_depth_stencil_format(format)) attachment = GL_DEPTH_STENCIL_ATTACHMENT;
+      else if (is_depth_format(format)) attachment = GL_DEPTH_ATTACHMENT;
+      else draw_buffers.push_back(attachment);
+
+      glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+    }
+
+    if (draw_buffers.empty()) glDrawBuffer(GL_NONE);
+    else glDrawBuffers(draw_buffers.size(), draw_buffers.data());
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      spdlog::get("log")->error("Render graph framebuffer with {} attachments is incomplete", attachments.size());
+
+    m_framebuffers.push_back(framebuffer);
+    return framebuffer.fbo;
+  }
+
+  void RenderGraph::evict_unused () {
+    auto stale = [this] (unsigned int last_frame) { return m_frame - last_frame > EVICT_AFTER_FRAMES; };
+
+    std::vector<GLuint> deleted;
+    for (auto& target : m_pool) {
+      if (target.in_use || !stale(target.last_frame)) continue;
+      GpuMemory::instance().untrack(GpuCategory::TEXTURE, target.texture);
+      glDeleteTextures(1, &target.texture);
+      deleted.push_back(target.texture);
+    }
+
+    m_pool.erase(std::remove_if(m_pool.begin(), m_pool.end(), [&] (const PooledTarget& target) {
+      return std::find(deleted.begin(), deleted.end(), target.texture) != deleted.end();
+    }), m_pool.end());
+
+    // Framebuffers referencing a deleted texture go with it
+    m_framebuffers.erase(std::remove_if(m_framebuffers.begin(), m_framebuffers.end(), [&] (Framebuffer& framebuffer) {
+      bool dangling = std::any_of(framebuffer.attachments.begin(), framebuffer.attachments.end(), [&] (GLuint texture) {
+        return std::find(deleted.begin(), deleted.end(), texture) != deleted.end();
+      });
+      if (!dangling && !stale(framebuffer.last_frame)) return false;
+
+      GpuMemory::instance().untrack(GpuCategory::FRAMEBUFFER, framebuffer.fbo);
+      glDeleteFramebuffers(1, &framebuffer.fbo);
+      return true;
+    }), m_framebuffers.end());
+  }
+}
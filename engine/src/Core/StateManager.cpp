@@ -1,21 +1,27 @@
 #include <KvantEngine/Core/StateManager.hpp>
 
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+
 namespace Kvant {
 
   void StateManager::cleanup () {
     // Cleanup all states
-    while (!m_states.empty()) {
-      m_states.back()->cleanup();
-      m_states.pop_back();
-    }
+    while (!m_states.empty()) destroy_state();
+  }
+
+  void StateManager::destroy_state () {
+    auto state = m_states.back().get();
+    state->cleanup();
+    m_states.pop_back();
+
+    // Whatever is still tracked under it was never deleted
+    GpuMemory::instance().release_state(state);
   }
 
   void StateManager::pop_state() {
     // Cleaup current state
-    if (!m_states.empty()) {
-      m_states.back()->cleanup();
-      m_states.pop_back();
-    }
+    if (!m_states.empty()) destroy_state();
 
     // Resume previous state
     if (!m_states.empty()) {
@@ -0,0 +1,98 @@
+#include <KvantEngine/Core/TextureStreamer.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Kvant {
+
+  constexpr GLsizei TextureStreamer::MIN_RESIDENT_SIZE;
+  constexpr unsigned int TextureStreamer::EVICT_FRAMES;
+
+  void TextureStreamer::request (const Texture& texture, float screen_size) {
+    // Nothing to stream before the first upload
+    if (!texture.is_loaded()) return;
+    auto found_it = m_entries.find(&texture);
+    if (found_it == m_entries.end()) return;
+
+    // One texel per pixel, each level halves the texels
+    float texels = std::max(texture.m_width, texture.m_height);
+    GLsizei level = screen_size >= 1.0f ? std::max(0, (int)std::floor(std::log2(texels / screen_size))) : texture.m_mip_levels - 1;
+
+    auto& entry = found_it->second;
+    if (entry.last_used != m_frame) {
+      entry.wanted = level;
+      entry.last_used = m_frame;
+    }
+    else {
+      entry.wanted = std::min(entry.wanted, level);
+    }
+  }
+
+  void TextureStreamer::track (const std::shared_ptr<Texture>& texture) {
+    // Never drawn, so it is evicted first
+    auto& entry = m_entries[texture.get()];
+    if (entry.texture.expired()) entry.texture = texture;
+  }
+
+  GLsizei TextureStreamer::get_min_level (const Texture& texture) const {
+    GLsizei level = 0;
+    for (GLsizei size = std::max(texture.m_width, texture.m_height); size > MIN_RESIDENT_SIZE; size /= 2) level++;
+    return std::min(level, texture.m_mip_levels - 1);
+  }
+
+  void TextureStreamer::update () {
+    struct Target {
+      std::shared_ptr<Texture> texture;
+      GLsizei level, min_level;
+      unsigned int last_used;
+    };
+
+    std::vector<Target> targets;
+    std::size_t total = 0;
+    for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+      auto texture = it->second.texture.lock();
+      if (!texture) {
+        it = m_entries.erase(it);
+        continue;
+      }
+      auto& entry = (it++)->second;
+      if (!texture->is_loaded()) continue;
+
+      // Levels only grow while drawn, so textures don't flicker between two of them
+      GLsizei min_level = get_min_level(*texture);
+      GLsizei level = std::min({texture->get_target_level(), entry.wanted, min_level});
+      // Never drawn textures start at the smallest resident level, not at wanted
+      if (!entry.last_used || m_frame - entry.last_used > EVICT_FRAMES) level = min_level;
+
+      total += texture->get_level_bytes(level);
+      targets.push_back(Target{texture, level, min_level, entry.last_used});
+    }
+
+    // Over budget, the least recently drawn give up their largest levels first
+    if (m_budget && total > m_budget) {
+      std::sort(targets.begin(), targets.end(), [] (const Target& a, const Target& b) {
+        return a.last_used < b.last_used;
+      });
+      for (auto& target : targets) {
+        while (total > m_budget && target.level < target.min_level) {
+          total -= target.texture->get_level_bytes(target.level) - target.texture->get_level_bytes(target.level + 1);
+          target.level++;
+        }
+        if (total <= m_budget) break;
+      }
+    }
+
+    m_resident_bytes = 0;
+    for (auto& target : targets) {
+      auto& texture = *target.texture;
+      texture.set_resident_level(target.level);
+      // ResourceManager only polls reloads, residency changes finish here
+      if (texture.is_streaming()) texture.finish_reload();
+      m_resident_bytes += texture.get_level_bytes(texture.get_resident_level());
+    }
+
+    m_frame++;
+  }
+}
@@ -1,20 +1,47 @@
 #include <KvantEngine/CoreComponents/CMeshRenderer.hpp>
 
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+
 namespace Kvant {
 CMeshRenderer::CMeshRenderer(const vector<Vertex> &_vertices,
                              const vector<GLuint> &_indices,
-                             const vector<string> &_textures) {
+                             const vector<string> &_textures,
+                             bool _is_static) {
   m_vertices = _vertices;
   m_indices = _indices;
   m_textures = _textures;
+  m_is_static = _is_static;
   setup_mesh();
   }
 
+  CMeshRenderer::CMeshRenderer (const CMeshRenderer& other)
+      : m_vertices(other.m_vertices), m_indices(other.m_indices), m_textures(other.m_textures),
+        m_texture_ids(other.m_texture_ids), m_texture_count(other.m_texture_count), m_is_static(other.m_is_static), m_pool_allocation(other.m_pool_allocation) {
+    // Pool geometry is never freed and can be shared, the buffers can't
+    setup_mesh();
+  }
+
   CMeshRenderer::~CMeshRenderer () {
+    auto& memory = GpuMemory::instance();
+    memory.untrack(GpuCategory::VERTEX_ARRAY, m_vao);
+    memory.untrack(GpuCategory::BUFFER, m_vbo);
+    memory.untrack(GpuCategory::BUFFER, m_ebo);
 
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ebo);
   }
 
   void CMeshRenderer::setup_mesh () {
+    if (!m_vertices.empty()) {
+      m_local_bounds = AABB(m_vertices[0].position, m_vertices[0].position);
+      for (auto& v : m_vertices) {
+        m_local_bounds.lower = glm::min(m_local_bounds.lower, v.position);
+        m_local_bounds.upper = glm::max(m_local_bounds.upper, v.position);
+      }
+    }
+
     glGenVertexArrays(1, &m_vao);
     glGenBuffers(1, &m_vbo);
     glGenBuffers(1, &m_ebo);
@@ -43,5 +70,9 @@ CMeshRenderer::CMeshRenderer(const vector<Vertex> &_vertices,
                      (GLvoid*)offsetof(Vertex, tex_coord.x));
 
     glBindVertexArray(0);
+
+    KVANT_GPU_TRACK(GpuCategory::VERTEX_ARRAY, m_vao, 0, "Mesh renderer");
+    KVANT_GPU_TRACK(GpuCategory::BUFFER, m_vbo, m_vertices.size() * sizeof(Vertex), "Mesh renderer vertices");
+    KVANT_GPU_TRACK(GpuCategory::BUFFER, m_ebo, m_indices.size() * sizeof(GLuint), "Mesh renderer indices");
   }
 }
@@ -1,5 +1,6 @@
 #include <KvantEngine/CoreSystems/NodeSystem.hpp>
 #include <KvantEngine/CoreComponents/CMaterial.hpp>
+#include <KvantEngine/CoreComponents/CMeshRenderer.hpp>
 #include <KvantEngine/States/State.hpp>
 #include <KvantEngine/Core/Engine.hpp>
 
@@ -29,7 +30,11 @@ namespace Kvant {
         assess_node_removals (e);
         assess_node_additions (e);
 
-        update_world_transform (e);
+        bool changed = update_world_transform (e);
+        update_spatial_proxy (e, changed);
+      }
+      else {
+        destroy_spatial_proxy (e);
       }
     }
   }
@@ -44,6 +49,7 @@ namespace Kvant {
 
       node->remove_children();
       assess_node_removals (entity);
+      destroy_spatial_proxy (entity);
     }
   }
 
@@ -57,6 +63,7 @@ namespace Kvant {
 
       node->remove_children();
       assess_node_removals (entity);
+      destroy_spatial_proxy (entity);
     }
   }
 
@@ -108,14 +115,65 @@ namespace Kvant {
     node->m_add_children.clear();
   }
 
-  void NodeSystem::update_world_transform (entityx::Entity entity) {
+  bool NodeSystem::update_world_transform (entityx::Entity entity) {
     auto world_transform = glm::mat4();
 
     for (entityx::Entity node = entity; node.valid(); node = node.component<CNode>()->m_parent) {
       world_transform = node.component<CNode>()->get_transform() * world_transform;
     }
 
-    entity.component<CNode>()->m_world_transform = world_transform;
+    auto node = entity.component<CNode>();
+    if (node->m_world_transform == world_transform) return false;
+
+    node->m_world_transform = world_transform;
+    return true;
+  }
+
+  void NodeSystem::update_spatial_proxy (entityx::Entity entity, bool transform_changed) {
+    auto node = entity.component<CNode>();
+    auto mesh_renderer = entity.component<CMeshRenderer>();
+
+    if (!mesh_renderer) {
+      destroy_spatial_proxy (entity);
+      return;
+    }
+
+    // Proxy is still valid if the node didn't move
+    if (node->m_proxy_id != NULL_PROXY && !transform_changed) return;
+
+    AABB bounds = mesh_renderer->get_local_bounds().transformed(node->m_world_transform);
+    if (node->m_proxy_id == NULL_PROXY) {
+      node->m_proxy_id = m_spatial_index.create_proxy(bounds, entity);
+    }
+    else {
+      glm::vec3 displacement = bounds.get_center() - node->m_world_bounds.get_center();
+      m_spatial_index.move_proxy(node->m_proxy_id, bounds, displacement);
+    }
+    node->m_world_bounds = bounds;
+  }
+
+  void NodeSystem::destroy_spatial_proxy (entityx::Entity entity) {
+    auto node = entity.component<CNode>();
+    if (!node || node->m_proxy_id == NULL_PROXY) return;
+
+    m_spatial_index.destroy_proxy(node->m_proxy_id);
+    node->m_proxy_id = NULL_PROXY;
+  }
+
+  entityx::Entity NodeSystem::pick (const Ray& ray, float max_distance) const {
+    entityx::Entity closest;
+
+    m_spatial_index.ray_cast(ray, max_distance, [&] (ProxyId proxy, const Ray& r, float max_t) {
+      // The tree stores fat boxes, test against the tight world bounds
+      auto entity = m_spatial_index.get_entity(proxy);
+      float t;
+      if (!r.intersects(entity.component<CNode>()->get_world_bounds(), max_t, t)) return -1.f;
+
+      closest = entity;
+      return t;
+    });
+
+    return closest;
   }
 
   void NodeSystem::draw_imgui_tree (entityx::EntityManager &entities) {
@@ -135,6 +193,10 @@ namespace Kvant {
       ImGui::TreePop();
     }
 
+    ImGui::Separator();
+    ImGui::Text("Spatial index: %d proxies, height %d",
+                m_spatial_index.get_proxy_count(), m_spatial_index.get_height());
+
     ImGui::End();
   }
 
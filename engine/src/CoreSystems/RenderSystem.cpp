@@ -1,13 +1,49 @@
 #include <KvantEngine/CoreSystems/RenderSystem.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// Third-party
+#include <spdlog/spdlog.h>
+
 #include <KvantEngine/CoreComponents/CNode.hpp>
 #include <KvantEngine/CoreComponents/CCamera.hpp>
 #include <KvantEngine/CoreComponents/CMaterial.hpp>
 #include <KvantEngine/CoreComponents/CMeshRenderer.hpp>
+#include <KvantEngine/CoreSystems/NodeSystem.hpp>
+#include <KvantEngine/CoreTypes/UniformHandle.hpp>
 
 namespace Kvant {
 
+  namespace {
+    // Programs sample their first texture unit through it
+    const UniformHandle<GLint> SAMPLER_UNIT{"sampler"};
+
+    // Material textures win, the mesh renderer's fill the units it leaves empty
+    TextureId get_unit_texture (const CMaterial* material, const CMeshRenderer& mesh_renderer, std::size_t unit) {
+      if (material && material->has_texture(unit)) return material->get_texture_id(unit);
+      return mesh_renderer.get_texture_id(unit);
+    }
+  }
+
   RenderSystem::RenderSystem (Engine* engine) : m_engine(engine) {
     m_time_start = std::chrono::high_resolution_clock::now();
+
+    m_frame_constants_size = m_uniform_ring.align(sizeof(FrameConstants));
+    m_object_stride = m_uniform_ring.align(sizeof(ObjectConstants));
+
+    bool multi_draw = GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+    bool base_instance = GLEW_VERSION_4_2 || GLEW_ARB_base_instance;
+    if (multi_draw && base_instance) {
+      m_geometry_pool.reset(new GeometryPool());
+      m_indirect_enabled = true;
+      spdlog::get("log")->info("Static meshes are drawn with multi draw indirect");
+    }
+    else {
+      spdlog::get("log")->info("Multi draw indirect unavailable, drawing every mesh separately");
+    }
   }
   RenderSystem::~RenderSystem () {
 
@@ -23,68 +59,332 @@ namespace Kvant {
       m_camera = camera;
   }
 
+  void RenderSystem::begin_frame () {
+    m_uniform_ring.next_frame();
+  }
+
   void RenderSystem::update (ex::EntityManager&, ex::EventManager&, ex::TimeDelta) {
     if (!m_render_root.valid() || !m_camera.valid()) return;
     if (!m_render_root.component<CNode>()) return;
 
-    render_entity(m_render_root);
+    auto camera = m_camera.component<CCamera>();
+    m_view_projection = camera->get_projection_transform() * camera->get_camera_transform();
+    cull(m_view_projection);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    m_viewport_size = glm::vec2(viewport[2], viewport[3]);
+
+    auto* state = m_engine->get_state_manager().peek_state();
+    m_pipeline_warmup = state && state->get_pipeline_warmup().is_recording() ? &state->get_pipeline_warmup() : nullptr;
+    m_state = state;
+
+    m_draw_list.clear();
+    collect_entity(m_render_root);
+    m_pipeline_warmup = nullptr;
+
+    record_commands();
+    submit_commands();
+    m_state = nullptr;
   }
 
-  void RenderSystem::render_entity (ex::Entity entity) {
+  void RenderSystem::cull (const glm::mat4& view_projection) {
+    ++m_cull_frame;
+
+    auto* state = m_engine->get_state_manager().peek_state();
+    if (!state) return;
+    auto node_system = state->get_system_manager().system<NodeSystem>();
+    if (!node_system) return;
+
+    auto frustum = Frustum::from_matrix(view_projection);
+    node_system->get_spatial_index().query(frustum, [this] (ProxyId proxy) {
+      if (proxy >= (int)m_proxy_frames.size())
+        m_proxy_frames.resize(proxy + 1, 0);
+      m_proxy_frames[proxy] = m_cull_frame;
+      return true;
+    });
+  }
+
+  bool RenderSystem::is_culled (ProxyId proxy) const {
+    if (proxy == NULL_PROXY) return false;
+    if (proxy >= (int)m_proxy_frames.size()) return true;
+    return m_proxy_frames[proxy] != m_cull_frame;
+  }
+
+  void RenderSystem::collect_entity (ex::Entity entity) {
     auto node = entity.component<CNode>();
-    auto camera = m_camera.component<CCamera>();
-    if (!node || !camera) return;
+    if (!node) return;
 
-    // Render children
+    // Children are drawn before their parent
     for (ex::Entity child : node->get_children()) {
       if (child.valid() && child.component<CNode>()) {
-        render_entity (child);
+        collect_entity (child);
       }
     }
 
     if (!node->is_active()) return;
     if (!node->is_visible()) return;
+    if (is_culled(node->get_proxy_id())) return;
 
-    // Use current m_material
-    auto mesh_renderer = entity.component<CMeshRenderer> ();
-    auto material = entity.component<CMaterial> ();
+    auto mesh_renderer = entity.component<CMeshRenderer>();
+    if (!mesh_renderer) return;
 
-    // use entity material
+    // Variants compile lazily and parameters upload, which has to happen here rather than on a worker
+    auto material = entity.component<CMaterial>();
     if (material) {
-      // Activate Shader
-      material->getProgram().use();
+      material->resolve();
+      if (m_pipeline_warmup && material->is_ready()) record_pipeline(*material, *mesh_renderer);
+    }
+    if (m_state) {
+      // Names are looked up once, drawing only indexes the state's texture table
+      auto resolve = [this] (const ResourceHandle& image) { return m_state->get_texture_id(image); };
+      auto texture_count = m_state->get_texture_count();
+      if (material) material->resolve_textures(resolve, texture_count);
+      mesh_renderer->resolve_textures(resolve, texture_count);
+      request_textures(*node, material.get(), *mesh_renderer);
+    }
+
+    // Pool uploads need the GL thread, so they can't wait for record_command
+    if (m_indirect_enabled && mesh_renderer->m_is_static && !mesh_renderer->m_pool_allocation.valid())
+      mesh_renderer->m_pool_allocation = m_geometry_pool->add(mesh_renderer->m_vertices, mesh_renderer->m_indices);
+
+    m_draw_list.push_back(entity);
+  }
+
+  void RenderSystem::request_textures (CNode& node, const CMaterial* material, CMeshRenderer& mesh_renderer) {
+    // Pixels the mesh bounds cover on their larger side, corners behind the camera only make it larger
+    auto& bounds = mesh_renderer.get_local_bounds();
+    glm::mat4 transform = m_view_projection * node.get_world_transform();
+    glm::vec2 lower(std::numeric_limits<float>::max()), upper(-std::numeric_limits<float>::max());
+    for (int i = 0; i < 8; i++) {
+      glm::vec4 corner(i & 1 ? bounds.upper.x : bounds.lower.x, i & 2 ? bounds.upper.y : bounds.lower.y,
+                       i & 4 ? bounds.upper.z : bounds.lower.z, 1.0f);
+      glm::vec4 clip = transform * corner;
+      glm::vec2 ndc = glm::vec2(clip.x, clip.y) / std::max(clip.w, 1e-4f);
+      lower = glm::min(lower, ndc);
+      upper = glm::max(upper, ndc);
+    }
+    glm::vec2 size = (upper - lower) * 0.5f * m_viewport_size;
+    float screen_size = std::max(size.x, size.y);
+
+    auto& streamer = m_state->get_texture_streamer();
+    for (auto i{0u}; i < MAX_TEXTURE_UNITS; i++) {
+      // Atlas pages and texture arrays aren't streamed
+      TextureBinding binding;
+      if (m_state->find_texture(get_unit_texture(material, mesh_renderer, i), binding) && binding.texture)
+        streamer.request(*binding.texture, screen_size);
+    }
+  }
+
+  void RenderSystem::record_pipeline (const CMaterial& material, const CMeshRenderer& mesh_renderer) {
+    // Mirrors the choices record_command makes
+    bool pooled = m_indirect_enabled && mesh_renderer.m_is_static && material.getProgram().supports_indirect();
+
+    TextureBinding binding;
+    // The placeholder says nothing about the format the texture will have
+    if (m_state && m_state->find_texture(get_unit_texture(&material, mesh_renderer, 0), binding) && !binding.internal_format) return;
+    m_pipeline_warmup->record(material.get_material_id(), *material.get_material(),
+                              pooled ? VertexLayout::POOL : VertexLayout::MESH, binding.internal_format);
+  }
+
+  void RenderSystem::record_commands () {
+    auto& pool = m_engine->get_thread_pool();
+
+    m_buckets.resize(pool.get_worker_count());
+    for (auto& bucket : m_buckets) bucket.clear();
+
+    // Workers write object constants straight into their slot of the staging buffer
+    m_uniform_staging.resize(m_frame_constants_size + m_draw_list.size() * m_object_stride);
 
-      // Set projection matrix
-      material->getProgram().set_uniform("projection", camera->get_projection_transform(), GL_FALSE);
+    pool.parallel_for(m_draw_list.size(), 64, [&] (std::size_t begin, std::size_t end, std::size_t worker) {
+      for (auto i = begin; i < end; i++) {
+        record_command(m_draw_list[i], i, m_buckets[worker]);
+      }
+    });
+
+    // Merge buckets, ties fall back to the sequence, which object_offset grows with, so the order is deterministic
+    m_commands.clear();
+    for (auto& bucket : m_buckets) {
+      m_commands.insert(m_commands.end(), bucket.begin(), bucket.end());
+    }
+    std::sort(m_commands.begin(), m_commands.end(), [] (const RenderCommand& a, const RenderCommand& b) {
+      return a.sort_key != b.sort_key ? a.sort_key < b.sort_key : a.object_offset < b.object_offset;
+    });
+  }
 
-      // set the "camera" uniform in the vertex shader, because it's also not going to change
-      material->getProgram().set_uniform("camera", camera->get_camera_transform(), GL_FALSE);
+  std::uint32_t RenderSystem::get_depth_key (const glm::mat4& model) const {
+    glm::vec4 clip = m_view_projection * model[3];
+    float depth = clip.z / std::max(clip.w, 1e-4f);
 
-      // Set model matrix
-      material->getProgram().set_uniform("model", node->get_world_transform());
+    // Float bits flipped to order like the floats, then inverted so the farthest draws first
+    std::uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    bits = bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+    return ~bits;
+  }
 
-      using namespace std;
-      float time_seconds = chrono::duration_cast<chrono::duration<float, milli>>( chrono::high_resolution_clock::now() - m_time_start ).count()/1000.;
-      material->getProgram().set_uniform("time", time_seconds);
+  void RenderSystem::record_command (ex::Entity entity, std::uint32_t sequence, std::vector<RenderCommand>& bucket) {
+    auto node = entity.component<CNode>();
+    auto mesh_renderer = entity.component<CMeshRenderer>();
+    auto material = entity.component<CMaterial>();
+
+    RenderCommand command;
+    command.program = material ? &material->getProgram() : nullptr;
+    command.material_params = material ? material->get_params_buffer() : 0;
+    command.vao = mesh_renderer->m_vao;
+    command.index_count = mesh_renderer->m_indices.size();
+
+    ObjectConstants object;
+    object.model = node->get_world_transform();
+
+    auto& allocation = mesh_renderer->m_pool_allocation;
+    if (m_indirect_enabled && allocation.valid() && command.program && command.program->supports_indirect()) {
+      command.indirect = true;
+      command.vao = m_geometry_pool->get_vao();
+      command.first_index = allocation.first_index;
+      command.base_vertex = allocation.base_vertex;
     }
 
-    // Draw Entity
-    if (mesh_renderer) {
-      // bind textures
-      for (auto i{0u}; i < mesh_renderer->m_textures.size(); i++) {
-        auto* state = m_engine->get_state_manager().peek_state();
-        if (!state) break;
+    if (m_state) {
+      auto& sampler_cache = SamplerCache::instance();
+      bool layer_set = false;
+      for (auto i{0u}; i < MAX_TEXTURE_UNITS; i++) {
+        // Atlased images resolve to their page and arrayed ones to their array, so sprites sharing one batch together
+        TextureBinding binding;
+        if (!m_state->find_texture(get_unit_texture(material.get(), *mesh_renderer, i), binding)) continue;
+        command.textures[i] = binding.id;
+        command.texture_targets[i] = binding.target;
+        command.samplers[i] = sampler_cache.get_sampler(material ? material->get_sampler(i) : SamplerCache::DEFAULT);
 
-        auto *texture_manager = state->get_texture_resources();
-        auto texture = texture_manager->get(mesh_renderer->m_textures[i]);
-        if(texture) texture->bind(i);
+        // One layer per draw, the first texture array's
+        if (binding.target == GL_TEXTURE_2D_ARRAY && !layer_set) {
+          object.texture_layer = binding.layer;
+          layer_set = true;
+        }
       }
+    }
+
+    command.object_offset = m_frame_constants_size + sequence * m_object_stride;
+    std::memcpy(&m_uniform_staging[command.object_offset], &object, sizeof(object));
+
+    // Materials are ordered by program first, so templates sharing one only switch parameters
+    std::uint64_t program_id = command.program ? command.program->get_program_id() & 0xFFFF : 0;
+    std::uint64_t material_id = material ? material->get_material_id() & 0xFFFF : command.textures[0] & 0xFFFF;
+    if (m_sort_mode == SortMode::PAINTER)
+      command.sort_key = (std::uint64_t)get_depth_key(object.model) << 32 | program_id << 16 | material_id;
+    else
+      command.sort_key = program_id << 48 | material_id << 32 | sequence;
+
+    bucket.push_back(command);
+  }
+
+  void RenderSystem::submit_commands () {
+    auto camera = m_camera.component<CCamera>();
+
+    FrameConstants frame;
+    frame.projection = camera->get_projection_transform();
+    frame.camera = camera->get_camera_transform();
+
+    using namespace std;
+    frame.time = chrono::duration_cast<chrono::duration<float, milli>>( chrono::high_resolution_clock::now() - m_time_start ).count()/1000.;
+    std::memcpy(m_uniform_staging.data(), &frame, sizeof(frame));
+
+    // Single upload for the whole batch, bound per draw with glBindBufferRange
+    GLintptr base = m_uniform_ring.upload(m_uniform_staging.data(), m_uniform_staging.size());
+    m_uniform_ring.bind_range(FRAME_CONSTANTS_BINDING, base, sizeof(FrameConstants));
+
+    // Indirect commands in submission order, the base instance picks the model matrix
+    m_indirect_commands.clear();
+    m_indirect_objects.clear();
+    for (auto& command : m_commands) {
+      if (!command.indirect) continue;
+
+      DrawElementsIndirectCommand draw;
+      draw.count = command.index_count;
+      draw.instance_count = 1;
+      draw.first_index = command.first_index;
+      draw.base_vertex = command.base_vertex;
+      draw.base_instance = m_indirect_commands.size();
+      m_indirect_commands.push_back(draw);
+
+      ObjectConstants object;
+      std::memcpy(&object, &m_uniform_staging[command.object_offset], sizeof(object));
+      m_indirect_objects.push_back(object);
+    }
+    if (m_geometry_pool) m_geometry_pool->upload_draws(m_indirect_commands, m_indirect_objects);
+
+    const Program* current_program = nullptr;
+    GLuint current_vao = 0;
+    GLuint current_params = 0;
+    std::array<GLuint, MAX_TEXTURE_UNITS> bound_textures{}, bound_samplers{};
+    std::size_t indirect_index = 0;
+
+    for (std::size_t i = 0; i < m_commands.size(); ) {
+      auto& command = m_commands[i];
+
+      if (command.program && command.program != current_program) {
+        current_program = command.program;
+        current_program->use();
+        SAMPLER_UNIT.set(*current_program, 0);
+      }
+
+      if (command.material_params && command.material_params != current_params) {
+        glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_PARAMS_BINDING, command.material_params);
+        current_params = command.material_params;
+      }
+
+      for (auto unit{0u}; unit < MAX_TEXTURE_UNITS; unit++) {
+        if (command.textures[unit] == 0 || command.textures[unit] == bound_textures[unit]) continue;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(command.texture_targets[unit], command.textures[unit]);
+        bound_textures[unit] = command.textures[unit];
+      }
+      for (auto unit{0u}; unit < MAX_TEXTURE_UNITS; unit++) {
+        if (command.samplers[unit] == 0 || command.samplers[unit] == bound_samplers[unit]) continue;
+        glBindSampler(unit, command.samplers[unit]);
+        bound_samplers[unit] = command.samplers[unit];
+      }
+
+      if (command.vao != current_vao) {
+        glBindVertexArray(command.vao);
+        current_vao = command.vao;
+      }
+
+      if (command.indirect) {
+        // Extend the run while nothing but the mesh and model matrix changes
+        std::size_t end = i + 1;
+        while (end < m_commands.size() && m_commands[end].indirect &&
+               m_commands[end].program == command.program &&
+               m_commands[end].material_params == command.material_params &&
+               m_commands[end].textures == command.textures &&
+               m_commands[end].samplers == command.samplers) {
+          end++;
+        }
+
+        m_geometry_pool->draw(indirect_index, end - i);
+        indirect_index += end - i;
+        i = end;
+        continue;
+      }
+
+      m_uniform_ring.bind_range(OBJECT_CONSTANTS_BINDING, base + command.object_offset, sizeof(ObjectConstants));
+      if (current_program && current_program->supports_indirect()) {
+        // The mesh VAO has no instance arrays, so feed them as constant attributes
+        ObjectConstants object;
+        std::memcpy(&object, &m_uniform_staging[command.object_offset], sizeof(object));
+        for (GLuint column = 0; column < 4; column++)
+          glVertexAttrib4fv(INSTANCE_MODEL_LOCATION + column, &object.model[column][0]);
+        glVertexAttrib1f(INSTANCE_LAYER_LOCATION, object.texture_layer);
+      }
+      glDrawElements(GL_TRIANGLES, command.index_count, GL_UNSIGNED_INT, 0);
+      i++;
+    }
+
+    glBindVertexArray(0);
 
-      // Draw mesh
-      glBindVertexArray(mesh_renderer->m_vao);
-      auto indices = mesh_renderer->get_indices();
-      glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-      glBindVertexArray(0);
+    // Passes drawing without samplers rely on the texture's own parameters
+    for (auto unit{0u}; unit < MAX_TEXTURE_UNITS; unit++) {
+      if (bound_samplers[unit]) glBindSampler(unit, 0);
     }
   }
 }
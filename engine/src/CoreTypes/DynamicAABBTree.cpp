@@ -0,0 +1,357 @@
+#include <KvantEngine/CoreTypes/DynamicAABBTree.hpp>
+
+// C++ Headers
+#include <cassert>
+#include <algorithm>
+
+namespace Kvant {
+
+  DynamicAABBTree::DynamicAABBTree (float margin) : m_margin(margin) {}
+
+  int DynamicAABBTree::allocate_node () {
+    if (m_free_list == NULL_PROXY) {
+      m_nodes.emplace_back();
+      m_nodes.back().height = 0;
+      return (int)m_nodes.size() - 1;
+    }
+
+    int node = m_free_list;
+    m_free_list = m_nodes[node].parent;
+    m_nodes[node] = Node();
+    m_nodes[node].height = 0;
+    return node;
+  }
+
+  void DynamicAABBTree::free_node (int node) {
+    m_nodes[node].parent = m_free_list;
+    m_nodes[node].entity = ex::Entity();
+    m_nodes[node].height = -1;
+    m_free_list = node;
+  }
+
+  ProxyId DynamicAABBTree::create_proxy (const AABB& aabb, ex::Entity entity) {
+    int proxy = allocate_node();
+
+    glm::vec3 r(m_margin);
+    m_nodes[proxy].aabb = AABB(aabb.lower - r, aabb.upper + r);
+    m_nodes[proxy].entity = entity;
+
+    insert_leaf(proxy);
+    ++m_proxy_count;
+    return proxy;
+  }
+
+  void DynamicAABBTree::destroy_proxy (ProxyId proxy) {
+    assert(proxy >= 0 && proxy < (int)m_nodes.size());
+    assert(m_nodes[proxy].is_leaf());
+
+    remove_leaf(proxy);
+    free_node(proxy);
+    --m_proxy_count;
+  }
+
+  bool DynamicAABBTree::move_proxy (ProxyId proxy, const AABB& aabb, const glm::vec3& displacement) {
+    assert(proxy >= 0 && proxy < (int)m_nodes.size());
+    assert(m_nodes[proxy].is_leaf());
+
+    if (m_nodes[proxy].aabb.contains(aabb)) return false;
+
+    remove_leaf(proxy);
+
+    // Extend box in the direction of movement to anticipate the next update
+    glm::vec3 r(m_margin);
+    AABB fat(aabb.lower - r, aabb.upper + r);
+    glm::vec3 d = 2.f * displacement;
+    for (int i = 0; i < 3; i++) {
+      if (d[i] < 0.f) fat.lower[i] += d[i];
+      else fat.upper[i] += d[i];
+    }
+    m_nodes[proxy].aabb = fat;
+
+    insert_leaf(proxy);
+    return true;
+  }
+
+  void DynamicAABBTree::insert_leaf (int leaf) {
+    if (m_root == NULL_PROXY) {
+      m_root = leaf;
+      m_nodes[m_root].parent = NULL_PROXY;
+      return;
+    }
+
+    // Find the best sibling using the surface area heuristic
+    AABB leaf_aabb = m_nodes[leaf].aabb;
+    int index = m_root;
+    while (!m_nodes[index].is_leaf()) {
+      int child1 = m_nodes[index].child1;
+      int child2 = m_nodes[index].child2;
+
+      float area = m_nodes[index].aabb.get_perimeter();
+      float combined_area = AABB::merge(m_nodes[index].aabb, leaf_aabb).get_perimeter();
+
+      // Cost of creating a new parent for this node and the new leaf
+      float cost = 2.f * combined_area;
+      // Minimum cost of pushing the leaf further down the tree
+      float inheritance_cost = 2.f * (combined_area - area);
+
+      auto descend_cost = [&] (int child) {
+        float merged = AABB::merge(leaf_aabb, m_nodes[child].aabb).get_perimeter();
+        if (m_nodes[child].is_leaf()) return merged + inheritance_cost;
+        return (merged - m_nodes[child].aabb.get_perimeter()) + inheritance_cost;
+      };
+      float cost1 = descend_cost(child1);
+      float cost2 = descend_cost(child2);
+
+      if (cost < cost1 && cost < cost2) break;
+      index = cost1 < cost2 ? child1 : child2;
+    }
+    int sibling = index;
+
+    // Create a new parent
+    int old_parent = m_nodes[sibling].parent;
+    int new_parent = allocate_node();
+    m_nodes[new_parent].parent = old_parent;
+    m_nodes[new_parent].aabb = AABB::merge(leaf_aabb, m_nodes[sibling].aabb);
+    m_nodes[new_parent].height = m_nodes[sibling].height + 1;
+    m_nodes[new_parent].child1 = sibling;
+    m_nodes[new_parent].child2 = leaf;
+    m_nodes[sibling].parent = new_parent;
+    m_nodes[leaf].parent = new_parent;
+
+    if (old_parent != NULL_PROXY) {
+      if (m_nodes[old_parent].child1 == sibling)
+        m_nodes[old_parent].child1 = new_parent;
+      else
+        m_nodes[old_parent].child2 = new_parent;
+    }
+    else {
+      m_root = new_parent;
+    }
+
+    refit(m_nodes[leaf].parent);
+  }
+
+  void DynamicAABBTree::remove_leaf (int leaf) {
+    if (leaf == m_root) {
+      m_root = NULL_PROXY;
+      return;
+    }
+
+    int parent = m_nodes[leaf].parent;
+    int grand_parent = m_nodes[parent].parent;
+    int sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+    if (grand_parent != NULL_PROXY) {
+      // Destroy parent and connect sibling to grand parent
+      if (m_nodes[grand_parent].child1 == parent)
+        m_nodes[grand_parent].child1 = sibling;
+      else
+        m_nodes[grand_parent].child2 = sibling;
+      m_nodes[sibling].parent = grand_parent;
+      free_node(parent);
+
+      refit(grand_parent);
+    }
+    else {
+      m_root = sibling;
+      m_nodes[sibling].parent = NULL_PROXY;
+      free_node(parent);
+    }
+  }
+
+  void DynamicAABBTree::refit (int node) {
+    // Walk back up the tree fixing heights and boxes
+    for (int index = node; index != NULL_PROXY; index = m_nodes[index].parent) {
+      index = balance(index);
+
+      int child1 = m_nodes[index].child1;
+      int child2 = m_nodes[index].child2;
+
+      m_nodes[index].height = 1 + std::max(m_nodes[child1].height, m_nodes[child2].height);
+      m_nodes[index].aabb = AABB::merge(m_nodes[child1].aabb, m_nodes[child2].aabb);
+    }
+  }
+
+  /*! Performs a left or right rotation if node A is imbalanced
+   *
+   *  @return The new root index of the rotated subtree
+   */
+  int DynamicAABBTree::balance (int a) {
+    if (m_nodes[a].is_leaf() || m_nodes[a].height < 2) return a;
+
+    int b = m_nodes[a].child1;
+    int c = m_nodes[a].child2;
+    int balance = m_nodes[c].height - m_nodes[b].height;
+
+    // Rotate the taller child up, swap in the grandchild keeping the tree shallowest
+    auto rotate = [this, a] (int up, int other) {
+      Node& A = m_nodes[a];
+      Node& U = m_nodes[up];
+      int f = U.child1;
+      int g = U.child2;
+
+      // Swap A and U
+      U.child1 = a;
+      U.parent = A.parent;
+      A.parent = up;
+
+      if (U.parent != NULL_PROXY) {
+        if (m_nodes[U.parent].child1 == a)
+          m_nodes[U.parent].child1 = up;
+        else
+          m_nodes[U.parent].child2 = up;
+      }
+      else {
+        m_root = up;
+      }
+
+      // Keep the taller grandchild under U
+      int keep = m_nodes[f].height > m_nodes[g].height ? f : g;
+      int give = keep == f ? g : f;
+
+      U.child2 = keep;
+      if (A.child1 == up) A.child1 = give;
+      else A.child2 = give;
+      m_nodes[give].parent = a;
+
+      A.aabb = AABB::merge(m_nodes[other].aabb, m_nodes[give].aabb);
+      U.aabb = AABB::merge(A.aabb, m_nodes[keep].aabb);
+
+      A.height = 1 + std::max(m_nodes[other].height, m_nodes[give].height);
+      U.height = 1 + std::max(A.height, m_nodes[keep].height);
+
+      return up;
+    };
+
+    if (balance > 1) return rotate(c, b);
+    if (balance < -1) return rotate(b, c);
+    return a;
+  }
+
+  void DynamicAABBTree::query (const AABB& aabb, const QueryCallback& callback) const {
+    std::vector<int> stack;
+    stack.push_back(m_root);
+
+    while (!stack.empty()) {
+      int index = stack.back();
+      stack.pop_back();
+      if (index == NULL_PROXY) continue;
+
+      const Node& node = m_nodes[index];
+      if (!node.aabb.overlaps(aabb)) continue;
+
+      if (node.is_leaf()) {
+        if (!callback(index)) return;
+      }
+      else {
+        stack.push_back(node.child1);
+        stack.push_back(node.child2);
+      }
+    }
+  }
+
+  void DynamicAABBTree::query (const Frustum& frustum, const QueryCallback& callback) const {
+    std::vector<int> stack;
+    stack.push_back(m_root);
+
+    while (!stack.empty()) {
+      int index = stack.back();
+      stack.pop_back();
+      if (index == NULL_PROXY) continue;
+
+      const Node& node = m_nodes[index];
+      auto result = frustum.classify(node.aabb);
+      if (result == Frustum::Result::OUTSIDE) continue;
+
+      // Whole subtree is visible, skip further plane tests
+      if (result == Frustum::Result::INSIDE) {
+        bool proceed = true;
+        query_all(index, callback, proceed);
+        if (!proceed) return;
+        continue;
+      }
+
+      if (node.is_leaf()) {
+        if (!callback(index)) return;
+      }
+      else {
+        stack.push_back(node.child1);
+        stack.push_back(node.child2);
+      }
+    }
+  }
+
+  void DynamicAABBTree::query_all (int index, const QueryCallback& callback, bool& proceed) const {
+    const Node& node = m_nodes[index];
+    if (node.is_leaf()) {
+      proceed = callback(index);
+      return;
+    }
+
+    query_all(node.child1, callback, proceed);
+    if (proceed) query_all(node.child2, callback, proceed);
+  }
+
+  void DynamicAABBTree::ray_cast (const Ray& ray, float max_t, const RayCallback& callback) const {
+    std::vector<int> stack;
+    stack.push_back(m_root);
+
+    while (!stack.empty()) {
+      int index = stack.back();
+      stack.pop_back();
+      if (index == NULL_PROXY) continue;
+
+      const Node& node = m_nodes[index];
+      float t;
+      if (!ray.intersects(node.aabb, max_t, t)) continue;
+
+      if (node.is_leaf()) {
+        float value = callback(index, ray, max_t);
+        if (value == 0.f) return;
+        if (value > 0.f) max_t = value;
+      }
+      else {
+        stack.push_back(node.child1);
+        stack.push_back(node.child2);
+      }
+    }
+  }
+
+  ProxyId DynamicAABBTree::query_nearest (const glm::vec3& point, float max_distance) const {
+    ProxyId best = NULL_PROXY;
+    float best_distance = max_distance * max_distance;
+
+    std::vector<int> stack;
+    stack.push_back(m_root);
+
+    while (!stack.empty()) {
+      int index = stack.back();
+      stack.pop_back();
+      if (index == NULL_PROXY) continue;
+
+      const Node& node = m_nodes[index];
+      float distance = node.aabb.distance_squared(point);
+      if (distance > best_distance) continue;
+
+      if (node.is_leaf()) {
+        best = index;
+        best_distance = distance;
+        continue;
+      }
+
+      // Visit the closer child first so the bound tightens early
+      int closer = node.child1, further = node.child2;
+      if (m_nodes[further].aabb.distance_squared(point) < m_nodes[closer].aabb.distance_squared(point))
+        std::swap(closer, further);
+      stack.push_back(further);
+      stack.push_back(closer);
+    }
+
+    return best;
+  }
+
+  int DynamicAABBTree::get_height () const {
+    if (m_root == NULL_PROXY) return 0;
+    return m_nodes[m_root].height;
+  }
+}
@@ -0,0 +1,163 @@
+#include <KvantEngine/CoreTypes/GeometryPool.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <cstddef>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+
+namespace Kvant {
+
+  GeometryPool::GeometryPool (GLsizeiptr vertex_capacity, GLsizeiptr index_capacity)
+      : m_vertex_capacity(vertex_capacity * sizeof(Vertex)), m_index_capacity(index_capacity * sizeof(GLuint)) {
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glGenBuffers(1, &m_ebo);
+    glGenBuffers(1, &m_draw_data_buffer);
+    glGenBuffers(1, &m_indirect_buffer);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, m_vertex_capacity, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+    glBufferData(GL_COPY_WRITE_BUFFER, m_index_capacity, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    KVANT_GPU_TRACK(GpuCategory::VERTEX_ARRAY, m_vao, 0, "Geometry pool");
+    KVANT_GPU_TRACK(GpuCategory::BUFFER, m_vbo, m_vertex_capacity, "Geometry pool vertices");
+    KVANT_GPU_TRACK(GpuCategory::BUFFER, m_ebo, m_index_capacity, "Geometry pool indices");
+    KVANT_GPU_TRACK(GpuCategory::BUFFER, m_draw_data_buffer, 0, "Geometry pool draw data");
+    KVANT_GPU_TRACK(GpuCategory::BUFFER, m_indirect_buffer, 0, "Geometry pool draw commands");
+
+    setup_vao();
+  }
+
+  GeometryPool::~GeometryPool () {
+    auto& memory = GpuMemory::instance();
+    memory.untrack(GpuCategory::VERTEX_ARRAY, m_vao);
+    for (auto buffer : {m_vbo, m_ebo, m_draw_data_buffer, m_indirect_buffer}) memory.untrack(GpuCategory::BUFFER, buffer);
+
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ebo);
+    glDeleteBuffers(1, &m_draw_data_buffer);
+    glDeleteBuffers(1, &m_indirect_buffer);
+  }
+
+  void GeometryPool::setup_vao () {
+    glBindVertexArray(m_vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+
+    // Same layout as CMeshRenderer
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                     (GLvoid*)offsetof(Vertex, position.x));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                     (GLvoid*)offsetof(Vertex, normal.x));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                     (GLvoid*)offsetof(Vertex, tex_coord.x));
+
+    // Per draw model matrix, one column per attribute
+    glBindBuffer(GL_ARRAY_BUFFER, m_draw_data_buffer);
+    for (GLuint i = 0; i < 4; i++) {
+      glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + i);
+      glVertexAttribPointer(INSTANCE_MODEL_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(ObjectConstants),
+                            (GLvoid*)(i * sizeof(glm::vec4)));
+      glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + i, 1);
+    }
+    glEnableVertexAttribArray(INSTANCE_LAYER_LOCATION);
+    glVertexAttribPointer(INSTANCE_LAYER_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(ObjectConstants),
+                          (GLvoid*)offsetof(ObjectConstants, texture_layer));
+    glVertexAttribDivisor(INSTANCE_LAYER_LOCATION, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  void GeometryPool::reserve (GLuint& buffer, GLsizeiptr& capacity, GLsizeiptr used, GLsizeiptr required) {
+    if (required <= capacity) return;
+
+    GLsizeiptr new_capacity = std::max(2 * capacity, required);
+
+    GLuint new_buffer;
+    glGenBuffers(1, &new_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_capacity, nullptr, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // The grown buffer takes the place of the old one
+    auto& memory = GpuMemory::instance();
+    if (auto old = memory.find(GpuCategory::BUFFER, buffer)) {
+      auto owner = old->owner;
+      memory.untrack(GpuCategory::BUFFER, buffer);
+      KVANT_GPU_TRACK(GpuCategory::BUFFER, new_buffer, new_capacity, owner);
+    }
+    glDeleteBuffers(1, &buffer);
+
+    buffer = new_buffer;
+    capacity = new_capacity;
+  }
+
+  GeometryPool::Allocation GeometryPool::add (const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices) {
+    Allocation allocation;
+    if (vertices.empty() || indices.empty()) return allocation;
+
+    GLsizeiptr vertex_size = vertices.size() * sizeof(Vertex);
+    GLsizeiptr index_size = indices.size() * sizeof(GLuint);
+
+    bool grown = m_vertex_used + vertex_size > m_vertex_capacity ||
+                 m_index_used + index_size > m_index_capacity;
+    reserve(m_vbo, m_vertex_capacity, m_vertex_used, m_vertex_used + vertex_size);
+    reserve(m_ebo, m_index_capacity, m_index_used, m_index_used + index_size);
+    if (grown) setup_vao();
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, m_vertex_used, vertex_size, &vertices[0]);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, m_index_used, index_size, &indices[0]);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    allocation.first_index = m_index_used / sizeof(GLuint);
+    allocation.index_count = indices.size();
+    allocation.base_vertex = m_vertex_used / sizeof(Vertex);
+
+    m_vertex_used += vertex_size;
+    m_index_used += index_size;
+    return allocation;
+  }
+
+  void GeometryPool::upload_draws (const std::vector<DrawElementsIndirectCommand>& commands,
+                                   const std::vector<ObjectConstants>& objects) {
+    if (commands.empty()) return;
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+    GpuMemory::instance().resize(GpuCategory::BUFFER, m_indirect_buffer, commands.size() * sizeof(DrawElementsIndirectCommand));
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_draw_data_buffer);
+    glBufferData(GL_ARRAY_BUFFER, objects.size() * sizeof(ObjectConstants), nullptr, GL_STREAM_DRAW);
+    GpuMemory::instance().resize(GpuCategory::BUFFER, m_draw_data_buffer, objects.size() * sizeof(ObjectConstants));
+    glBufferSubData(GL_ARRAY_BUFFER, 0, objects.size() * sizeof(ObjectConstants), objects.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  void GeometryPool::draw (std::size_t first, std::size_t count) const {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                (GLvoid*)(first * sizeof(DrawElementsIndirectCommand)), count, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  }
+}
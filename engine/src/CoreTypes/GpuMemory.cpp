@@ -0,0 +1,282 @@
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Third party
+#include <imgui/imgui.h>
+#include <spdlog/spdlog.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/TextureLoader.hpp>
+
+namespace Kvant {
+
+  namespace {
+    // Largest objects listed by the inspector
+    constexpr std::size_t MAX_LISTED = 64;
+
+    std::string format_bytes (std::size_t bytes) {
+      char text[32];
+      if (bytes >= 1024 * 1024) std::snprintf(text, sizeof(text), "%.2f MB", bytes / (1024.0 * 1024.0));
+      else if (bytes >= 1024) std::snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+      else std::snprintf(text, sizeof(text), "%zu B", bytes);
+      return text;
+    }
+
+    const char* get_file_name (const char* file) {
+      auto slash = std::strrchr(file, '/');
+      return slash ? slash + 1 : file;
+    }
+
+    // Bytes per texel of uncompressed formats, drivers pad 3 component ones to 4
+    std::size_t get_texel_bytes (GLenum internal_format) {
+      switch (internal_format) {
+        case GL_R8:
+          return 1;
+        case GL_RG8:
+        case GL_R16F:
+        case GL_DEPTH_COMPONENT16:
+          return 2;
+        case GL_RGBA16F:
+        case GL_RGB16F:
+        case GL_RG32F:
+          return 8;
+        case GL_RGBA32F:
+        case GL_RGB32F:
+          return 16;
+        case GL_DEPTH32F_STENCIL8:
+          return 8;
+        default:
+          return 4;
+      }
+    }
+
+    std::string get_state_name (const State* state) {
+      if (!state) return "Engine";
+      char text[32];
+      std::snprintf(text, sizeof(text), "State %p", (const void*)state);
+      return text;
+    }
+  }
+
+  const char* get_category_name (GpuCategory category) {
+    switch (category) {
+      case GpuCategory::TEXTURE: return "Textures";
+      case GpuCategory::BUFFER: return "Buffers";
+      case GpuCategory::VERTEX_ARRAY: return "Vertex arrays";
+      case GpuCategory::PROGRAM: return "Programs";
+      case GpuCategory::FRAMEBUFFER: return "Framebuffers";
+      case GpuCategory::SAMPLER: return "Samplers";
+      default: return "Unknown";
+    }
+  }
+
+  GpuMemory& GpuMemory::instance () {
+    static GpuMemory memory;
+    return memory;
+  }
+
+  GpuMemory::Scope::Scope (const State* state) : m_previous(GpuMemory::instance().m_scope) {
+    GpuMemory::instance().m_scope = state;
+  }
+
+  GpuMemory::Scope::~Scope () {
+    GpuMemory::instance().m_scope = m_previous;
+  }
+
+  void GpuMemory::track (GpuCategory category, GLuint id, std::size_t bytes, const std::string& owner, const char* file, int line) {
+    if (!id) return;
+
+    auto& allocation = m_allocations[make_key(category, id)];
+    // GL reuses deleted ids, an object created over an untracked one replaces it
+    if (allocation.id) remove(allocation, allocation.bytes);
+
+    allocation.category = category;
+    allocation.id = id;
+    allocation.bytes = bytes;
+    allocation.owner = owner;
+    allocation.file = file;
+    allocation.line = line;
+    allocation.state = m_scope;
+    add(allocation, bytes);
+  }
+
+  void GpuMemory::resize (GpuCategory category, GLuint id, std::size_t bytes) {
+    auto found_it = m_allocations.find(make_key(category, id));
+    if (found_it == m_allocations.end()) return;
+
+    auto& allocation = found_it->second;
+    remove(allocation, allocation.bytes);
+    allocation.bytes = bytes;
+    add(allocation, bytes);
+  }
+
+  void GpuMemory::untrack (GpuCategory category, GLuint id) {
+    auto found_it = m_allocations.find(make_key(category, id));
+    if (found_it == m_allocations.end()) return;
+
+    remove(found_it->second, found_it->second.bytes);
+    m_allocations.erase(found_it);
+  }
+
+  void GpuMemory::add (const GpuAllocation& allocation, std::size_t bytes) {
+    auto category = (std::size_t)allocation.category;
+    m_totals[category] += bytes;
+    m_counts[category]++;
+    m_state_totals[allocation.state][category] += bytes;
+  }
+
+  void GpuMemory::remove (const GpuAllocation& allocation, std::size_t bytes) {
+    auto category = (std::size_t)allocation.category;
+    m_totals[category] -= bytes;
+    m_counts[category]--;
+    m_state_totals[allocation.state][category] -= bytes;
+  }
+
+  std::size_t GpuMemory::get_total () const {
+    std::size_t total = 0;
+    for (auto bytes : m_totals) total += bytes;
+    return total;
+  }
+
+  std::size_t GpuMemory::get_total (const State* state, GpuCategory category) const {
+    auto found_it = m_state_totals.find(state);
+    return found_it != m_state_totals.end() ? found_it->second[(std::size_t)category] : 0;
+  }
+
+  std::size_t GpuMemory::get_total (const State* state) const {
+    auto found_it = m_state_totals.find(state);
+    if (found_it == m_state_totals.end()) return 0;
+
+    std::size_t total = 0;
+    for (auto bytes : found_it->second) total += bytes;
+    return total;
+  }
+
+  const GpuAllocation* GpuMemory::find (GpuCategory category, GLuint id) const {
+    auto found_it = m_allocations.find(make_key(category, id));
+    return found_it != m_allocations.end() ? &found_it->second : nullptr;
+  }
+
+  void GpuMemory::release_state (const State* state) {
+    if (!state) return;
+
+    std::size_t leaked = 0, bytes = 0;
+    for (auto& entry : m_allocations) {
+      auto& allocation = entry.second;
+      if (allocation.state != state) continue;
+
+      spdlog::get("log")->warn("GL object {} ({}, {}) of a destroyed state was never deleted, created at {}:{}",
+                               allocation.id, allocation.owner, get_category_name(allocation.category),
+                               get_file_name(allocation.file), allocation.line);
+      remove(allocation, allocation.bytes);
+      allocation.state = nullptr;
+      add(allocation, allocation.bytes);
+      leaked++;
+      bytes += allocation.bytes;
+    }
+    if (leaked) spdlog::get("log")->warn("{} GL objects leaked, {}", leaked, format_bytes(bytes));
+
+    // The address may be reused by the next state
+    m_state_totals.erase(state);
+    if (m_filter_state && m_state_filter == state) m_filter_state = false;
+  }
+
+  std::size_t GpuMemory::get_texture_size (GLenum internal_format, GLsizei width, GLsizei height, GLsizei levels, GLsizei layers) {
+    // Anything but the block compressed formats comes back as 1x1 blocks of RGBA8
+    auto block = get_block_format(internal_format);
+    if (block.width == 1) block.bytes = get_texel_bytes(internal_format);
+
+    std::size_t size = 0;
+    for (GLsizei i = 0; i < levels; i++) {
+      size += (std::size_t)((width + block.width - 1) / block.width) * ((height + block.height - 1) / block.height) * block.bytes;
+      width = std::max(1, width / 2);
+      height = std::max(1, height / 2);
+    }
+    return size * layers;
+  }
+
+  void GpuMemory::draw_imgui (bool* open) {
+    ImGui::SetNextWindowSize(ImVec2(560, 420), ImGuiSetCond_FirstUseEver);
+    if (!ImGui::Begin("GPU Memory", open)) {
+      ImGui::End();
+      return;
+    }
+
+    std::size_t count = 0;
+    for (auto objects : m_counts) count += objects;
+    ImGui::Text("%s in %zu objects", format_bytes(get_total()).c_str(), count);
+    ImGui::TextDisabled("Click a category or state to filter the objects below");
+
+    ImGui::Separator();
+    ImGui::Columns(3, "gpu_categories", false);
+    for (int i = 0; i < (int)GpuCategory::COUNT; i++) {
+      if (ImGui::Selectable(get_category_name((GpuCategory)i), m_category_filter == i, ImGuiSelectableFlags_SpanAllColumns))
+        m_category_filter = m_category_filter == i ? -1 : i;
+      ImGui::NextColumn();
+      ImGui::Text("%zu", m_counts[i]);
+      ImGui::NextColumn();
+      ImGui::Text("%s", format_bytes(m_totals[i]).c_str());
+      ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    ImGui::Separator();
+    ImGui::Columns(2, "gpu_states", false);
+    for (auto& entry : m_state_totals) {
+      auto state = entry.first;
+      bool selected = m_filter_state && m_state_filter == state;
+      if (ImGui::Selectable(get_state_name(state).c_str(), selected, ImGuiSelectableFlags_SpanAllColumns)) {
+        m_filter_state = !selected;
+        m_state_filter = state;
+      }
+      ImGui::NextColumn();
+      ImGui::Text("%s", format_bytes(get_total(state)).c_str());
+      ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    std::vector<const GpuAllocation*> listed;
+    for (auto& entry : m_allocations) {
+      auto& allocation = entry.second;
+      if (m_category_filter >= 0 && (int)allocation.category != m_category_filter) continue;
+      if (m_filter_state && allocation.state != m_state_filter) continue;
+      listed.push_back(&allocation);
+    }
+    auto shown = std::min(listed.size(), MAX_LISTED);
+    std::partial_sort(listed.begin(), listed.begin() + shown, listed.end(), [] (const GpuAllocation* a, const GpuAllocation* b) {
+      return a->bytes > b->bytes;
+    });
+
+    ImGui::Separator();
+    ImGui::Text("Largest %zu of %zu objects", shown, listed.size());
+    ImGui::Columns(4, "gpu_objects", true);
+    ImGui::Text("Owner");
+    ImGui::NextColumn();
+    ImGui::Text("Category");
+    ImGui::NextColumn();
+    ImGui::Text("Size");
+    ImGui::NextColumn();
+    ImGui::Text("Created at");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (std::size_t i = 0; i < shown; i++) {
+      auto allocation = listed[i];
+      ImGui::Text("%s", allocation->owner.c_str());
+      ImGui::NextColumn();
+      ImGui::Text("%s %u", get_category_name(allocation->category), allocation->id);
+      ImGui::NextColumn();
+      ImGui::Text("%s", format_bytes(allocation->bytes).c_str());
+      ImGui::NextColumn();
+      ImGui::Text("%s:%d", get_file_name(allocation->file), allocation->line);
+      ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    ImGui::End();
+  }
+}
@@ -0,0 +1,164 @@
+#include <KvantEngine/CoreTypes/Material.hpp>
+
+// C++ Headers
+#include <atomic>
+
+// Third party
+#include <spdlog/spdlog.h>
+
+namespace Kvant {
+
+  namespace fs = boost::filesystem;
+
+  Material::Material (const ResourceHandle handle, const fs::path& filepath)
+      : Resource(handle, filepath), m_id(next_id()) {
+    load();
+  }
+
+  MaterialId Material::next_id () {
+    // Instances with overrides draw ids too, possibly while another state loads
+    static std::atomic<MaterialId> counter{1};
+    return counter++;
+  }
+
+  bool Material::load () {
+    YAML::Node root;
+    try {
+      root = YAML::LoadFile(m_filepath.string());
+    }
+    catch (const YAML::Exception& e) {
+      spdlog::get("log")->error("Loading material {} failed: {}", m_handle, e.what());
+      return false;
+    }
+
+    auto program = root["program"];
+    if (!program || !program["vertex"] || !program["fragment"]) {
+      spdlog::get("log")->error("Material {} doesn't name a vertex and fragment shader", m_handle);
+      return false;
+    }
+
+    m_vertex_file = program["vertex"].as<std::string>();
+    m_fragment_file = program["fragment"].as<std::string>();
+    m_defines.clear();
+    if (program["defines"]) {
+      for (auto define : program["defines"]) m_defines.push_back(define.as<std::string>());
+    }
+    m_variant_key = ShaderProgram::make_variant_key(m_defines);
+
+    m_textures.clear();
+    if (root["textures"]) {
+      for (auto texture : root["textures"]) m_textures.push_back(texture.as<std::string>());
+    }
+
+    m_samplers.clear();
+    if (root["samplers"]) {
+      for (auto sampler : root["samplers"])
+        m_samplers.push_back(SamplerCache::instance().get_id(SamplerDesc::from_yaml(sampler)));
+    }
+
+    m_params->clear();
+    if (root["params"]) {
+      for (auto param : root["params"]) load_param(param.first.as<std::string>(), param.second);
+    }
+    return true;
+  }
+
+  void Material::load_param (const std::string& name, const YAML::Node& node) {
+    if (node.IsScalar()) {
+      m_params->set(name.c_str(), node.as<GLfloat>());
+      return;
+    }
+
+    std::vector<GLfloat> values;
+    if (node.IsSequence()) {
+      for (auto value : node) values.push_back(value.as<GLfloat>());
+    }
+
+    switch (values.size()) {
+      case 2: m_params->set(name.c_str(), glm::vec2(values[0], values[1])); break;
+      case 3: m_params->set(name.c_str(), glm::vec3(values[0], values[1], values[2])); break;
+      case 4: m_params->set(name.c_str(), glm::vec4(values[0], values[1], values[2], values[3])); break;
+      case 16: {
+        glm::mat4 matrix;
+        for (int column = 0; column < 4; column++)
+          for (int row = 0; row < 4; row++)
+            matrix[column][row] = values[column * 4 + row];
+        m_params->set(name.c_str(), matrix);
+        break;
+      }
+      default:
+        spdlog::get("log")->error("Material {} parameter {} is not a float, vector or matrix", m_handle, name);
+    }
+  }
+
+  void Material::bind (ResourceManager<ShaderProgram>& shaders, TextureLoadFunc load_texture) {
+    m_shader_resources = &shaders;
+    m_load_texture = load_texture;
+
+    m_texture_ids.clear();
+    for (auto& texture : m_textures) m_texture_ids.push_back(load_texture(texture));
+    if (m_vertex_file.empty() || m_fragment_file.empty()) return;
+
+    m_program = shaders.get(shaders.add(m_vertex_file, m_fragment_file));
+
+    // Submit right away, so the compile overlaps loading instead of the first draw
+    m_program->get_variant(m_variant_key, m_defines);
+    m_resolved.reset();
+  }
+
+  void Material::on_file_modified (const fs::path&) {
+    if (!load()) {
+      spdlog::get("log")->error("Keeping the previous version of material {}", m_handle);
+      return;
+    }
+
+    // Repacked from the reflected layout, parameters removed from the file must not keep their old values
+    if (m_resolved) m_params->set_layout(*m_resolved);
+
+    if (m_shader_resources && m_load_texture) bind(*m_shader_resources, m_load_texture);
+    m_revision++;
+  }
+
+  std::shared_ptr<Material::SharedParams> Material::share_params (const MaterialParams& overrides) {
+    auto key = overrides.hash_values();
+    auto range = m_shared_params.equal_range(key);
+    for (auto it = range.first; it != range.second;) {
+      auto shared = it->second.lock();
+      // Built for an earlier revision, its instances move on as they resolve
+      if (!shared || shared->revision != m_revision) {
+        it = m_shared_params.erase(it);
+        continue;
+      }
+      if (shared->params.same_values(overrides)) return shared;
+      ++it;
+    }
+
+    auto shared = std::make_shared<SharedParams>();
+    shared->params.copy_values(overrides);
+    shared->params.set_layout(*m_resolved, m_params.get());
+    shared->revision = m_revision;
+    m_shared_params.emplace(key, shared);
+    return shared;
+  }
+
+  void Material::on_file_deleted (const fs::path&) {
+    spdlog::get("log")->warn("Material {} deleted, keeping the last version", m_handle);
+  }
+
+  void Material::resolve () {
+    if (!m_resolved || !m_ready || (m_program && m_generation != m_program->get_generation())) {
+      auto variant = m_program ? m_program->get_variant(m_variant_key, m_defines) : nullptr;
+      m_ready = variant != nullptr;
+      m_generation = m_program ? m_program->get_generation() : 0;
+
+      auto resolved = m_ready ? variant : ShaderProgram::get_fallback();
+      if (resolved != m_resolved) {
+        m_resolved = resolved;
+        m_params->set_layout(*m_resolved);
+        m_revision++;
+      }
+    }
+
+    m_params->upload();
+  }
+}
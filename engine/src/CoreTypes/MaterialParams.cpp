@@ -0,0 +1,92 @@
+#include <KvantEngine/CoreTypes/MaterialParams.hpp>
+
+// C++ Headers
+#include <algorithm>
+
+// Third party
+#include <spdlog/spdlog.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+
+namespace Kvant {
+
+  MaterialParams::~MaterialParams () {
+    if (!m_buffer_id) return;
+    GpuMemory::instance().untrack(GpuCategory::BUFFER, m_buffer_id);
+    glDeleteBuffers(1, &m_buffer_id);
+  }
+
+  void MaterialParams::set_layout (const Program& program, const MaterialParams* defaults) {
+    auto block = program.get_uniform_block("MaterialParams");
+    m_block = block != nullptr;
+    m_members.clear();
+    m_data.clear();
+
+    if (!block) {
+      if (m_buffer_id) {
+        GpuMemory::instance().untrack(GpuCategory::BUFFER, m_buffer_id);
+        glDeleteBuffers(1, &m_buffer_id);
+      }
+      m_buffer_id = 0;
+      m_buffer_size = 0;
+      return;
+    }
+
+    m_members = block->members;
+    if (defaults && defaults->m_data.size() == (std::size_t)block->data_size)
+      m_data = defaults->m_data;
+    else
+      m_data.assign(block->data_size, 0);
+    for (auto& entry : m_values) write(entry.first, entry.second);
+    m_dirty = true;
+  }
+
+  std::uint64_t MaterialParams::hash_values () const {
+    // Summed, the map's order is unspecified
+    std::uint64_t hash = 0;
+    for (auto& entry : m_values) {
+      auto value = hash_bytes(&entry.first, sizeof(entry.first));
+      value = hash_bytes(&entry.second.type, sizeof(entry.second.type), value);
+      hash += hash_bytes(entry.second.data.data(), entry.second.data.size(), value);
+    }
+    return hash;
+  }
+
+  void MaterialParams::write (NameHash name, const Value& value) {
+    auto member = std::find_if(m_members.begin(), m_members.end(), [name] (const UniformBlockMember& m) {
+      return m.hash == name;
+    });
+    // Not every variant uses every parameter
+    if (member == m_members.end()) return;
+
+    if (member->type != value.type) {
+      spdlog::get("log")->error("Material parameter at offset {} set with the wrong type", member->offset);
+      return;
+    }
+    if (member->offset + value.data.size() > m_data.size()) return;
+
+    std::memcpy(&m_data[member->offset], value.data.data(), value.data.size());
+    m_dirty = true;
+  }
+
+  void MaterialParams::upload () {
+    if (!m_block || !m_dirty) return;
+    m_dirty = false;
+
+    if (!m_buffer_id) {
+      glGenBuffers(1, &m_buffer_id);
+      KVANT_GPU_TRACK(GpuCategory::BUFFER, m_buffer_id, 0, "Material parameters");
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer_id);
+    if (m_buffer_size != (GLsizeiptr)m_data.size()) {
+      m_buffer_size = m_data.size();
+      glBufferData(GL_UNIFORM_BUFFER, m_buffer_size, m_data.data(), GL_DYNAMIC_DRAW);
+      GpuMemory::instance().resize(GpuCategory::BUFFER, m_buffer_id, m_buffer_size);
+    }
+    else {
+      glBufferSubData(GL_UNIFORM_BUFFER, 0, m_buffer_size, m_data.data());
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  }
+}
@@ -0,0 +1,93 @@
+#include <KvantEngine/CoreTypes/MaxRectsPacker.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <climits>
+
+namespace Kvant {
+
+  static bool contains (const PackedRect& outer, const PackedRect& inner) {
+    return inner.x >= outer.x && inner.y >= outer.y &&
+           inner.x + inner.width <= outer.x + outer.width &&
+           inner.y + inner.height <= outer.y + outer.height;
+  }
+
+  MaxRectsPacker::MaxRectsPacker (int width, int height) : m_width(width), m_height(height) {
+    m_free.push_back(PackedRect{0, 0, width, height});
+  }
+
+  bool MaxRectsPacker::insert (int width, int height, PackedRect& result) {
+    if (width <= 0 || height <= 0) return false;
+
+    // Best short side fit, ties broken by the long side
+    int best_short = INT_MAX, best_long = INT_MAX;
+    bool found = false;
+    for (auto& free : m_free) {
+      if (free.width < width || free.height < height) continue;
+
+      int leftover_x = free.width - width, leftover_y = free.height - height;
+      int short_side = std::min(leftover_x, leftover_y), long_side = std::max(leftover_x, leftover_y);
+      if (short_side < best_short || (short_side == best_short && long_side < best_long)) {
+        result = PackedRect{free.x, free.y, width, height};
+        best_short = short_side;
+        best_long = long_side;
+        found = true;
+      }
+    }
+    if (!found) return false;
+
+    split(result);
+    prune();
+    m_used_area += (long)width * height;
+    return true;
+  }
+
+  float MaxRectsPacker::get_occupancy () const {
+    return (float)m_used_area / ((long)m_width * m_height);
+  }
+
+  void MaxRectsPacker::split (const PackedRect& used) {
+    std::vector<PackedRect> result;
+    result.reserve(m_free.size() + 4);
+
+    for (auto& free : m_free) {
+      bool overlaps = used.x < free.x + free.width && used.x + used.width > free.x &&
+                      used.y < free.y + free.height && used.y + used.height > free.y;
+      if (!overlaps) {
+        result.push_back(free);
+        continue;
+      }
+
+      // Up to four maximal rectangles around the used one
+      if (used.x > free.x)
+        result.push_back(PackedRect{free.x, free.y, used.x - free.x, free.height});
+      if (used.x + used.width < free.x + free.width)
+        result.push_back(PackedRect{used.x + used.width, free.y, free.x + free.width - used.x - used.width, free.height});
+      if (used.y > free.y)
+        result.push_back(PackedRect{free.x, free.y, free.width, used.y - free.y});
+      if (used.y + used.height < free.y + free.height)
+        result.push_back(PackedRect{free.x, used.y + used.height, free.width, free.y + free.height - used.y - used.height});
+    }
+
+    m_free.swap(result);
+  }
+
+  void MaxRectsPacker::prune () {
+    // Drop free rectangles contained in another one
+    for (std::size_t i = 0; i < m_free.size(); i++) {
+      for (std::size_t j = i + 1; j < m_free.size(); ) {
+        if (contains(m_free[i], m_free[j])) {
+          m_free.erase(m_free.begin() + j);
+        }
+        else if (contains(m_free[j], m_free[i])) {
+          m_free.erase(m_free.begin() + i);
+          i--;
+          break;
+        }
+        else {
+          j++;
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,126 @@
+#include <KvantEngine/CoreTypes/ProgramBinaryCache.hpp>
+
+// C++ Headers
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+// Third party
+#include <spdlog/spdlog.h>
+
+// Kvant Headers
+#include <KvantEngine/util/Hash.hpp>
+
+namespace Kvant {
+
+  namespace fs = boost::filesystem;
+
+  namespace {
+    constexpr std::uint32_t CACHE_MAGIC = 0x4250564B; // "KVPB"
+    constexpr std::uint32_t CACHE_VERSION = 1;
+
+    struct CacheHeader {
+      std::uint32_t magic;
+      std::uint32_t version;
+      std::uint64_t key;
+      std::uint32_t format;
+      std::uint32_t length;
+    };
+
+    std::string gl_string (GLenum name) {
+      auto str = reinterpret_cast<const char*>(glGetString(name));
+      return str ? str : "";
+    }
+  }
+
+  ProgramBinaryCache& ProgramBinaryCache::instance () {
+    static ProgramBinaryCache cache;
+    return cache;
+  }
+
+  void ProgramBinaryCache::set_directory (const std::string& directory) {
+    m_enabled = false;
+    if (directory.empty()) return;
+
+    GLint formats = 0;
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0) {
+      spdlog::get("log")->info("Driver has no program binary formats, shader cache disabled");
+      return;
+    }
+
+    boost::system::error_code error;
+    fs::create_directories(directory, error);
+    if (!fs::is_directory(directory)) {
+      spdlog::get("log")->warn("Can't create shader cache directory {}", directory);
+      return;
+    }
+
+    m_directory = directory;
+    m_driver_hash = hash_bytes(gl_string(GL_VENDOR));
+    m_driver_hash = hash_bytes(gl_string(GL_RENDERER), m_driver_hash);
+    m_driver_hash = hash_bytes(gl_string(GL_VERSION), m_driver_hash);
+    m_enabled = true;
+  }
+
+  std::uint64_t ProgramBinaryCache::make_key (const std::string& vertex_code, const std::string& fragment_code) const {
+    // Separator keeps "ab" + "c" and "a" + "bc" apart
+    auto key = hash_bytes(vertex_code, m_driver_hash);
+    key = hash_bytes("\0", 1, key);
+    return hash_bytes(fragment_code, key);
+  }
+
+  fs::path ProgramBinaryCache::get_entry_path (std::uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return m_directory / name;
+  }
+
+  bool ProgramBinaryCache::load (Program& program, std::uint64_t key) const {
+    if (!m_enabled) return false;
+
+    std::ifstream file(get_entry_path(key).string(), std::ios::binary);
+    if (!file) return false;
+
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.key != key) return false;
+
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size())) return false;
+
+    if (!program.link_binary(header.format, binary.data(), binary.size())) {
+      spdlog::get("log")->info("Driver rejected cached program {:016x}, recompiling", key);
+      return false;
+    }
+    return true;
+  }
+
+  void ProgramBinaryCache::store (const Program& program, std::uint64_t key) const {
+    if (!m_enabled || !program.is_linked()) return;
+
+    std::vector<char> binary;
+    GLenum format = 0;
+    if (!program.get_binary(binary, format)) return;
+
+    CacheHeader header{CACHE_MAGIC, CACHE_VERSION, key, format, (std::uint32_t)binary.size()};
+
+    // Written aside and renamed, so a crash never leaves a truncated entry behind
+    auto path = get_entry_path(key);
+    auto temp_path = fs::path(path.string() + ".tmp");
+    {
+      std::ofstream file(temp_path.string(), std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(binary.data(), binary.size());
+      if (!file) {
+        spdlog::get("log")->warn("Failed writing shader cache entry {}", temp_path.string());
+        return;
+      }
+    }
+
+    boost::system::error_code error;
+    fs::rename(temp_path, path, error);
+    if (error) fs::remove(temp_path, error);
+  }
+}
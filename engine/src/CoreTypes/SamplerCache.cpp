@@ -0,0 +1,88 @@
+#include <KvantEngine/CoreTypes/SamplerCache.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <string>
+
+// Third party
+#include <spdlog/spdlog.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+
+namespace Kvant {
+
+  constexpr SamplerId SamplerCache::DEFAULT;
+
+  SamplerDesc SamplerDesc::from_yaml (const YAML::Node& node) {
+    SamplerDesc desc;
+
+    if (node["filter"]) {
+      auto filter = node["filter"].as<std::string>();
+      if (filter == "nearest") {
+        desc.min_filter = GL_NEAREST_MIPMAP_NEAREST;
+        desc.mag_filter = GL_NEAREST;
+      }
+      else if (filter == "linear") {
+        desc.min_filter = GL_LINEAR_MIPMAP_NEAREST;
+      }
+      else if (filter != "trilinear") {
+        spdlog::get("log")->warn("Unknown sampler filter {}, using trilinear", filter);
+      }
+    }
+
+    if (node["wrap"]) {
+      auto wrap = node["wrap"].as<std::string>();
+      GLenum mode = GL_REPEAT;
+      if (wrap == "clamp") mode = GL_CLAMP_TO_EDGE;
+      else if (wrap == "mirror") mode = GL_MIRRORED_REPEAT;
+      else if (wrap != "repeat") spdlog::get("log")->warn("Unknown sampler wrap mode {}, using repeat", wrap);
+      desc.wrap_s = desc.wrap_t = mode;
+    }
+
+    if (node["anisotropy"])
+      desc.anisotropy = std::max(1.0f, node["anisotropy"].as<GLfloat>());
+
+    return desc;
+  }
+
+  SamplerCache& SamplerCache::instance () {
+    static SamplerCache cache;
+    return cache;
+  }
+
+  SamplerCache::SamplerCache () {
+    if (GLEW_EXT_texture_filter_anisotropic)
+      glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &m_max_anisotropy);
+
+    get_id(SamplerDesc());
+  }
+
+  SamplerId SamplerCache::get_id (const SamplerDesc& desc) {
+    auto found_it = std::find_if(m_samplers.begin(), m_samplers.end(), [&desc] (const Sampler& sampler) {
+      return sampler.desc == desc;
+    });
+    if (found_it != m_samplers.end()) return found_it - m_samplers.begin();
+
+    Sampler sampler;
+    sampler.desc = desc;
+    glGenSamplers(1, &sampler.sampler);
+    glSamplerParameteri(sampler.sampler, GL_TEXTURE_MIN_FILTER, desc.min_filter);
+    glSamplerParameteri(sampler.sampler, GL_TEXTURE_MAG_FILTER, desc.mag_filter);
+    glSamplerParameteri(sampler.sampler, GL_TEXTURE_WRAP_S, desc.wrap_s);
+    glSamplerParameteri(sampler.sampler, GL_TEXTURE_WRAP_T, desc.wrap_t);
+    if (desc.anisotropy > 1.0f && m_max_anisotropy > 1.0f)
+      glSamplerParameterf(sampler.sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(desc.anisotropy, m_max_anisotropy));
+
+    // Samplers are never deleted, whichever state asked first
+    GpuMemory::Scope scope(nullptr);
+    KVANT_GPU_TRACK(GpuCategory::SAMPLER, sampler.sampler, 0, "Sampler " + std::to_string(m_samplers.size()));
+
+    m_samplers.push_back(sampler);
+    return m_samplers.size() - 1;
+  }
+
+  GLuint SamplerCache::get_sampler (SamplerId id) const {
+    return id < m_samplers.size() ? m_samplers[id].sampler : m_samplers[DEFAULT].sampler;
+  }
+}
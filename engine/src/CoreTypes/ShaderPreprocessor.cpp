@@ -0,0 +1,90 @@
+#include <KvantEngine/CoreTypes/ShaderPreprocessor.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+// Third party
+#include <spdlog/spdlog.h>
+
+namespace Kvant {
+
+  namespace {
+    //! Parses `#include "file"`, tolerating whitespace around the directive
+    bool parse_include (const std::string& line, std::string& file) {
+      auto position = line.find_first_not_of(" \t");
+      if (position == std::string::npos || line[position] != '#') return false;
+
+      position = line.find_first_not_of(" \t", position + 1);
+      if (position == std::string::npos || line.compare(position, 7, "include") != 0) return false;
+
+      auto open = line.find('"', position + 7);
+      auto close = open == std::string::npos ? open : line.find('"', open + 1);
+      if (close == std::string::npos) return false;
+
+      file = line.substr(open + 1, close - open - 1);
+      return true;
+    }
+
+    bool is_version (const std::string& line) {
+      auto position = line.find_first_not_of(" \t");
+      return position != std::string::npos && line.compare(position, 8, "#version") == 0;
+    }
+  }
+
+  bool ShaderPreprocessor::process (const std::string& file, std::string& output) {
+    m_files.clear();
+    output.clear();
+
+    std::vector<std::string> stack;
+    return process_file(file, output, stack);
+  }
+
+  bool ShaderPreprocessor::process_file (const std::string& file, std::string& output, std::vector<std::string>& stack) {
+    if (std::find(stack.begin(), stack.end(), file) != stack.end()) {
+      spdlog::get("log")->error("ERROR::SHADER::INCLUDE_CYCLE {} includes itself", file);
+      return false;
+    }
+    std::ifstream stream((m_include_dir / file).string());
+    if (!stream) {
+      spdlog::get("log")->error("ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ {}", (m_include_dir / file).string());
+      return false;
+    }
+
+    auto index = m_files.size();
+    m_files.push_back(file);
+    stack.push_back(file);
+
+    std::string line;
+    unsigned int line_number = 0;
+    while (std::getline(stream, line)) {
+      line_number++;
+
+      std::string include;
+      if (!parse_include(line, include)) {
+        if (is_version(line) && index != 0) {
+          spdlog::get("log")->warn("Included shader {} has a #version directive, skipping it", file);
+          line.clear();
+        }
+        output += line;
+        output += '\n';
+        continue;
+      }
+
+      // Already pasted, keep the line count intact
+      if (std::find(m_files.begin(), m_files.end(), include) != m_files.end() &&
+          std::find(stack.begin(), stack.end(), include) == stack.end()) {
+        output += '\n';
+        continue;
+      }
+
+      output += "#line 1 " + std::to_string(m_files.size()) + "\n";
+      if (!process_file(include, output, stack)) return false;
+      output += "#line " + std::to_string(line_number + 1) + " " + std::to_string(index) + "\n";
+    }
+
+    stack.pop_back();
+    return true;
+  }
+}
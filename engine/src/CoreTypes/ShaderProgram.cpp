@@ -0,0 +1,234 @@
+#include <KvantEngine/CoreTypes/ShaderProgram.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <chrono>
+
+// Third party
+#include <spdlog/spdlog.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+#include <KvantEngine/CoreTypes/ProgramBinaryCache.hpp>
+#include <KvantEngine/CoreTypes/Shader.hpp>
+#include <KvantEngine/CoreTypes/ShaderPreprocessor.hpp>
+#include <KvantEngine/util/Hash.hpp>
+
+namespace Kvant {
+
+  namespace fs = boost::filesystem;
+
+  namespace {
+    // Shared by every ShaderProgram, released by Engine before the GL context is destroyed
+    std::shared_ptr<Program> fallback;
+  }
+
+  ShaderProgram::ShaderProgram (const ResourceHandle handle, const fs::path& base_path,
+                                const std::string& vertex_file, const std::string& fragment_file,
+                                const std::vector<std::string>& defines)
+      : Resource(handle, base_path / vertex_file), m_base_path(base_path),
+        m_vertex_file(vertex_file), m_fragment_file(fragment_file), m_defines(defines) {
+    std::vector<std::string> no_defines;
+    m_default_key = make_variant_key(no_defines);
+
+    // Only submitted here, ResourceManager polls until it linked
+    m_sources = load_sources(m_base_path, m_vertex_file, m_fragment_file);
+    submit(m_variants[m_default_key], m_sources);
+  }
+
+  ResourceHandle ShaderProgram::make_handle (const std::string& vertex_file, const std::string& fragment_file,
+                                             std::vector<std::string> defines) {
+    std::sort(defines.begin(), defines.end());
+
+    ResourceHandle handle = vertex_file + "|" + fragment_file;
+    for (auto& define : defines) handle += "|" + define;
+    return handle;
+  }
+
+  VariantKey ShaderProgram::make_variant_key (std::vector<std::string>& defines) {
+    std::sort(defines.begin(), defines.end());
+    defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+
+    // Terminators keep {"AB"} and {"A", "B"} apart
+    VariantKey key = hash_bytes("", 0);
+    for (auto& define : defines) key = hash_bytes(define.c_str(), define.size() + 1, key);
+    return key;
+  }
+
+  std::shared_ptr<Program> ShaderProgram::get_fallback () {
+    if (fallback) return fallback;
+
+    const std::string vertex_code =
+      "#version 330 core\n"
+      "layout (std140) uniform FrameConstants { mat4 projection; mat4 camera; float time; };\n"
+      "layout (std140) uniform ObjectConstants { mat4 model; };\n"
+      "layout (location = 0) in vec3 vertex_position;\n"
+      "layout (location = 2) in vec2 vertex_uv;\n"
+      "out vec2 tex_coord0;\n"
+      "void main() {\n"
+      "  gl_Position = projection * camera * model * vec4(vertex_position, 1.0);\n"
+      "  tex_coord0 = vertex_uv;\n"
+      "}\n";
+    const std::string fragment_code =
+      "#version 330 core\n"
+      "in vec2 tex_coord0;\n"
+      "uniform sampler2D sampler;\n"
+      "out vec4 color;\n"
+      "void main() { color = texture(sampler, tex_coord0); }\n";
+
+    // Small enough that compiling it synchronously once doesn't matter
+    Shader shader;
+    shader.compile_source(vertex_code, fragment_code);
+
+    // Outlives every state
+    GpuMemory::Scope scope(nullptr);
+    fallback = std::make_shared<Program>();
+    KVANT_GPU_TRACK(GpuCategory::PROGRAM, fallback->get_program_id(), 0, "Fallback program");
+    fallback->attach_shaders(shader);
+    fallback->link_program();
+    return fallback;
+  }
+
+  void ShaderProgram::release_fallback () {
+    fallback.reset();
+  }
+
+  bool ShaderProgram::depends_on (const std::string& file) const {
+    if (file == m_vertex_file || file == m_fragment_file) return true;
+    return std::find(m_sources.files.begin(), m_sources.files.end(), file) != m_sources.files.end();
+  }
+
+  void ShaderProgram::on_file_modified (const fs::path&) {
+    // Replacing a running std::async would block until it is done, read again once it is
+    if (m_pending_sources.valid() && m_pending_sources.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      m_reread_sources = true;
+      return;
+    }
+
+    // Reading and preprocessing don't need the GL context
+    m_pending_sources = std::async(std::launch::async, &ShaderProgram::load_sources,
+                                   m_base_path, m_vertex_file, m_fragment_file);
+  }
+
+  void ShaderProgram::on_file_deleted (const fs::path&) {
+    spdlog::get("log")->warn("Source of shader program {} deleted, keeping the last build", m_handle);
+  }
+
+  bool ShaderProgram::finish_reload () {
+    if (m_pending_sources.valid()) {
+      if (m_pending_sources.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+
+      auto sources = m_pending_sources.get();
+      if (m_reread_sources) {
+        // Modified again while reading, these sources may already be stale
+        m_reread_sources = false;
+        on_file_modified({});
+        return false;
+      }
+      if (!sources.valid) {
+        spdlog::get("log")->error("Reloading shader program {} failed, keeping the previous program", m_handle);
+      }
+      else {
+        m_sources = sources;
+        for (auto& entry : m_variants) submit(entry.second, m_sources);
+      }
+    }
+
+    bool done = true;
+    for (auto& entry : m_variants) {
+      if (!poll(entry.second)) done = false;
+    }
+    return done;
+  }
+
+  std::shared_ptr<Program> ShaderProgram::get_program_ptr () const {
+    auto found_it = m_variants.find(m_default_key);
+    return found_it != m_variants.end() ? found_it->second.program : nullptr;
+  }
+
+  std::shared_ptr<Program> ShaderProgram::get_variant (VariantKey key, const std::vector<std::string>& defines) {
+    auto found_it = m_variants.find(key);
+    if (found_it == m_variants.end()) {
+      found_it = m_variants.emplace(key, Variant()).first;
+      found_it->second.defines = defines;
+      submit(found_it->second, m_sources);
+    }
+
+    auto& variant = found_it->second;
+    if (variant.pending) poll(variant);
+    return variant.program;
+  }
+
+  ShaderProgram::Sources ShaderProgram::load_sources (const fs::path& base_path,
+                                                      const std::string& vertex_file, const std::string& fragment_file) {
+    Sources sources;
+    ShaderPreprocessor preprocessor(base_path);
+
+    bool vertex_valid = preprocessor.process(vertex_file, sources.vertex_code);
+    sources.files = preprocessor.get_files();
+
+    bool fragment_valid = preprocessor.process(fragment_file, sources.fragment_code);
+    sources.files.insert(sources.files.end(), preprocessor.get_files().begin(), preprocessor.get_files().end());
+
+    sources.valid = vertex_valid && fragment_valid;
+    return sources;
+  }
+
+  void ShaderProgram::submit (Variant& variant, const Sources& sources) {
+    std::string preamble;
+    for (auto& define : m_defines) preamble += "#define " + define + "\n";
+    for (auto& define : variant.defines) preamble += "#define " + define + "\n";
+
+    auto vertex_code = sources.vertex_code;
+    auto fragment_code = sources.fragment_code;
+    Shader::insert_defines(vertex_code, preamble);
+    Shader::insert_defines(fragment_code, preamble);
+
+    auto& cache = ProgramBinaryCache::instance();
+    auto key = cache.make_key(vertex_code, fragment_code);
+
+    auto program = std::make_shared<Program>();
+    KVANT_GPU_TRACK(GpuCategory::PROGRAM, program->get_program_id(), 0, m_handle);
+    variant.pending_shader.reset();
+    variant.pending_cache_key = key;
+
+    if (cache.load(*program, key)) {
+      variant.pending.reset();
+      variant.program = program;
+      m_generation++;
+      return;
+    }
+
+    // Status checks wait for the driver, so they are left to poll
+    variant.pending_shader.reset(new Shader());
+    variant.pending_shader->submit_source(vertex_code, fragment_code);
+
+    program->attach_shaders(*variant.pending_shader);
+    if (cache.is_enabled()) program->set_binary_retrievable();
+    program->begin_link();
+    variant.pending = program;
+  }
+
+  bool ShaderProgram::poll (Variant& variant) {
+    if (!variant.pending) return true;
+
+    auto status = variant.pending->poll_link();
+    if (status == LinkStatus::PENDING) return false;
+
+    if (status == LinkStatus::LINKED) {
+      ProgramBinaryCache::instance().store(*variant.pending, variant.pending_cache_key);
+      variant.program = variant.pending;
+      m_generation++;
+    }
+    else {
+      // Compile errors explain most link failures
+      variant.pending_shader->check_status();
+      spdlog::get("log")->error("Building shader program {} failed{}", m_handle,
+                                variant.program ? ", keeping the previous program" : "");
+    }
+
+    variant.pending.reset();
+    variant.pending_shader.reset();
+    return true;
+  }
+}
@@ -0,0 +1,131 @@
+#include <KvantEngine/CoreTypes/Texture.hpp>
+
+// C++ Headers
+#include <algorithm>
+
+// Third party
+#include <spdlog/spdlog.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+
+namespace Kvant {
+
+  namespace fs = boost::filesystem;
+
+  Texture::Texture (const ResourceHandle handle, const fs::path& filepath) : Resource(handle, filepath) {
+    m_id = TextureLoader::instance().get_placeholder();
+    load_image(filepath);
+  }
+
+  Texture::~Texture () {
+    auto& memory = GpuMemory::instance();
+    if (m_owns_id) {
+      memory.untrack(GpuCategory::TEXTURE, m_id);
+      glDeleteTextures(1, &m_id);
+    }
+    if (m_upload_id) {
+      memory.untrack(GpuCategory::TEXTURE, m_upload_id);
+      glDeleteTextures(1, &m_upload_id);
+    }
+  }
+
+  void Texture::load_image (const fs::path& filepath) {
+    // A newer decode supersedes one still in flight
+    if (m_upload_id) {
+      GpuMemory::instance().untrack(GpuCategory::TEXTURE, m_upload_id);
+      glDeleteTextures(1, &m_upload_id);
+    }
+    m_upload_id = 0;
+    m_upload_progress = UploadProgress();
+
+    m_decode = TextureLoader::instance().decode(filepath);
+  }
+
+  void Texture::on_file_modified (const fs::path& filepath) {
+    load_image(filepath);
+  }
+
+  void Texture::on_file_deleted (const fs::path& base_path) {
+    load_image(base_path / fs::path("removed.png"));
+  }
+
+  bool Texture::finish_reload () {
+    if (m_decode) {
+      if (!m_decode->done) return false;
+
+      // A failed decode keeps the current image
+      if (m_decode->image.valid) {
+        m_image = std::move(m_decode);
+        start_upload(m_resident_level);
+      }
+      m_decode.reset();
+    }
+    if (!m_upload_id) return true;
+
+    auto& image = m_image->image;
+    if (!TextureLoader::instance().upload(m_upload_id, image, m_upload_progress, m_upload_level)) return false;
+
+    // Complete, swap it in
+    if (m_owns_id) {
+      GpuMemory::instance().untrack(GpuCategory::TEXTURE, m_id);
+      glDeleteTextures(1, &m_id);
+    }
+    m_id = m_upload_id;
+    m_owns_id = true;
+    m_internal_format = image.internal_format;
+    m_width = image.width;
+    m_height = image.height;
+
+    m_mip_levels = image.levels.size();
+    m_resident_level = m_upload_level;
+
+    m_upload_id = 0;
+    m_upload_progress = UploadProgress();
+    return true;
+  }
+
+  void Texture::set_resident_level (GLsizei level) {
+    if (!m_image || m_decode) return;
+
+    level = std::min<GLsizei>(std::max(level, 0), m_image->image.levels.size() - 1);
+    if (level == get_target_level()) return;
+
+    // Back to the resident level, drop the upload
+    if (level == m_resident_level && m_owns_id) {
+      GpuMemory::instance().untrack(GpuCategory::TEXTURE, m_upload_id);
+      glDeleteTextures(1, &m_upload_id);
+      m_upload_id = 0;
+      m_upload_progress = UploadProgress();
+      return;
+    }
+    start_upload(level);
+  }
+
+  void Texture::start_upload (GLsizei level) {
+    if (m_upload_id) {
+      GpuMemory::instance().untrack(GpuCategory::TEXTURE, m_upload_id);
+      glDeleteTextures(1, &m_upload_id);
+    }
+
+    auto& image = m_image->image;
+    m_upload_level = std::min<GLsizei>(level, image.levels.size() - 1);
+    m_upload_id = TextureLoader::instance().allocate(image, m_handle, m_upload_level);
+    m_upload_progress = UploadProgress();
+  }
+
+  std::size_t Texture::get_level_bytes (GLsizei level) const {
+    if (!m_image) return 0;
+
+    // Levels are stored back to back, largest first
+    auto& image = m_image->image;
+    level = std::min<GLsizei>(std::max(level, 0), image.levels.size() - 1);
+    return image.get_size() - image.levels[level].offset;
+  }
+
+  void Texture::bind (GLuint unit) {
+    assert (unit <= 31);
+    glActiveTexture (GL_TEXTURE0 + unit);
+    glBindTexture (GL_TEXTURE_2D, m_id);
+  }
+}
@@ -0,0 +1,165 @@
+#include <KvantEngine/CoreTypes/TextureArray.hpp>
+
+// C++ Headers
+#include <algorithm>
+
+// Third party
+#include <spdlog/spdlog.h>
+#include <yaml-cpp/yaml.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+
+namespace Kvant {
+
+  namespace fs = boost::filesystem;
+
+  TextureArray::TextureArray (const ResourceHandle handle, const fs::path& filepath) : Resource(handle, filepath) {
+    m_id = TextureLoader::instance().get_array_placeholder();
+    load();
+  }
+
+  TextureArray::~TextureArray () {
+    auto& memory = GpuMemory::instance();
+    if (m_owns_id) {
+      memory.untrack(GpuCategory::TEXTURE, m_id);
+      glDeleteTextures(1, &m_id);
+    }
+    if (m_upload_id) {
+      memory.untrack(GpuCategory::TEXTURE, m_upload_id);
+      glDeleteTextures(1, &m_upload_id);
+    }
+  }
+
+  GLint TextureArray::get_layer (const ResourceHandle& image) const {
+    auto found_it = m_layers.find(image);
+    return found_it != m_layers.end() ? found_it->second : -1;
+  }
+
+  bool TextureArray::depends_on (const std::string& file) const {
+    return file == m_handle || std::find(m_images.begin(), m_images.end(), file) != m_images.end();
+  }
+
+  void TextureArray::on_file_modified (const fs::path&) {
+    load();
+  }
+
+  bool TextureArray::load () {
+    YAML::Node root;
+    try {
+      root = YAML::LoadFile(m_filepath.string());
+    }
+    catch (const YAML::Exception& e) {
+      spdlog::get("log")->error("Failed to load texture array {}: {}", m_filepath.string(), e.what());
+      return false;
+    }
+
+    m_images.clear();
+    m_pending_layers.clear();
+    for (auto image : root["layers"]) {
+      auto file = image.as<std::string>();
+      if (m_pending_layers.count(file)) {
+        spdlog::get("log")->warn("Texture array {} lists {} twice, it keeps its first layer", m_handle, file);
+        continue;
+      }
+      m_pending_layers[file] = m_images.size();
+      m_images.push_back(file);
+    }
+
+    // A newer load supersedes one still uploading, the current layers stay until it is in
+    if (m_upload_id) {
+      GpuMemory::instance().untrack(GpuCategory::TEXTURE, m_upload_id);
+      glDeleteTextures(1, &m_upload_id);
+    }
+    m_upload_id = 0;
+    m_upload_layer = 0;
+    m_upload_progress = UploadProgress();
+
+    // Until the first upload the placeholder samples the same for every layer
+    if (!m_owns_id) {
+      m_layers = m_pending_layers;
+      m_revision++;
+    }
+
+    m_decodes.clear();
+    auto base_path = m_filepath.parent_path();
+    for (auto& image : m_images) m_decodes.push_back(TextureLoader::instance().decode(base_path / image));
+    return true;
+  }
+
+  const DecodedImage* TextureArray::match_layers () {
+    auto reference_it = std::find_if(m_decodes.begin(), m_decodes.end(), [] (const std::shared_ptr<DecodeJob>& decode) {
+      return decode->image.valid;
+    });
+    if (reference_it == m_decodes.end()) return nullptr;
+    auto& reference = (*reference_it)->image;
+
+    for (std::size_t i = 0; i < m_decodes.size(); i++) {
+      auto& image = m_decodes[i]->image;
+      if (image.valid && image.width == reference.width && image.height == reference.height &&
+          image.internal_format == reference.internal_format && image.levels.size() == reference.levels.size()) {
+        continue;
+      }
+
+      if (image.valid) {
+        spdlog::get("log")->error("Texture array {}: {} is {}x{} format 0x{:x} with {} levels, layers have to be {}x{} "
+                                  "format 0x{:x} with {}, it is left blank",
+                                  m_handle, m_images[i], image.width, image.height, image.internal_format,
+                                  image.levels.size(), reference.width, reference.height, reference.internal_format,
+                                  reference.levels.size());
+      }
+
+      // Blank layers keep the indices of the others stable
+      DecodedImage blank;
+      blank.width = reference.width;
+      blank.height = reference.height;
+      blank.internal_format = reference.internal_format;
+      blank.levels = reference.levels;
+      blank.pixels.assign(reference.get_size(), 0);
+      blank.valid = true;
+      image = std::move(blank);
+    }
+    return &reference;
+  }
+
+  bool TextureArray::finish_reload () {
+    if (m_decodes.empty()) return true;
+    for (auto& decode : m_decodes) {
+      if (!decode->done) return false;
+    }
+
+    auto& loader = TextureLoader::instance();
+    if (!m_upload_id) {
+      auto reference = match_layers();
+      if (!reference) {
+        spdlog::get("log")->error("Texture array {}: none of its images loaded", m_handle);
+        m_decodes.clear();
+        return true;
+      }
+      m_upload_id = loader.allocate_array(*reference, m_decodes.size(), m_handle);
+    }
+
+    // Layers are uploaded one after the other
+    for (; m_upload_layer < (GLsizei)m_decodes.size(); m_upload_layer++) {
+      if (!loader.upload_layer(m_upload_id, m_decodes[m_upload_layer]->image, m_upload_layer, m_upload_progress)) return false;
+      m_upload_progress = UploadProgress();
+    }
+
+    // Complete, swap it in along with the layer indices
+    if (m_owns_id) {
+      GpuMemory::instance().untrack(GpuCategory::TEXTURE, m_id);
+      glDeleteTextures(1, &m_id);
+    }
+    m_id = m_upload_id;
+    m_owns_id = true;
+    // Every layer matches the first after match_layers
+    m_internal_format = m_decodes[0]->image.internal_format;
+    m_layers = m_pending_layers;
+    m_revision++;
+
+    m_upload_id = 0;
+    m_upload_layer = 0;
+    m_decodes.clear();
+    return true;
+  }
+}
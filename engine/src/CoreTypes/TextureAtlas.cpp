@@ -0,0 +1,249 @@
+#include <KvantEngine/CoreTypes/TextureAtlas.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <cstring>
+
+// Third party
+#include <spdlog/spdlog.h>
+#include <yaml-cpp/yaml.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+#include <KvantEngine/CoreTypes/MaxRectsPacker.hpp>
+
+namespace Kvant {
+
+  namespace fs = boost::filesystem;
+
+  TextureAtlas::TextureAtlas (const ResourceHandle handle, const fs::path& filepath) : Resource(handle, filepath) {
+    if (load()) compose();
+  }
+
+  TextureAtlas::~TextureAtlas () {
+    auto& memory = GpuMemory::instance();
+    for (auto& page : m_pages) {
+      if (page.owns_id) {
+        memory.untrack(GpuCategory::TEXTURE, page.id);
+        glDeleteTextures(1, &page.id);
+      }
+      if (page.upload_id) {
+        memory.untrack(GpuCategory::TEXTURE, page.upload_id);
+        glDeleteTextures(1, &page.upload_id);
+      }
+    }
+  }
+
+  const AtlasRegion* TextureAtlas::get_region (const ResourceHandle& image) const {
+    auto found_it = m_regions.find(image);
+    return found_it != m_regions.end() ? &found_it->second : nullptr;
+  }
+
+  bool TextureAtlas::depends_on (const std::string& file) const {
+    return file == m_handle || std::find(m_images.begin(), m_images.end(), file) != m_images.end();
+  }
+
+  void TextureAtlas::on_file_modified (const fs::path&) {
+    auto previous = m_regions;
+    if (!load()) return;
+
+    // Meshes remap their UVs once, when they are built
+    if (previous != m_regions)
+      spdlog::get("log")->warn("Atlas {} was packed differently, meshes built before keep their old UVs", m_handle);
+    compose();
+  }
+
+  bool TextureAtlas::load () {
+    YAML::Node root;
+    try {
+      root = YAML::LoadFile(m_filepath.string());
+    }
+    catch (const YAML::Exception& e) {
+      spdlog::get("log")->error("Failed to load atlas {}: {}", m_filepath.string(), e.what());
+      return false;
+    }
+
+    m_page_size = root["page_size"] ? root["page_size"].as<GLsizei>() : 1024;
+    m_padding = root["padding"] ? root["padding"].as<GLsizei>() : 2;
+    m_images.clear();
+    for (auto image : root["images"]) m_images.push_back(image.as<std::string>());
+
+    std::unordered_map<ResourceHandle, AtlasRegion> regions;
+    std::vector<Page> pages;
+    if (!pack(regions, pages)) return false;
+
+    // The current pages stay visible until the new ones are uploaded
+    auto& memory = GpuMemory::instance();
+    for (std::size_t i = 0; i < m_pages.size(); i++) {
+      auto& page = m_pages[i];
+      if (page.upload_id) {
+        memory.untrack(GpuCategory::TEXTURE, page.upload_id);
+        glDeleteTextures(1, &page.upload_id);
+      }
+      if (i < pages.size()) {
+        pages[i].id = page.id;
+        pages[i].owns_id = page.owns_id;
+      }
+      else if (page.owns_id) {
+        memory.untrack(GpuCategory::TEXTURE, page.id);
+        glDeleteTextures(1, &page.id);
+      }
+    }
+    for (auto& page : pages) {
+      if (!page.id) page.id = TextureLoader::instance().get_placeholder();
+    }
+
+    m_regions = std::move(regions);
+    m_pages = std::move(pages);
+    m_revision++;
+    return true;
+  }
+
+  bool TextureAtlas::pack (std::unordered_map<ResourceHandle, AtlasRegion>& regions, std::vector<Page>& pages) const {
+    struct Entry {
+      ResourceHandle image;
+      GLsizei width, height;
+    };
+
+    std::vector<Entry> entries;
+    auto base_path = m_filepath.parent_path();
+    for (auto& image : m_images) {
+      Entry entry{image, 0, 0};
+      if (!read_image_size(base_path / image, entry.width, entry.height)) {
+        spdlog::get("log")->error("Atlas {} couldn't read image {}", m_handle, image);
+        continue;
+      }
+      if (entry.width + 2 * m_padding > m_page_size || entry.height + 2 * m_padding > m_page_size) {
+        spdlog::get("log")->error("Atlas {}: {} doesn't fit in a {}x{} page", m_handle, image, m_page_size, m_page_size);
+        continue;
+      }
+      entries.push_back(entry);
+    }
+
+    // Tall images first leaves fewer slivers
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+      return std::max(a.width, a.height) > std::max(b.width, b.height);
+    });
+
+    std::vector<MaxRectsPacker> packers;
+    for (auto& entry : entries) {
+      PackedRect rect;
+      std::size_t page = 0;
+      for (; page < packers.size(); page++) {
+        if (packers[page].insert(entry.width + 2 * m_padding, entry.height + 2 * m_padding, rect)) break;
+      }
+      if (page == packers.size()) {
+        packers.emplace_back(m_page_size, m_page_size);
+        packers.back().insert(entry.width + 2 * m_padding, entry.height + 2 * m_padding, rect);
+      }
+
+      AtlasRegion region;
+      region.page = page;
+      region.x = rect.x + m_padding;
+      region.y = rect.y + m_padding;
+      region.width = entry.width;
+      region.height = entry.height;
+      region.uv_offset = glm::vec2(region.x, region.y) / (float)m_page_size;
+      region.uv_scale = glm::vec2(region.width, region.height) / (float)m_page_size;
+      regions[entry.image] = region;
+    }
+
+    pages.resize(packers.size());
+    for (std::size_t i = 0; i < packers.size(); i++) {
+      pages[i].width = pages[i].height = m_page_size;
+      spdlog::get("log")->info("Atlas {} page {} is {:.0f}% full", m_handle, i, packers[i].get_occupancy() * 100.0f);
+    }
+    return true;
+  }
+
+  void TextureAtlas::compose () {
+    auto job = std::make_shared<ComposeJob>();
+    m_job = job;
+    if (m_pages.empty()) {
+      job->done = true;
+      return;
+    }
+
+    auto base_path = m_filepath.parent_path();
+    auto regions = m_regions;
+    auto page_count = m_pages.size();
+    auto page_size = m_page_size;
+    auto padding = m_padding;
+    auto handle = m_handle;
+
+    TextureLoader::instance().run([=] {
+      job->pages.resize(page_count);
+      for (auto& page : job->pages) {
+        page.width = page.height = page_size;
+        page.levels.push_back(DecodedImage::Level{page_size, page_size, 0});
+        page.pixels.assign(page_size * page_size * 4, 0);
+      }
+
+      for (auto& entry : regions) {
+        auto& region = entry.second;
+        DecodedImage image;
+        if (!decode_image((base_path / entry.first).string(), image)) continue;
+        if (image.width != region.width || image.height != region.height) {
+          spdlog::get("log")->warn("Atlas {}: {} changed size, it is left out until the atlas reloads",
+                                   handle, entry.first);
+          continue;
+        }
+
+        // Padding repeats the closest edge pixel
+        auto& page = job->pages[region.page];
+        for (GLsizei y = -padding; y < region.height + padding; y++) {
+          GLsizei source_y = std::min(std::max(y, 0), region.height - 1);
+          for (GLsizei x = -padding; x < region.width + padding; x++) {
+            GLsizei source_x = std::min(std::max(x, 0), region.width - 1);
+            std::memcpy(&page.pixels[((region.y + y) * page_size + region.x + x) * 4],
+                        &image.pixels[(source_y * region.width + source_x) * 4], 4);
+          }
+        }
+      }
+
+      // A level is only kept while its texels are no wider than the padding, smaller ones filter across it
+      std::size_t levels = 1;
+      for (GLsizei size = 2; size <= padding; size *= 2) levels++;
+
+      for (auto& page : job->pages) {
+        build_mip_chain(page);
+        if (page.levels.size() > levels) {
+          page.pixels.resize(page.levels[levels].offset);
+          page.levels.resize(levels);
+        }
+        page.valid = true;
+      }
+      job->done = true;
+    });
+  }
+
+  bool TextureAtlas::finish_reload () {
+    if (!m_job) return true;
+    if (!m_job->done) return false;
+
+    for (std::size_t i = 0; i < m_pages.size(); i++) {
+      auto& page = m_pages[i];
+      auto& image = m_job->pages[i];
+
+      if (!page.upload_id) page.upload_id = TextureLoader::instance().allocate(image, m_handle + " page " + std::to_string(i));
+
+      // Pages are uploaded one after the other
+      if (!TextureLoader::instance().upload(page.upload_id, image, page.progress)) return false;
+    }
+
+    // Every page is in, swap them all at once so regions never mix old and new pixels
+    for (auto& page : m_pages) {
+      if (page.owns_id) {
+        GpuMemory::instance().untrack(GpuCategory::TEXTURE, page.id);
+        glDeleteTextures(1, &page.id);
+      }
+      page.id = page.upload_id;
+      page.owns_id = true;
+      page.upload_id = 0;
+      page.progress = UploadProgress();
+    }
+    m_loaded = true;
+    m_job.reset();
+    return true;
+  }
+}
@@ -0,0 +1,153 @@
+#include <KvantEngine/CoreTypes/TextureCache.hpp>
+
+// C++ Headers
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+// Third party
+#include <spdlog/spdlog.h>
+
+// Kvant Headers
+#include <KvantEngine/util/Hash.hpp>
+
+namespace Kvant {
+
+  namespace fs = boost::filesystem;
+
+  namespace {
+    constexpr std::uint32_t CACHE_MAGIC = 0x5854564B; // "KVTX"
+    constexpr std::uint32_t CACHE_VERSION = 1;
+
+    // Levels start aligned, so the mapping can be read in wide words
+    constexpr std::size_t DATA_ALIGNMENT = 64;
+
+    struct CacheHeader {
+      std::uint32_t magic;
+      std::uint32_t version;
+      std::uint64_t key;
+      std::uint32_t internal_format;
+      std::uint32_t width, height;
+      std::uint32_t level_count;
+    };
+
+    struct CacheLevel {
+      std::uint32_t width, height;
+      std::uint64_t offset;
+    };
+
+    std::size_t get_data_offset (std::size_t level_count) {
+      std::size_t size = sizeof(CacheHeader) + level_count * sizeof(CacheLevel);
+      return (size + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+    }
+  }
+
+  TextureCache& TextureCache::instance () {
+    static TextureCache cache;
+    return cache;
+  }
+
+  void TextureCache::set_directory (const std::string& directory) {
+    m_enabled = false;
+    if (directory.empty()) return;
+
+    boost::system::error_code error;
+    fs::create_directories(directory, error);
+    if (!fs::is_directory(directory)) {
+      spdlog::get("log")->warn("Can't create texture cache directory {}", directory);
+      return;
+    }
+
+    m_directory = directory;
+    m_enabled = true;
+  }
+
+  std::uint64_t TextureCache::make_key (const fs::path& source) const {
+    boost::system::error_code error;
+    auto absolute = fs::canonical(source, error);
+    if (error) return 0;
+    auto size = fs::file_size(absolute, error);
+    if (error) return 0;
+    auto modified = fs::last_write_time(absolute, error);
+    if (error) return 0;
+
+    std::uint64_t stamp[2] = {(std::uint64_t)size, (std::uint64_t)modified};
+    return hash_bytes(stamp, sizeof(stamp), hash_bytes(absolute.string()));
+  }
+
+  fs::path TextureCache::get_entry_path (std::uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)key);
+    return m_directory / name;
+  }
+
+  bool TextureCache::load (std::uint64_t key, DecodedImage& image) const {
+    if (!m_enabled || !key) return false;
+
+    auto mapping = std::make_shared<MappedFile>();
+    if (!mapping->open(get_entry_path(key).string())) return false;
+    if (mapping->get_size() < sizeof(CacheHeader)) return false;
+
+    auto header = reinterpret_cast<const CacheHeader*>(mapping->get_data());
+    if (header->magic != CACHE_MAGIC || header->version != CACHE_VERSION || header->key != key) return false;
+
+    std::size_t data_offset = get_data_offset(header->level_count);
+    if (header->level_count == 0 || mapping->get_size() < data_offset) return false;
+
+    // Damaged or truncated entries just miss, the image is decoded again and overwrites them
+    auto block = get_block_format(header->internal_format);
+    std::size_t data_size = mapping->get_size() - data_offset;
+    auto levels = reinterpret_cast<const CacheLevel*>(header + 1);
+    std::vector<DecodedImage::Level> image_levels;
+    for (std::uint32_t i = 0; i < header->level_count; i++) {
+      std::size_t size = ((levels[i].width + block.width - 1) / block.width) *
+                         ((levels[i].height + block.height - 1) / block.height) * block.bytes;
+      if (levels[i].offset + size > data_size) return false;
+      image_levels.push_back(DecodedImage::Level{(GLsizei)levels[i].width, (GLsizei)levels[i].height, levels[i].offset});
+    }
+
+    // Pages are faulted in by the kernel meanwhile, not by the GL thread on upload
+    mapping->hint_will_need();
+
+    image.internal_format = header->internal_format;
+    image.width = header->width;
+    image.height = header->height;
+    image.levels = std::move(image_levels);
+    image.pixels.clear();
+    image.mapping = mapping;
+    image.mapping_offset = data_offset;
+    return true;
+  }
+
+  void TextureCache::store (std::uint64_t key, const DecodedImage& image) const {
+    if (!m_enabled || !key || image.levels.empty()) return;
+
+    CacheHeader header{CACHE_MAGIC, CACHE_VERSION, key, image.internal_format,
+                       (std::uint32_t)image.width, (std::uint32_t)image.height, (std::uint32_t)image.levels.size()};
+    std::vector<CacheLevel> levels;
+    for (auto& level : image.levels)
+      levels.push_back(CacheLevel{(std::uint32_t)level.width, (std::uint32_t)level.height, level.offset});
+    std::vector<char> padding(get_data_offset(levels.size()) - sizeof(header) - levels.size() * sizeof(CacheLevel), 0);
+
+    // Loader threads may store the same image at once, each writes its own file before renaming
+    static std::atomic<unsigned int> next_temp{0};
+    auto path = get_entry_path(key);
+    auto temp_path = fs::path(path.string() + "." + std::to_string(next_temp++) + ".tmp");
+    {
+      std::ofstream file(temp_path.string(), std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(CacheLevel));
+      file.write(padding.data(), padding.size());
+      file.write(reinterpret_cast<const char*>(image.get_data()), image.get_size());
+      if (!file) {
+        spdlog::get("log")->warn("Failed writing texture cache entry {}", temp_path.string());
+        return;
+      }
+    }
+
+    boost::system::error_code error;
+    fs::rename(temp_path, path, error);
+    if (error) fs::remove(temp_path, error);
+  }
+}
@@ -0,0 +1,492 @@
+#include <KvantEngine/CoreTypes/TextureLoader.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+// SDL2 Headers
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+// Third party
+#include <spdlog/spdlog.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+#include <KvantEngine/CoreTypes/TextureCache.hpp>
+#include <KvantEngine/util/PixelKernels.hpp>
+
+namespace Kvant {
+
+  namespace fs = boost::filesystem;
+
+  TextureLoader& TextureLoader::instance () {
+    static TextureLoader loader;
+    return loader;
+  }
+
+  BlockFormat get_block_format (GLenum internal_format, bool* compressed) {
+    if (compressed) *compressed = internal_format != GL_RGBA8;
+    switch (internal_format) {
+      case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+      case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        return BlockFormat{4, 4, 8};
+      case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+      case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+      case GL_COMPRESSED_RGBA_BPTC_UNORM:
+      case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        return BlockFormat{4, 4, 16};
+      default:
+        return BlockFormat{1, 1, 4};
+    }
+  }
+
+  bool read_image_size (const fs::path& file, GLsizei& width, GLsizei& height) {
+    // PNG keeps the size in the IHDR chunk right after the signature
+    unsigned char header[24];
+    std::ifstream stream(file.string(), std::ios::binary);
+    if (stream.read(reinterpret_cast<char*>(header), sizeof(header)) &&
+        std::memcmp(header, "\x89PNG\r\n\x1a\n", 8) == 0 && std::memcmp(header + 12, "IHDR", 4) == 0) {
+      // Big endian, promoted bytes would overflow int when shifted into the sign bit
+      auto read_uint32 = [&header] (int at) {
+        return (std::uint32_t)header[at] << 24 | (std::uint32_t)header[at + 1] << 16 |
+               (std::uint32_t)header[at + 2] << 8 | (std::uint32_t)header[at + 3];
+      };
+      width = read_uint32(16);
+      height = read_uint32(20);
+      return true;
+    }
+
+    // Anything else is decoded just for its size
+    SDL_Surface* surface = IMG_Load(file.string().c_str());
+    if (!surface) return false;
+    width = surface->w;
+    height = surface->h;
+    SDL_FreeSurface(surface);
+    return true;
+  }
+
+  bool decode_image (const std::string& file, DecodedImage& image) {
+    SDL_Surface* surface = IMG_Load(file.c_str());
+    if (!surface) {
+      spdlog::get("log")->error("Failed to load texture {} with error:\n {}", file, IMG_GetError());
+      return false;
+    }
+
+    if ( (surface->w & (surface->w-1)) != 0 ) {
+      spdlog::get("log")->warn("Warning: {}'s width is not a power of 2", file);
+    }
+    if ( (surface->h & (surface->h-1)) != 0 ) {
+      spdlog::get("log")->warn("Warning: {}'s height is not a power of 2", file);
+    }
+
+    // Everything is uploaded as RGBA8, common layouts convert straight into the image
+    Uint32 format = surface->format->format;
+    Uint32 color_key = 0;
+    bool keyed = SDL_GetColorKey(surface, &color_key) == 0;
+    bool direct = (format == SDL_PIXELFORMAT_INDEX8 && surface->format->palette) ||
+                  (!keyed && (format == SDL_PIXELFORMAT_RGBA32 || format == SDL_PIXELFORMAT_BGRA32 ||
+                              format == SDL_PIXELFORMAT_RGB24 || format == SDL_PIXELFORMAT_BGR24));
+    if (!direct) {
+      SDL_Surface* rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+      SDL_FreeSurface(surface);
+      if (!rgba) {
+        spdlog::get("log")->error("Failed to convert texture {} with error:\n {}", file, SDL_GetError());
+        return false;
+      }
+      surface = rgba;
+      format = SDL_PIXELFORMAT_RGBA32;
+    }
+
+    // Padded to 256 entries, so no index reads past it
+    std::uint32_t palette[256] = {};
+    if (format == SDL_PIXELFORMAT_INDEX8) {
+      const SDL_Palette* colors = surface->format->palette;
+      for (int i = 0; i < std::min(256, colors->ncolors); i++) {
+        const SDL_Color& color = colors->colors[i];
+        const std::uint8_t entry[4] = {color.r, color.g, color.b, keyed && color_key == Uint32(i) ? Uint8(0) : color.a};
+        std::memcpy(&palette[i], entry, 4);
+      }
+    }
+
+    image.width = surface->w;
+    image.height = surface->h;
+    image.levels.push_back(DecodedImage::Level{surface->w, surface->h, 0});
+    std::size_t row_size = surface->w * 4;
+    image.pixels.resize(row_size * surface->h);
+
+    SDL_LockSurface(surface);
+    for (int y = 0; y < surface->h; y++) {
+      auto src = static_cast<const std::uint8_t*>(surface->pixels) + y * surface->pitch;
+      auto dst = &image.pixels[y * row_size];
+      switch (format) {
+        case SDL_PIXELFORMAT_BGRA32: convert_bgra_to_rgba(src, dst, surface->w); break;
+        case SDL_PIXELFORMAT_RGB24: convert_rgb_to_rgba(src, dst, surface->w); break;
+        case SDL_PIXELFORMAT_BGR24: convert_bgr_to_rgba(src, dst, surface->w); break;
+        case SDL_PIXELFORMAT_INDEX8: expand_palette(src, palette, dst, surface->w); break;
+        default: std::memcpy(dst, src, row_size);
+      }
+    }
+    SDL_UnlockSurface(surface);
+    SDL_FreeSurface(surface);
+    return true;
+  }
+
+  namespace {
+    const unsigned char KTX_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    struct KtxHeader {
+      std::uint32_t endianness;
+      std::uint32_t gl_type, gl_type_size, gl_format;
+      std::uint32_t gl_internal_format, gl_base_internal_format;
+      std::uint32_t pixel_width, pixel_height, pixel_depth;
+      std::uint32_t array_elements, faces, mip_levels;
+      std::uint32_t key_value_bytes;
+    };
+
+    std::uint32_t swap_bytes (std::uint32_t value) {
+      return (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+    }
+
+    bool is_format_supported (GLenum internal_format) {
+      switch (internal_format) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+          return GLEW_EXT_texture_compression_s3tc;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+          return GLEW_ARB_texture_compression_bptc;
+        default:
+          return false;
+      }
+    }
+  }
+
+  bool decode_ktx (const std::string& file, DecodedImage& image, GLsizei max_size) {
+    std::ifstream stream(file, std::ios::binary);
+    unsigned char identifier[12];
+    KtxHeader header;
+    if (!stream.read(reinterpret_cast<char*>(identifier), sizeof(identifier)) ||
+        std::memcmp(identifier, KTX_IDENTIFIER, sizeof(identifier)) != 0 ||
+        !stream.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+      spdlog::get("log")->error("Failed to load texture {}: not a KTX file", file);
+      return false;
+    }
+
+    // Written on a machine of the other endianness, compressed blocks are byte streams and need no swapping
+    bool swap = header.endianness == 0x01020304;
+    if (swap) {
+      auto fields = reinterpret_cast<std::uint32_t*>(&header);
+      for (std::size_t i = 0; i < sizeof(header) / sizeof(std::uint32_t); i++) fields[i] = swap_bytes(fields[i]);
+    }
+
+    if (header.gl_type != 0 || header.pixel_depth > 1 || header.array_elements > 0 || header.faces != 1) {
+      spdlog::get("log")->error("Failed to load texture {}: only compressed 2D KTX files are supported", file);
+      return false;
+    }
+    if (!is_format_supported(header.gl_internal_format)) {
+      spdlog::get("log")->error("Failed to load texture {}: format 0x{:x} is not supported by the driver",
+                                file, header.gl_internal_format);
+      return false;
+    }
+
+    // Corrupt headers must not drive the allocations below into bad_alloc on a loader thread
+    std::uint32_t max_levels = 1;
+    for (GLsizei size = max_size; size > 1; size /= 2) max_levels++;
+    if (header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_width > (std::uint32_t)max_size ||
+        header.pixel_height > (std::uint32_t)max_size || header.mip_levels > max_levels) {
+      spdlog::get("log")->error("Failed to load texture {}: {}x{} with {} levels is out of range, at most {}x{} with {}",
+                                file, header.pixel_width, header.pixel_height, header.mip_levels, max_size, max_size, max_levels);
+      return false;
+    }
+
+    image.internal_format = header.gl_internal_format;
+    image.width = header.pixel_width;
+    image.height = header.pixel_height;
+    stream.seekg(header.key_value_bytes, std::ios::cur);
+
+    auto block = get_block_format(image.internal_format);
+    GLsizei width = image.width, height = image.height;
+    for (std::uint32_t i = 0; i < std::max<std::uint32_t>(header.mip_levels, 1); i++) {
+      std::uint32_t size;
+      if (!stream.read(reinterpret_cast<char*>(&size), sizeof(size))) break;
+      if (swap) size = swap_bytes(size);
+
+      std::size_t expected = ((width + block.width - 1) / block.width) * ((height + block.height - 1) / block.height) * block.bytes;
+      if (size != expected) {
+        spdlog::get("log")->error("Failed to load texture {}: level {} is {} bytes, expected {}", file, i, size, expected);
+        return false;
+      }
+
+      std::size_t offset = image.pixels.size();
+      image.pixels.resize(offset + size);
+      if (!stream.read(reinterpret_cast<char*>(&image.pixels[offset]), size)) {
+        spdlog::get("log")->error("Failed to load texture {}: level {} is truncated", file, i);
+        return false;
+      }
+      image.levels.push_back(DecodedImage::Level{width, height, offset});
+
+      // Block sizes are multiples of 4, so there is never mip padding
+      width = std::max(1, width / 2);
+      height = std::max(1, height / 2);
+    }
+
+    return !image.levels.empty();
+  }
+
+  void build_mip_chain (DecodedImage& image) {
+    if (image.levels.empty()) return;
+
+    // Reserve up front, the source level is read while the next one is written
+    std::size_t total = 0;
+    for (GLsizei w = image.width, h = image.height; ; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+      total += w * h * 4;
+      if (w == 1 && h == 1) break;
+    }
+    image.pixels.resize(total);
+
+    while (true) {
+      auto source = image.levels.back();
+      if (source.width == 1 && source.height == 1) break;
+
+      DecodedImage::Level level{std::max(1, source.width / 2), std::max(1, source.height / 2),
+                                source.offset + source.width * source.height * 4};
+      const unsigned char* src = &image.pixels[source.offset];
+      unsigned char* dst = &image.pixels[level.offset];
+
+      // Alpha weighted in linear space, so transparent texels don't darken the edges of sprites
+      downsample_srgb(src, source.width, source.height, dst, level.width, level.height);
+
+      image.levels.push_back(level);
+    }
+  }
+
+  std::shared_ptr<DecodeJob> TextureLoader::decode (const fs::path& file) {
+    auto job = std::make_shared<DecodeJob>();
+    auto path = file.string();
+
+    bool ktx = file.extension() == ".ktx";
+
+    if (!m_max_texture_size) glGetIntegerv(GL_MAX_TEXTURE_SIZE, &m_max_texture_size);
+    GLsizei max_size = m_max_texture_size;
+
+    m_jobs.submit([job, path, ktx, max_size] {
+      auto& cache = TextureCache::instance();
+      std::uint64_t key = !ktx && cache.is_enabled() ? cache.make_key(path) : 0;
+
+      if (ktx) {
+        job->image.valid = decode_ktx(path, job->image, max_size);
+      }
+      else if (cache.load(key, job->image)) {
+        job->image.valid = true;
+      }
+      else if (decode_image(path, job->image)) {
+        build_mip_chain(job->image);
+        job->image.valid = true;
+        cache.store(key, job->image);
+      }
+      job->done = true;
+    });
+    return job;
+  }
+
+  GLuint TextureLoader::allocate (const DecodedImage& image, const std::string& owner, std::size_t first_level) {
+    bool compressed;
+    auto block = get_block_format(image.internal_format, &compressed);
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // Only used where no sampler object is bound, RenderSystem binds one per unit
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // KTX files may hold fewer levels than the full chain
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels.size() - first_level - 1);
+    for (std::size_t i = 0; i < image.levels.size() - first_level; i++) {
+      auto& level = image.levels[first_level + i];
+      if (compressed) {
+        GLsizei size = ((level.width + block.width - 1) / block.width) * ((level.height + block.height - 1) / block.height) * block.bytes;
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, image.internal_format, level.width, level.height, 0, size, nullptr);
+      }
+      else {
+        glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    auto& base = image.levels[first_level];
+    KVANT_GPU_TRACK(GpuCategory::TEXTURE, texture,
+                    GpuMemory::get_texture_size(image.internal_format, base.width, base.height, image.levels.size() - first_level),
+                    owner);
+    return texture;
+  }
+
+  bool TextureLoader::upload (GLuint texture, const DecodedImage& image, UploadProgress& progress, std::size_t first_level) {
+    // Small levels are finished in the same call
+    while (first_level + progress.level < image.levels.size()) {
+      if (!upload_rows(texture, image, progress, first_level)) return false;
+    }
+    return true;
+  }
+
+  GLuint TextureLoader::allocate_array (const DecodedImage& image, GLsizei layers, const std::string& owner) {
+    bool compressed;
+    auto block = get_block_format(image.internal_format, &compressed);
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, image.levels.size() - 1);
+    for (std::size_t i = 0; i < image.levels.size(); i++) {
+      auto& level = image.levels[i];
+      if (compressed) {
+        GLsizei size = ((level.width + block.width - 1) / block.width) * ((level.height + block.height - 1) / block.height) * block.bytes;
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, image.internal_format, level.width, level.height, layers, 0,
+                               size * layers, nullptr);
+      }
+      else {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, i, GL_RGBA8, level.width, level.height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    KVANT_GPU_TRACK(GpuCategory::TEXTURE, texture,
+                    GpuMemory::get_texture_size(image.internal_format, image.width, image.height, image.levels.size(), layers),
+                    owner);
+    return texture;
+  }
+
+  bool TextureLoader::upload_layer (GLuint texture, const DecodedImage& image, GLsizei layer, UploadProgress& progress) {
+    while (progress.level < image.levels.size()) {
+      if (!upload_rows(texture, image, progress, 0, layer)) return false;
+    }
+    return true;
+  }
+
+  bool TextureLoader::upload_rows (GLuint texture, const DecodedImage& image, UploadProgress& progress,
+                                   std::size_t first_level, GLint layer) {
+    auto& level = image.levels[first_level + progress.level];
+    GLsizei& row = progress.row;
+
+    // Compressed levels go up in whole rows of blocks
+    bool compressed;
+    auto block = get_block_format(image.internal_format, &compressed);
+    GLsizei block_rows = (level.height + block.height - 1) / block.height;
+    std::size_t row_size = (level.width + block.width - 1) / block.width * block.bytes;
+    if (m_budget_left < row_size && m_uploaded) return false;
+
+    GLsizei rows = std::max<GLsizei>(1, m_budget_left / row_size);
+    rows = std::min(rows, block_rows - row);
+    std::size_t size = rows * row_size;
+    m_budget_left -= std::min(size, m_budget_left);
+    m_uploaded = true;
+
+    if (!m_pbos[0]) {
+      // Shared by every state
+      GpuMemory::Scope scope(nullptr);
+      glGenBuffers(m_pbos.size(), m_pbos.data());
+      for (auto pbo : m_pbos) KVANT_GPU_TRACK(GpuCategory::BUFFER, pbo, 0, "TextureLoader upload buffer");
+    }
+    GLuint pbo = m_pbos[m_next_pbo];
+    m_next_pbo = (m_next_pbo + 1) % m_pbos.size();
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    GpuMemory::instance().resize(GpuCategory::BUFFER, pbo, size);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped) {
+      std::memcpy(mapped, image.get_data() + level.offset + row * row_size, size);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+      GLsizei y = row * block.height;
+      GLsizei height = std::min(rows * block.height, level.height - y);
+      if (layer < 0) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (compressed)
+          glCompressedTexSubImage2D(GL_TEXTURE_2D, progress.level, 0, y, level.width, height, image.internal_format, size, 0);
+        else
+          glTexSubImage2D(GL_TEXTURE_2D, progress.level, 0, y, level.width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+      }
+      else {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        if (compressed)
+          glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, progress.level, 0, y, layer, level.width, height, 1,
+                                    image.internal_format, size, 0);
+        else
+          glTexSubImage3D(GL_TEXTURE_2D_ARRAY, progress.level, 0, y, layer, level.width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+      }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // A failed map is retried next frame
+    if (!mapped) return false;
+
+    row += rows;
+    if (row >= block_rows) {
+      progress.level++;
+      row = 0;
+    }
+    return true;
+  }
+
+  GLuint TextureLoader::get_placeholder () {
+    if (m_placeholder) return m_placeholder;
+
+    const unsigned char pixel[4] = {0, 0, 0, 0};
+    glGenTextures(1, &m_placeholder);
+    glBindTexture(GL_TEXTURE_2D, m_placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Samplers are bound over the filters above, with mipmapped ones a single level is only complete this way
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Created by the first texture, but shared by every state
+    GpuMemory::Scope scope(nullptr);
+    KVANT_GPU_TRACK(GpuCategory::TEXTURE, m_placeholder, 4, "Texture placeholder");
+    return m_placeholder;
+  }
+
+  GLuint TextureLoader::get_array_placeholder () {
+    if (m_array_placeholder) return m_array_placeholder;
+
+    const unsigned char pixel[4] = {0, 0, 0, 0};
+    glGenTextures(1, &m_array_placeholder);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_array_placeholder);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    GpuMemory::Scope scope(nullptr);
+    KVANT_GPU_TRACK(GpuCategory::TEXTURE, m_array_placeholder, 4, "Texture array placeholder");
+    return m_array_placeholder;
+  }
+
+  void TextureLoader::shutdown () {
+    // Jobs still queued are dropped, nothing waits for them anymore
+    m_jobs.stop();
+
+    if (m_pbos[0]) {
+      for (auto pbo : m_pbos) GpuMemory::instance().untrack(GpuCategory::BUFFER, pbo);
+      glDeleteBuffers(m_pbos.size(), m_pbos.data());
+      m_pbos.fill(0);
+    }
+    for (auto texture : {&m_placeholder, &m_array_placeholder}) {
+      if (!*texture) continue;
+      GpuMemory::instance().untrack(GpuCategory::TEXTURE, *texture);
+      glDeleteTextures(1, texture);
+      *texture = 0;
+    }
+  }
+}
@@ -0,0 +1,142 @@
+#include <KvantEngine/CoreTypes/UniformRingBuffer.hpp>
+
+// C++ Headers
+#include <cstring>
+#include <algorithm>
+
+// Third party
+#include <spdlog/spdlog.h>
+
+// Kvant Headers
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
+
+namespace Kvant {
+
+  UniformRingBuffer::UniformRingBuffer (GLsizeiptr region_size, unsigned int regions)
+      : m_region_size(region_size), m_region_count(regions), m_fences(regions, nullptr) {
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0) m_alignment = alignment;
+
+    m_persistent = GLEW_ARB_buffer_storage;
+    m_region_size = align(m_region_size);
+    create_buffer();
+  }
+
+  UniformRingBuffer::~UniformRingBuffer () {
+    delete_buffer();
+  }
+
+  void UniformRingBuffer::create_buffer () {
+    GLsizeiptr size = m_region_size * m_region_count;
+
+    glGenBuffers(1, &m_buffer_id);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer_id);
+
+    if (m_persistent) {
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+      m_mapped = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags));
+    }
+    else {
+      glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    KVANT_GPU_TRACK(GpuCategory::BUFFER, m_buffer_id, size, "Uniform ring buffer");
+  }
+
+  void UniformRingBuffer::delete_buffer () {
+    for (auto& fence : m_fences) {
+      if (fence) glDeleteSync(fence);
+      fence = nullptr;
+    }
+
+    if (m_mapped) {
+      glBindBuffer(GL_UNIFORM_BUFFER, m_buffer_id);
+      glUnmapBuffer(GL_UNIFORM_BUFFER);
+      glBindBuffer(GL_UNIFORM_BUFFER, 0);
+      m_mapped = nullptr;
+    }
+
+    GpuMemory::instance().untrack(GpuCategory::BUFFER, m_buffer_id);
+    glDeleteBuffers(1, &m_buffer_id);
+    m_buffer_id = 0;
+  }
+
+  void UniformRingBuffer::wait_for_region (unsigned int region) {
+    auto& fence = m_fences[region];
+    if (!fence) return;
+
+    // Only blocks if the GPU is more than region_count frames behind
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    while (result == GL_TIMEOUT_EXPIRED) {
+      result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+
+  void UniformRingBuffer::next_frame () {
+    if (m_fences[m_region]) glDeleteSync(m_fences[m_region]);
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_region = (m_region + 1) % m_region_count;
+    m_cursor = 0;
+    wait_for_region(m_region);
+  }
+
+  GLintptr UniformRingBuffer::upload (const void* data, GLsizeiptr size) {
+    if (m_cursor + size > m_region_size) {
+      // Orphan the whole ring for a larger one, draws in flight keep the old storage
+      spdlog::get("log")->warn("Uniform ring buffer region of {} bytes exhausted, growing", m_region_size);
+
+      m_region_size = align(std::max(2 * m_region_size, 2 * size));
+      if (m_mapped) {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer_id);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        m_mapped = nullptr;
+      }
+      for (auto& fence : m_fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+      }
+
+      if (m_persistent) {
+        // Storage is immutable, so the buffer object itself has to be replaced
+        GpuMemory::instance().untrack(GpuCategory::BUFFER, m_buffer_id);
+        glDeleteBuffers(1, &m_buffer_id);
+        create_buffer();
+      }
+      else {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer_id);
+        glBufferData(GL_UNIFORM_BUFFER, m_region_size * m_region_count, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        GpuMemory::instance().resize(GpuCategory::BUFFER, m_buffer_id, m_region_size * m_region_count);
+      }
+
+      m_region = 0;
+      m_cursor = 0;
+    }
+
+    GLintptr offset = m_region * m_region_size + m_cursor;
+    m_cursor += align(size);
+
+    if (m_mapped) {
+      std::memcpy(m_mapped + offset, data, size);
+    }
+    else {
+      glBindBuffer(GL_UNIFORM_BUFFER, m_buffer_id);
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+      void* ptr = glMapBufferRange(GL_UNIFORM_BUFFER, offset, size, flags);
+      if (ptr) {
+        std::memcpy(ptr, data, size);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+      }
+      glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    return offset;
+  }
+}
@@ -1,5 +1,8 @@
 #include <KvantEngine/States/State.hpp>
 
+// Third party
+#include <spdlog/spdlog.h>
+
 // Kvant Headers
 #include <KvantEngine/Core/Engine.hpp>
 #include <KvantEngine/CoreEvents/InputEvent.hpp>
@@ -8,16 +11,24 @@
 #include <KvantEngine/CoreSystems/NodeSystem.hpp>
 #include <KvantEngine/CoreSystems/RenderSystem.hpp>
 #include <KvantEngine/CoreSystems/InputSystem.hpp>
+#include <KvantEngine/CoreTypes/GpuMemory.hpp>
 
 namespace Kvant {
 
   State::State() {}
 
   void State::init (Engine* engine) {
+    // GL objects created from here on count against this state, same in every other entry point
+    GpuMemory::Scope scope(this);
     m_engine = engine;
 
     auto resources = m_engine->get_game_config().get<ResourcesConfig>();
     m_texture_resources.set_base_path(resources->textures_path);
+    m_shader_resources.set_base_path(resources->shaders_path);
+    m_material_resources.set_base_path(resources->materials_path);
+    m_atlas_resources.set_base_path(resources->textures_path);
+    m_array_resources.set_base_path(resources->textures_path);
+    m_texture_streamer.set_budget(resources->texture_budget);
 
     // Setup core systems
     get_system_manager().add<NodeSystem> (m_engine);
@@ -46,46 +57,221 @@ namespace Kvant {
     on_init();
   }
 
+  ResourceHandle State::add_material (const std::string& file) {
+    auto handle = m_material_resources.add(file);
+    m_material_resources.get(handle)->bind(m_shader_resources, [this] (const ResourceHandle& texture) {
+      return get_texture_id(add_texture(texture));
+    });
+    return handle;
+  }
+
+  ResourceHandle State::add_texture (const std::string& file) {
+    auto& entry = get_texture_entry(file);
+    if (entry.source == TextureEntry::ATLAS || entry.source == TextureEntry::ARRAY) return file;
+
+    auto handle = m_texture_resources.add(file);
+    m_texture_streamer.track(m_texture_resources.get(handle));
+    entry.source = TextureEntry::TEXTURE;
+    entry.resource = m_texture_resources.get_id(handle);
+    return handle;
+  }
+
+  ResourceHandle State::add_atlas (const std::string& file) {
+    auto handle = m_atlas_resources.add(file);
+    auto atlas = m_atlas_resources.get(handle);
+    for (auto& image : atlas->get_images()) {
+      // Images that didn't fit or couldn't be read are left to add_texture to load on their own
+      auto region = atlas->get_region(image);
+      if (!region) continue;
+
+      auto& entry = get_texture_entry(image);
+      if (entry.source != TextureEntry::NONE)
+        spdlog::get("log")->warn("{} was loaded before atlas {}, it stays loaded twice", image, handle);
+
+      entry.source = TextureEntry::ATLAS;
+      entry.resource = m_atlas_resources.get_id(handle);
+      entry.index = region->page;
+      entry.revision = atlas->get_revision();
+    }
+    return handle;
+  }
+
+  ResourceHandle State::add_texture_array (const std::string& file) {
+    auto handle = m_array_resources.add(file);
+    auto array = m_array_resources.get(handle);
+    for (auto& image : array->get_images()) {
+      auto& entry = get_texture_entry(image);
+      if (entry.source != TextureEntry::NONE)
+        spdlog::get("log")->warn("{} was loaded before texture array {}, it stays loaded twice", image, handle);
+
+      entry.source = TextureEntry::ARRAY;
+      entry.resource = m_array_resources.get_id(handle);
+      entry.index = array->get_layer(image);
+      entry.revision = array->get_revision();
+    }
+    return handle;
+  }
+
+  State::TextureEntry& State::get_texture_entry (const ResourceHandle& image) {
+    auto found_it = m_texture_ids.find(image);
+    if (found_it != m_texture_ids.end()) return m_texture_table[found_it->second];
+
+    m_texture_ids[image] = m_texture_table.size();
+    m_texture_table.emplace_back();
+    m_texture_table.back().image = image;
+    return m_texture_table.back();
+  }
+
+  void State::update_texture_entries () {
+    for (auto& entry : m_texture_table) {
+      if (entry.source == TextureEntry::ATLAS) {
+        auto atlas = m_atlas_resources.get(entry.resource);
+        if (!atlas || atlas->get_revision() == entry.revision) continue;
+        auto region = atlas->get_region(entry.image);
+        if (!region) {
+          // Dropped from the reloaded atlas, drawn from its own texture from now on
+          entry.source = TextureEntry::NONE;
+          add_texture(entry.image);
+          continue;
+        }
+        entry.index = region->page;
+        entry.revision = atlas->get_revision();
+      }
+      else if (entry.source == TextureEntry::ARRAY) {
+        auto array = m_array_resources.get(entry.resource);
+        if (!array || array->get_revision() == entry.revision) continue;
+        entry.index = array->get_layer(entry.image);
+        entry.revision = array->get_revision();
+      }
+    }
+  }
+
+  TextureId State::get_texture_id (const ResourceHandle& image) const {
+    auto found_it = m_texture_ids.find(image);
+    return found_it != m_texture_ids.end() ? found_it->second : INVALID_TEXTURE;
+  }
+
+  const AtlasRegion* State::get_atlas_region (const ResourceHandle& image) {
+    auto id = get_texture_id(image);
+    if (id == INVALID_TEXTURE || m_texture_table[id].source != TextureEntry::ATLAS) return nullptr;
+
+    auto atlas = m_atlas_resources.get(m_texture_table[id].resource);
+    return atlas ? atlas->get_region(image) : nullptr;
+  }
+
+  bool State::find_texture (TextureId image, TextureBinding& binding) const {
+    if (image >= m_texture_table.size()) return false;
+    auto& entry = m_texture_table[image];
+
+    switch (entry.source) {
+      case TextureEntry::TEXTURE: {
+        auto texture = m_texture_resources.get(entry.resource);
+        if (!texture) return false;
+        binding = TextureBinding{texture->m_id, GL_TEXTURE_2D, texture->is_loaded() ? texture->m_internal_format : 0u, 0, texture};
+        return true;
+      }
+      case TextureEntry::ATLAS: {
+        auto atlas = m_atlas_resources.get(entry.resource);
+        if (!atlas || entry.index < 0 || (std::size_t)entry.index >= atlas->get_page_count()) return false;
+        binding = TextureBinding{atlas->get_page_texture(entry.index), GL_TEXTURE_2D, atlas->is_loaded() ? GL_RGBA8 : 0u, 0, nullptr};
+        return true;
+      }
+      case TextureEntry::ARRAY: {
+        // Dropped from the array file, drawn from nowhere until it is added again
+        auto array = m_array_resources.get(entry.resource);
+        if (!array || entry.index < 0) return false;
+        binding = TextureBinding{array->get_texture(), GL_TEXTURE_2D_ARRAY, array->get_internal_format(), entry.index, nullptr};
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  void State::record_pipelines (const std::string& name) {
+    auto resources = m_engine->get_game_config().get<ResourcesConfig>();
+    if (resources->shader_cache_path.empty()) return;
+
+    m_pipeline_warmup.set_record_file(fs::path(resources->shader_cache_path) / (name + ".pipelines.yaml"));
+  }
+
   void State::cleanup () {
+    GpuMemory::Scope scope(this);
+    m_pipeline_warmup.save();
     on_cleanup();
   }
 
   void State::pause () {
+    GpuMemory::Scope scope(this);
     on_pause();
   }
 
   void State::resume () {
+    GpuMemory::Scope scope(this);
     on_resume();
   }
 
   void State::handle_events (SDL_Event& event) {
+    GpuMemory::Scope scope(this);
     get_event_manager().emit<InputEvent>(event);
     on_handle_events(event);
   }
 
   void State::update (const float dt) {
+    GpuMemory::Scope scope(this);
     get_system_manager().update<NodeSystem>(dt);
     get_system_manager().update<InputSystem>(dt);
 
     m_texture_resources.update();
+    m_shader_resources.update();
+    m_material_resources.update();
+    m_atlas_resources.update();
+    m_array_resources.update();
+    update_texture_entries();
+    m_texture_streamer.update();
 
     on_update(dt);
   }
 
   void State::draw (const float dt) {
+    GpuMemory::Scope scope(this);
+    auto render_system = get_system_manager().system<RenderSystem>();
+    render_system->begin_frame();
+
+    m_pipeline_warmup.step(m_material_resources);
+
+    m_render_graph.reset();
+
     // Render game
-    get_system_manager().system<RenderSystem>()->set_camera( m_game_camera );
-    for (unsigned int l{0u}; l < GameLayer::ORTHO; l++) {
-      get_system_manager().system<RenderSystem>()->set_render_root( m_layers[l] );
-      get_system_manager().update<RenderSystem>(dt);
-    }
+    m_render_graph.add_pass("Game",
+      [] (RenderGraph::PassBuilder& builder) {
+        builder.write(RenderGraph::BACKBUFFER);
+      },
+      [this, render_system, dt] (const RenderGraph::PassResources&) {
+        render_system->set_camera( m_game_camera );
+        for (unsigned int l{0u}; l < GameLayer::ORTHO; l++) {
+          render_system->set_render_root( m_layers[l] );
+          get_system_manager().update<RenderSystem>(dt);
+        }
+      });
 
     // Render GUI
-    get_system_manager().system<RenderSystem>()->set_camera( m_GUI_camera );
-    for (unsigned int l{GameLayer::ORTHO}; l < GameLayer::TOTAL; l++) {
-      get_system_manager().system<RenderSystem>()->set_render_root( m_layers[l] );
-      get_system_manager().update<RenderSystem>(dt);
-    }
+    m_render_graph.add_pass("GUI",
+      [] (RenderGraph::PassBuilder& builder) {
+        builder.write(RenderGraph::BACKBUFFER);
+      },
+      [this, render_system, dt] (const RenderGraph::PassResources&) {
+        render_system->set_camera( m_GUI_camera );
+        for (unsigned int l{GameLayer::ORTHO}; l < GameLayer::TOTAL; l++) {
+          render_system->set_render_root( m_layers[l] );
+          get_system_manager().update<RenderSystem>(dt);
+        }
+      });
+
+    on_setup_render_graph(m_render_graph);
+
+    m_render_graph.compile();
+    m_render_graph.execute();
 
     on_draw(dt);
   }
@@ -0,0 +1,57 @@
+#include <KvantEngine/util/JobQueue.hpp>
+
+namespace Kvant {
+
+  JobQueue::JobQueue (std::size_t threads) {
+    for (std::size_t i = 0; i < threads; i++) {
+      m_threads.emplace_back(&JobQueue::worker_loop, this);
+    }
+  }
+
+  JobQueue::~JobQueue () {
+    stop();
+  }
+
+  void JobQueue::stop () {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+      m_jobs.clear();
+    }
+    m_cv.notify_all();
+
+    for (auto& thread : m_threads) {
+      thread.join();
+    }
+    m_threads.clear();
+  }
+
+  void JobQueue::submit (Job job) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_jobs.push_back(std::move(job));
+    }
+    m_cv.notify_one();
+  }
+
+  std::size_t JobQueue::get_pending_count () {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_jobs.size();
+  }
+
+  void JobQueue::worker_loop () {
+    while (true) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_quit || !m_jobs.empty(); });
+        if (m_quit) return;
+
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+      }
+
+      job();
+    }
+  }
+}
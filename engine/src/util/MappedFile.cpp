@@ -0,0 +1,46 @@
+#include <KvantEngine/util/MappedFile.hpp>
+
+// POSIX Headers
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Kvant {
+
+  MappedFile::~MappedFile () {
+    close();
+  }
+
+  bool MappedFile::open (const std::string& file) {
+    close();
+
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+      ::close(fd);
+      return false;
+    }
+
+    // The mapping keeps the file alive, the descriptor isn't needed anymore
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+
+    m_data = static_cast<const unsigned char*>(data);
+    m_size = info.st_size;
+    return true;
+  }
+
+  void MappedFile::close () {
+    if (m_data) munmap(const_cast<unsigned char*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+  }
+
+  void MappedFile::hint_will_need () const {
+    if (m_data) madvise(const_cast<unsigned char*>(m_data), m_size, MADV_WILLNEED);
+  }
+}
@@ -0,0 +1,355 @@
+#include <KvantEngine/util/PixelKernels.hpp>
+
+// C++ Headers
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KVANT_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// The vector kernels are compiled for their instruction set only, callers check get_simd_level first
+#define KVANT_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define KVANT_TARGET_AVX2 __attribute__((target("avx2")))
+
+namespace Kvant {
+
+  namespace {
+
+    SimdLevel detect_simd_level () {
+#ifdef KVANT_X86_KERNELS
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+      if (__builtin_cpu_supports("ssse3")) return SimdLevel::SSSE3;
+#endif
+      return SimdLevel::SCALAR;
+    }
+
+    std::atomic<int>& simd_level () {
+      static std::atomic<int> level{static_cast<int>(detect_simd_level())};
+      return level;
+    }
+
+    bool use (SimdLevel level) {
+      return simd_level().load(std::memory_order_relaxed) >= static_cast<int>(level);
+    }
+
+    // Keeps colors of fully transparent blocks from dividing by zero, too small to matter otherwise
+    constexpr float ALPHA_WEIGHT_BIAS = 0.01f;
+
+    struct SrgbTables {
+      float to_linear[256];
+      // Indexed by linear * 4095, int so AVX2 can gather it
+      std::int32_t to_srgb[4096];
+
+      SrgbTables () {
+        for (int i = 0; i < 256; i++) {
+          float c = i / 255.0f;
+          to_linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < 4096; i++) {
+          float l = i / 4095.0f;
+          float s = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+          to_srgb[i] = std::min(255, std::max(0, (int)std::lround(s * 255.0f)));
+        }
+      }
+    };
+
+    const SrgbTables& srgb_tables () {
+      static SrgbTables tables;
+      return tables;
+    }
+
+    // Scalar kernels, also finish what the vector ones leave over
+
+    void convert_rgb24_scalar (const std::uint8_t* src, std::uint8_t* dst, std::size_t count, bool swap) {
+      for (std::size_t i = 0; i < count; i++, src += 3, dst += 4) {
+        dst[0] = src[swap ? 2 : 0];
+        dst[1] = src[1];
+        dst[2] = src[swap ? 0 : 2];
+        dst[3] = 255;
+      }
+    }
+
+    void convert_bgra_scalar (const std::uint8_t* src, std::uint8_t* dst, std::size_t count) {
+      for (std::size_t i = 0; i < count; i++, src += 4, dst += 4) {
+        std::uint8_t b = src[0];
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = b;
+        dst[3] = src[3];
+      }
+    }
+
+    void expand_palette_scalar (const std::uint8_t* indices, const std::uint32_t* palette, std::uint8_t* dst, std::size_t count) {
+      for (std::size_t i = 0; i < count; i++) std::memcpy(dst + i * 4, &palette[indices[i]], 4);
+    }
+
+    void premultiply_scalar (std::uint8_t* pixels, std::size_t count) {
+      for (std::size_t i = 0; i < count; i++, pixels += 4) {
+        unsigned int a = pixels[3];
+        for (int c = 0; c < 3; c++) {
+          unsigned int x = pixels[c] * a + 128;
+          pixels[c] = (x + (x >> 8)) >> 8;
+        }
+      }
+    }
+
+    // Sums in the same order as the AVX2 kernel, so both produce the same bytes
+    void downsample_pixel_scalar (const std::uint8_t* r0, const std::uint8_t* r1, int x0, int x1, std::uint8_t* dst) {
+      auto& tables = srgb_tables();
+      const std::uint8_t* p00 = r0 + x0 * 4;
+      const std::uint8_t* p01 = r0 + x1 * 4;
+      const std::uint8_t* p10 = r1 + x0 * 4;
+      const std::uint8_t* p11 = r1 + x1 * 4;
+
+      float w00 = p00[3] + ALPHA_WEIGHT_BIAS, w01 = p01[3] + ALPHA_WEIGHT_BIAS;
+      float w10 = p10[3] + ALPHA_WEIGHT_BIAS, w11 = p11[3] + ALPHA_WEIGHT_BIAS;
+      float weight = (w00 + w10) + (w01 + w11);
+
+      for (int c = 0; c < 3; c++) {
+        float sum = (tables.to_linear[p00[c]] * w00 + tables.to_linear[p10[c]] * w10) +
+                    (tables.to_linear[p01[c]] * w01 + tables.to_linear[p11[c]] * w11);
+        float value = sum / weight;
+        int index = (int)(value * 4095.0f + 0.5f);
+        dst[c] = tables.to_srgb[std::min(4095, std::max(0, index))];
+      }
+      dst[3] = ((p00[3] + p10[3]) + (p01[3] + p11[3]) + 2) >> 2;
+    }
+
+#ifdef KVANT_X86_KERNELS
+
+    KVANT_TARGET_SSSE3
+    std::size_t convert_rgb24_ssse3 (const std::uint8_t* src, std::uint8_t* dst, std::size_t count, bool swap) {
+      const __m128i shuffle = swap ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+                                   : _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+      const __m128i alpha = _mm_set1_epi32(0xFF000000);
+
+      // 4 pixels per step, the 16 byte load reads 4 bytes past them
+      std::size_t i = 0;
+      for (; i + 6 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+      }
+      return i;
+    }
+
+    KVANT_TARGET_AVX2
+    std::size_t convert_rgb24_avx2 (const std::uint8_t* src, std::uint8_t* dst, std::size_t count, bool swap) {
+      const __m256i shuffle = swap ? _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+                                                      2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+                                   : _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+      const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+
+      // 8 pixels per step, each lane gets 4 of them
+      std::size_t i = 0;
+      for (; i + 10 <= count; i += 8) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 12));
+        __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+      }
+      return i;
+    }
+
+    KVANT_TARGET_SSSE3
+    std::size_t convert_bgra_ssse3 (const std::uint8_t* src, std::uint8_t* dst, std::size_t count) {
+      const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+      std::size_t i = 0;
+      for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_shuffle_epi8(pixels, shuffle));
+      }
+      return i;
+    }
+
+    KVANT_TARGET_AVX2
+    std::size_t convert_bgra_avx2 (const std::uint8_t* src, std::uint8_t* dst, std::size_t count) {
+      const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                               2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+      std::size_t i = 0;
+      for (; i + 8 <= count; i += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_shuffle_epi8(pixels, shuffle));
+      }
+      return i;
+    }
+
+    KVANT_TARGET_AVX2
+    std::size_t expand_palette_avx2 (const std::uint8_t* indices, const std::uint32_t* palette, std::uint8_t* dst, std::size_t count) {
+      auto table = reinterpret_cast<const int*>(palette);
+      std::size_t i = 0;
+      for (; i + 8 <= count; i += 8) {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(indices + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_i32gather_epi32(table, index, 4));
+      }
+      return i;
+    }
+
+    // Multiplies 16 bit channels by the alpha broadcast into their pixel, rounding like premultiply_scalar
+    std::size_t premultiply_sse2 (std::uint8_t* pixels, std::size_t count) {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i bias = _mm_set1_epi16(128);
+      const __m128i alpha_mask = _mm_set1_epi32(0xFF000000);
+
+      std::size_t i = 0;
+      for (; i + 4 <= count; i += 4) {
+        auto address = reinterpret_cast<__m128i*>(pixels + i * 4);
+        __m128i source = _mm_loadu_si128(address);
+        __m128i halves[2] = {_mm_unpacklo_epi8(source, zero), _mm_unpackhi_epi8(source, zero)};
+        for (auto& half : halves) {
+          __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(half, 0xFF), 0xFF);
+          __m128i x = _mm_add_epi16(_mm_mullo_epi16(half, alpha), bias);
+          half = _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+        }
+        __m128i result = _mm_packus_epi16(halves[0], halves[1]);
+        _mm_storeu_si128(address, _mm_or_si128(_mm_andnot_si128(alpha_mask, result), _mm_and_si128(alpha_mask, source)));
+      }
+      return i;
+    }
+
+    KVANT_TARGET_AVX2
+    std::size_t premultiply_avx2 (std::uint8_t* pixels, std::size_t count) {
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i bias = _mm256_set1_epi16(128);
+      const __m256i alpha_mask = _mm256_set1_epi32(0xFF000000);
+
+      std::size_t i = 0;
+      for (; i + 8 <= count; i += 8) {
+        auto address = reinterpret_cast<__m256i*>(pixels + i * 4);
+        __m256i source = _mm256_loadu_si256(address);
+        // Unpacking and packing both work per 128 bit lane, so pixels stay in order
+        __m256i halves[2] = {_mm256_unpacklo_epi8(source, zero), _mm256_unpackhi_epi8(source, zero)};
+        for (auto& half : halves) {
+          __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(half, 0xFF), 0xFF);
+          __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(half, alpha), bias);
+          half = _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+        }
+        __m256i result = _mm256_packus_epi16(halves[0], halves[1]);
+        _mm256_storeu_si256(address, _mm256_blendv_epi8(result, source, alpha_mask));
+      }
+      return i;
+    }
+
+    // Two destination pixels per step, as two pixels of four channels in the eight lanes
+    KVANT_TARGET_AVX2
+    int downsample_row_avx2 (const std::uint8_t* r0, const std::uint8_t* r1, int src_width, std::uint8_t* dst, int width) {
+      auto& tables = srgb_tables();
+      const __m256i broadcast_alpha = _mm256_setr_epi32(3, 3, 3, 3, 7, 7, 7, 7);
+      const __m256 bias = _mm256_set1_ps(ALPHA_WEIGHT_BIAS);
+      const __m256i pack = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+      int x = 0;
+      for (; x + 2 <= width && 2 * x + 4 <= src_width; x += 2) {
+        const std::uint8_t* sources[4] = {r0 + 2 * x * 4, r0 + (2 * x + 2) * 4, r1 + 2 * x * 4, r1 + (2 * x + 2) * 4};
+        __m256i values[4];
+        __m256 weighted[4];
+        for (int i = 0; i < 4; i++) {
+          values[i] = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sources[i])));
+          __m256 linear = _mm256_i32gather_ps(tables.to_linear, values[i], 4);
+          __m256 weight = _mm256_add_ps(_mm256_permutevar8x32_ps(_mm256_cvtepi32_ps(values[i]), broadcast_alpha), bias);
+          // The alpha lane carries the weight itself, so its sum is the divisor
+          weighted[i] = _mm256_blend_ps(_mm256_mul_ps(linear, weight), weight, 0x88);
+        }
+
+        // Rows first, then the two columns of each block
+        __m256 left = _mm256_add_ps(weighted[0], weighted[2]);
+        __m256 right = _mm256_add_ps(weighted[1], weighted[3]);
+        __m256 sum = _mm256_add_ps(_mm256_permute2f128_ps(left, right, 0x20), _mm256_permute2f128_ps(left, right, 0x31));
+        __m256 value = _mm256_div_ps(sum, _mm256_permutevar8x32_ps(sum, broadcast_alpha));
+        __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(4095.0f)), _mm256_set1_ps(0.5f)));
+        index = _mm256_min_epi32(_mm256_max_epi32(index, _mm256_setzero_si256()), _mm256_set1_epi32(4095));
+        __m256i color = _mm256_i32gather_epi32(tables.to_srgb, index, 4);
+
+        __m256i left_alpha = _mm256_add_epi32(values[0], values[2]);
+        __m256i right_alpha = _mm256_add_epi32(values[1], values[3]);
+        __m256i alpha = _mm256_add_epi32(_mm256_permute2x128_si256(left_alpha, right_alpha, 0x20),
+                                         _mm256_permute2x128_si256(left_alpha, right_alpha, 0x31));
+        alpha = _mm256_srli_epi32(_mm256_add_epi32(alpha, _mm256_set1_epi32(2)), 2);
+
+        __m256i result = _mm256_shuffle_epi8(_mm256_blend_epi32(color, alpha, 0x88), pack);
+        std::uint32_t first = _mm256_extract_epi32(result, 0), second = _mm256_extract_epi32(result, 4);
+        std::memcpy(dst + x * 4, &first, 4);
+        std::memcpy(dst + x * 4 + 4, &second, 4);
+      }
+      return x;
+    }
+
+#endif
+  }
+
+  SimdLevel get_simd_level () {
+    return static_cast<SimdLevel>(simd_level().load());
+  }
+
+  void set_simd_level (SimdLevel level) {
+    simd_level() = static_cast<int>(std::min(level, detect_simd_level()));
+  }
+
+  void convert_rgb_to_rgba (const std::uint8_t* src, std::uint8_t* dst, std::size_t count) {
+    std::size_t done = 0;
+#ifdef KVANT_X86_KERNELS
+    if (use(SimdLevel::AVX2)) done = convert_rgb24_avx2(src, dst, count, false);
+    else if (use(SimdLevel::SSSE3)) done = convert_rgb24_ssse3(src, dst, count, false);
+#endif
+    convert_rgb24_scalar(src + done * 3, dst + done * 4, count - done, false);
+  }
+
+  void convert_bgr_to_rgba (const std::uint8_t* src, std::uint8_t* dst, std::size_t count) {
+    std::size_t done = 0;
+#ifdef KVANT_X86_KERNELS
+    if (use(SimdLevel::AVX2)) done = convert_rgb24_avx2(src, dst, count, true);
+    else if (use(SimdLevel::SSSE3)) done = convert_rgb24_ssse3(src, dst, count, true);
+#endif
+    convert_rgb24_scalar(src + done * 3, dst + done * 4, count - done, true);
+  }
+
+  void convert_bgra_to_rgba (const std::uint8_t* src, std::uint8_t* dst, std::size_t count) {
+    std::size_t done = 0;
+#ifdef KVANT_X86_KERNELS
+    if (use(SimdLevel::AVX2)) done = convert_bgra_avx2(src, dst, count);
+    else if (use(SimdLevel::SSSE3)) done = convert_bgra_ssse3(src, dst, count);
+#endif
+    convert_bgra_scalar(src + done * 4, dst + done * 4, count - done);
+  }
+
+  void expand_palette (const std::uint8_t* indices, const std::uint32_t* palette, std::uint8_t* dst, std::size_t count) {
+    // Without a gather instruction a table lookup per pixel is as fast as it gets
+    std::size_t done = 0;
+#ifdef KVANT_X86_KERNELS
+    if (use(SimdLevel::AVX2)) done = expand_palette_avx2(indices, palette, dst, count);
+#endif
+    expand_palette_scalar(indices + done, palette, dst + done * 4, count - done);
+  }
+
+  void premultiply_alpha (std::uint8_t* pixels, std::size_t count) {
+    std::size_t done = 0;
+#ifdef KVANT_X86_KERNELS
+    if (use(SimdLevel::AVX2)) done = premultiply_avx2(pixels, count);
+    else if (use(SimdLevel::SSSE3)) done = premultiply_sse2(pixels, count);
+#endif
+    premultiply_scalar(pixels + done * 4, count - done);
+  }
+
+  void downsample_srgb (const std::uint8_t* src, int src_width, int src_height, std::uint8_t* dst, int width, int height) {
+    for (int y = 0; y < height; y++) {
+      // A clamped row is read twice, which averages the same
+      const std::uint8_t* r0 = src + std::min(2 * y, src_height - 1) * src_width * 4;
+      const std::uint8_t* r1 = src + std::min(2 * y + 1, src_height - 1) * src_width * 4;
+      std::uint8_t* row = dst + y * width * 4;
+
+      int x = 0;
+#ifdef KVANT_X86_KERNELS
+      if (use(SimdLevel::AVX2)) x = downsample_row_avx2(r0, r1, src_width, row, width);
+#endif
+      for (; x < width; x++) {
+        downsample_pixel_scalar(r0, r1, std::min(2 * x, src_width - 1), std::min(2 * x + 1, src_width - 1), row + x * 4);
+      }
+    }
+  }
+}
@@ -0,0 +1,88 @@
+#include <KvantEngine/util/ThreadPool.hpp>
+
+// C++ Headers
+#include <algorithm>
+
+namespace Kvant {
+
+  ThreadPool::ThreadPool (std::size_t threads) {
+    for (std::size_t i = 0; i < threads; i++) {
+      m_threads.emplace_back(&ThreadPool::worker_loop, this, i + 1);
+    }
+  }
+
+  ThreadPool::~ThreadPool () {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+    }
+    m_start_cv.notify_all();
+
+    for (auto& thread : m_threads) {
+      thread.join();
+    }
+  }
+
+  std::size_t ThreadPool::default_thread_count () {
+    auto hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 1 ? hardware_threads - 1 : 0;
+  }
+
+  void ThreadPool::parallel_for (std::size_t count, std::size_t min_batch, const RangeJob& job) {
+    if (count == 0) return;
+
+    // Not worth waking anyone up
+    if (m_threads.empty() || count <= min_batch) {
+      job(0, count, 0);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_job = &job;
+      m_count = count;
+      m_batch = std::max(min_batch, count / (4 * get_worker_count()));
+      m_next = 0;
+      m_busy_workers = m_threads.size();
+      ++m_generation;
+    }
+    m_start_cv.notify_all();
+
+    run_batches(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [this] { return m_busy_workers == 0; });
+    m_job = nullptr;
+  }
+
+  void ThreadPool::worker_loop (std::size_t worker) {
+    unsigned int generation = 0;
+
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_start_cv.wait(lock, [&] { return m_quit || m_generation != generation; });
+        if (m_quit) return;
+        generation = m_generation;
+      }
+
+      run_batches(worker);
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_busy_workers;
+      }
+      m_done_cv.notify_one();
+    }
+  }
+
+  void ThreadPool::run_batches (std::size_t worker) {
+    while (true) {
+      std::size_t begin = m_next.fetch_add(m_batch);
+      if (begin >= m_count) return;
+
+      std::size_t end = std::min(begin + m_batch, m_count);
+      (*m_job)(begin, end, worker);
+    }
+  }
+}
@@ -17,17 +17,18 @@
 #include <KvantEngine/CoreComponents/CMeshRenderer.hpp>
 #include <KvantEngine/CoreComponents/CControllable.hpp>
 #include <KvantEngine/CoreTypes/Vertex.hpp>
-#include <KvantEngine/CoreTypes/Shader.hpp>
+#include <KvantEngine/CoreTypes/ShaderProgram.hpp>
 
 namespace ex = entityx;
 using namespace Kvant;
 
 struct IntroState : public Kvant::State {
 
-  entityx::Entity create_triangle(float x, float y, float red, std::string file) {
+  entityx::Entity create_triangle(float x, float y, float red, const std::string& image,
+                                  const ResourceHandle& material) {
     auto e = get_entity_manager().create();
     e.assign<CNode>(x, y);
-    e.assign<CMaterial>( Shader{"../resources/shaders/default.vs", "../resources/shaders/default.frag"} );
+    e.assign<CMaterial>( m_material_resources.get(material) );
 
     using namespace glm;
 
@@ -37,6 +38,9 @@ struct IntroState : public Kvant::State {
     vertices.push_back( Vertex{vec3{0.5f, 0.5f, 0.0f}, vec3{red, 1, 0}, vec2{1.f, 0.f}} );
     vertices.push_back( Vertex{vec3{0.5f, -0.5f, 0.0f}, vec3{red, 1, 0}, vec2{1.f, 1.f}} );
 
+    // The image shares a page with the other sprites
+    if (auto region = get_atlas_region(image)) region->remap(vertices);
+
     vector<GLuint> indices;
     indices.push_back(0);
     indices.push_back(1);
@@ -45,20 +49,27 @@ struct IntroState : public Kvant::State {
     indices.push_back(2);
     indices.push_back(3);
 
-    vector<string> textures = {file};
-
-    e.assign<CMeshRenderer>(vertices, indices, textures);
+    // Fills unit 0 where the material has no texture, e.g. for texture arrays
+    e.assign<CMeshRenderer>(vertices, indices, vector<string>{image}, true);
     return e;
   }
 
   void on_init() override {
     spdlog::get("log")->info("Inside CIntroState");
 
-    m_texture_resources.add("C.png");
-    m_texture_resources.add("brick.png");
+    add_atlas("sprites.atlas.yaml");
+    add_texture_array("tiles.array.yaml");
+    m_sprite_material = add_material("sprite.yaml");
+    m_tile_material = add_material("sprite_array.yaml");
+    record_pipelines("intro");
+
+    auto e = create_triangle(0, 0, 1.0, "C.png", m_sprite_material);
+    auto e2 = create_triangle(0.5, 0.5, 0.0, "brick.png", m_sprite_material);
 
-    auto e = create_triangle(0, 0, 1.0, "C.png");
-    auto e2 = create_triangle(0.5, 0.5, 0.0, "brick.png");
+    // Instance of the same material, only the overrides are its own
+    auto brick = e2.component<CMaterial>();
+    brick->set_texture(0, "brick.png");
+    brick->set_param("tint", glm::vec4{1.0f, 0.8f, 0.8f, 1.0f});
 
     e.component<CNode>()->add_child(e2);
     e.component<CNode>()->name = "C++";
@@ -68,6 +79,10 @@ struct IntroState : public Kvant::State {
 
     add_to_layer (State::GameLayer::ORTHO, e);
     // add_to_layer(State::GameLayer::ORTHO, e2);
+
+    // Different layers of one array, drawn in a single batch
+    add_to_layer (State::GameLayer::ORTHO, create_triangle(-0.5, 0.5, 0.0, "butters.png", m_tile_material));
+    add_to_layer (State::GameLayer::ORTHO, create_triangle(-0.5, -0.5, 0.0, "brick.bmp", m_tile_material));
   }
 
   void on_cleanup() override {
@@ -85,4 +100,7 @@ struct IntroState : public Kvant::State {
   }
   void on_draw(const float) override {
   }
+
+  ResourceHandle m_sprite_material;
+  ResourceHandle m_tile_material;
 };
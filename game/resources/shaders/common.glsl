@@ -0,0 +1,7 @@
+// Shared by every stage, see UniformBlocks.hpp for the C++ side
+
+layout (std140) uniform FrameConstants {
+  mat4 projection;
+  mat4 camera;
+  float time;
+};
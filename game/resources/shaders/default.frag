@@ -3,8 +3,19 @@
 in vec3 ourColor;
 in vec2 tex_coord0;
 
-uniform float time;
+#include "common.glsl"
+
+#ifdef KVANT_TEXTURE_ARRAY
+// Layer picked per draw, see TextureArray
+flat in float layer0;
+uniform sampler2DArray sampler;
+#else
 uniform sampler2D sampler;
+#endif
+
+layout (std140) uniform MaterialParams {
+  vec4 tint;
+};
 
 out vec4 color;
 
@@ -13,8 +24,12 @@ float rand(vec2 co) {
 }
 
 void main() {
+#ifdef KVANT_TEXTURE_ARRAY
+  vec4 diffuse = texture (sampler, vec3(tex_coord0, layer0));
+#else
   vec4 diffuse = texture (sampler, tex_coord0);
+#endif
   if (diffuse.a == 0) discard;
 
-  color = diffuse * (cos(time)*cos(time)+sin(time)*sin(time));
+  color = tint * diffuse * (cos(time)*cos(time)+sin(time)*sin(time));
 }
@@ -1,19 +1,34 @@
 #version 330 core
+#include "common.glsl"
+
 layout (location = 0) in vec3 vertex_position;
 layout (location = 1) in vec3 vertex_color;
 layout (location = 2) in vec2 vertex_uv;
 
-uniform mat4 projection;
-uniform mat4 camera;
-uniform mat4 model;
-
-uniform float time;
+#ifdef KVANT_INDIRECT
+// Per draw data selected by the base instance, see GeometryPool
+layout (location = 3) in mat4 instance_model;
+layout (location = 7) in float instance_layer;
+#define model instance_model
+#define texture_layer instance_layer
+#else
+layout (std140) uniform ObjectConstants {
+  mat4 model;
+  float texture_layer;
+};
+#endif
 
 out vec3 ourColor;
 out vec2 tex_coord0;
+#ifdef KVANT_TEXTURE_ARRAY
+flat out float layer0;
+#endif
 
 void main() {
   gl_Position = projection * camera * model * vec4(vertex_position, 1.0f);
   ourColor = vertex_color;
   tex_coord0 = vertex_uv;
+#ifdef KVANT_TEXTURE_ARRAY
+  layer0 = texture_layer;
+#endif
 }
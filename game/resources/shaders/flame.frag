@@ -3,7 +3,8 @@
 in vec3 ourColor;
 in vec2 tex_coord0;
 
-uniform float time;
+#include "common.glsl"
+
 uniform sampler2D sampler;
 
 out vec4 color;
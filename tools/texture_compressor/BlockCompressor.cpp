@@ -0,0 +1,215 @@
+#include "BlockCompressor.hpp"
+
+// C++ Headers
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Kvant {
+
+  namespace {
+
+    /*! Extremes of the pixels along their principal axis, over the first channels
+     *
+     *  The axis is found by power iteration on the covariance matrix, which
+     *  converges in a few steps for the 16 pixels of a block.
+     */
+    void find_endpoints (const PixelBlock& pixels, int channels, float* low, float* high) {
+      float mean[4] = {0, 0, 0, 0};
+      for (int i = 0; i < 16; i++)
+        for (int c = 0; c < channels; c++) mean[c] += pixels[i][c] / 16.0f;
+
+      float covariance[4][4] = {};
+      for (int i = 0; i < 16; i++)
+        for (int a = 0; a < channels; a++)
+          for (int b = 0; b < channels; b++)
+            covariance[a][b] += (pixels[i][a] - mean[a]) * (pixels[i][b] - mean[b]);
+
+      float axis[4] = {1, 1, 1, 1};
+      for (int step = 0; step < 8; step++) {
+        float next[4] = {0, 0, 0, 0};
+        float length = 0;
+        for (int a = 0; a < channels; a++) {
+          for (int b = 0; b < channels; b++) next[a] += covariance[a][b] * axis[b];
+          length = std::max(length, std::fabs(next[a]));
+        }
+        // Flat block, any axis will do
+        if (length < 1e-6f) break;
+        for (int c = 0; c < channels; c++) axis[c] = next[c] / length;
+      }
+
+      float min_t = 0, max_t = 0;
+      float axis_length = 0;
+      for (int c = 0; c < channels; c++) axis_length += axis[c] * axis[c];
+      for (int i = 0; i < 16; i++) {
+        float t = 0;
+        for (int c = 0; c < channels; c++) t += (pixels[i][c] - mean[c]) * axis[c];
+        t /= axis_length;
+        min_t = std::min(min_t, t);
+        max_t = std::max(max_t, t);
+      }
+
+      for (int c = 0; c < channels; c++) {
+        low[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * min_t));
+        high[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * max_t));
+      }
+    }
+
+    int distance (const std::uint8_t* a, const int* b, int channels) {
+      int sum = 0;
+      for (int c = 0; c < channels; c++) sum += (a[c] - b[c]) * (a[c] - b[c]);
+      return sum;
+    }
+
+    std::uint16_t to_565 (const float* color) {
+      int r = std::lround(color[0] * 31 / 255.0f), g = std::lround(color[1] * 63 / 255.0f), b = std::lround(color[2] * 31 / 255.0f);
+      return r << 11 | g << 5 | b;
+    }
+
+    void from_565 (std::uint16_t value, int* color) {
+      int r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+      color[0] = r << 3 | r >> 2;
+      color[1] = g << 2 | g >> 4;
+      color[2] = b << 3 | b >> 2;
+    }
+
+    //! Little endian bit writer for the BC7 block
+    struct BitWriter {
+      std::uint8_t* out;
+      int position{0};
+
+      void write (unsigned int value, int bits) {
+        for (int i = 0; i < bits; i++, position++) {
+          if (value >> i & 1) out[position / 8] |= 1 << (position % 8);
+        }
+      }
+    };
+  }
+
+  void compress_bc1 (const PixelBlock& pixels, std::uint8_t* out) {
+    float low[4], high[4];
+    find_endpoints(pixels, 3, low, high);
+
+    std::uint16_t color0 = to_565(high), color1 = to_565(low);
+    // 4 color mode needs color0 > color1
+    if (color0 < color1) std::swap(color0, color1);
+
+    std::uint32_t indices = 0;
+    if (color0 != color1) {
+      int palette[4][3];
+      from_565(color0, palette[0]);
+      from_565(color1, palette[1]);
+      for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+      }
+
+      for (int i = 0; i < 16; i++) {
+        int best = 0, best_distance = distance(pixels[i], palette[0], 3);
+        for (int p = 1; p < 4; p++) {
+          int d = distance(pixels[i], palette[p], 3);
+          if (d < best_distance) { best = p; best_distance = d; }
+        }
+        indices |= best << (2 * i);
+      }
+    }
+
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++) out[4 + i] = indices >> (8 * i) & 0xFF;
+  }
+
+  void compress_bc3 (const PixelBlock& pixels, std::uint8_t* out) {
+    int alpha0 = 0, alpha1 = 255;
+    for (int i = 0; i < 16; i++) {
+      alpha0 = std::max<int>(alpha0, pixels[i][3]);
+      alpha1 = std::min<int>(alpha1, pixels[i][3]);
+    }
+
+    // alpha0 > alpha1 selects 8 interpolated values, equal ones only use index 0
+    std::uint64_t indices = 0;
+    if (alpha0 != alpha1) {
+      int palette[8];
+      palette[0] = alpha0;
+      palette[1] = alpha1;
+      for (int p = 2; p < 8; p++) palette[p] = ((8 - p) * alpha0 + (p - 1) * alpha1) / 7;
+
+      for (int i = 0; i < 16; i++) {
+        int best = 0;
+        for (int p = 1; p < 8; p++) {
+          if (std::abs(pixels[i][3] - palette[p]) < std::abs(pixels[i][3] - palette[best])) best = p;
+        }
+        indices |= (std::uint64_t)best << (3 * i);
+      }
+    }
+
+    out[0] = alpha0;
+    out[1] = alpha1;
+    for (int i = 0; i < 6; i++) out[2 + i] = indices >> (8 * i) & 0xFF;
+    compress_bc1(pixels, out + 8);
+  }
+
+  void compress_bc7 (const PixelBlock& pixels, std::uint8_t* out) {
+    static const int WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    float endpoints[2][4];
+    find_endpoints(pixels, 4, endpoints[0], endpoints[1]);
+
+    // Each endpoint is 7 bits per channel plus a low bit shared by its channels
+    int quantized[2][4], shared_bit[2], expanded[2][4];
+    for (int e = 0; e < 2; e++) {
+      float best_error = -1;
+      for (int p = 0; p < 2; p++) {
+        int values[4];
+        float error = 0;
+        for (int c = 0; c < 4; c++) {
+          values[c] = std::min(127, std::max(0, (int)std::lround((endpoints[e][c] - p) / 2.0f)));
+          float difference = (values[c] << 1 | p) - endpoints[e][c];
+          error += difference * difference;
+        }
+        if (best_error < 0 || error < best_error) {
+          best_error = error;
+          shared_bit[e] = p;
+          for (int c = 0; c < 4; c++) quantized[e][c] = values[c];
+        }
+      }
+      for (int c = 0; c < 4; c++) expanded[e][c] = quantized[e][c] << 1 | shared_bit[e];
+    }
+
+    int palette[16][4];
+    for (int p = 0; p < 16; p++)
+      for (int c = 0; c < 4; c++)
+        palette[p][c] = ((64 - WEIGHTS[p]) * expanded[0][c] + WEIGHTS[p] * expanded[1][c] + 32) >> 6;
+
+    int indices[16];
+    for (int i = 0; i < 16; i++) {
+      int best = 0, best_distance = distance(pixels[i], palette[0], 4);
+      for (int p = 1; p < 16; p++) {
+        int d = distance(pixels[i], palette[p], 4);
+        if (d < best_distance) { best = p; best_distance = d; }
+      }
+      indices[i] = best;
+    }
+
+    // The first index is stored without its top bit, which must be 0
+    if (indices[0] & 8) {
+      for (int c = 0; c < 4; c++) std::swap(quantized[0][c], quantized[1][c]);
+      std::swap(shared_bit[0], shared_bit[1]);
+      for (int i = 0; i < 16; i++) indices[i] = 15 - indices[i];
+    }
+
+    std::memset(out, 0, 16);
+    BitWriter writer{out};
+    writer.write(1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+      writer.write(quantized[0][c], 7);
+      writer.write(quantized[1][c], 7);
+    }
+    writer.write(shared_bit[0], 1);
+    writer.write(shared_bit[1], 1);
+    writer.write(indices[0], 3);
+    for (int i = 1; i < 16; i++) writer.write(indices[i], 4);
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// C++ Headers
+#include <cstdint>
+
+namespace Kvant {
+
+  //! 4x4 RGBA8 pixels, rows top to bottom
+  using PixelBlock = std::uint8_t[16][4];
+
+  /*! Encodes one block as BC1 (DXT1), 8 bytes, opaque
+   *
+   *  Endpoints are the extremes of the colors along their principal axis,
+   *  always in the 4 color mode so alpha is ignored.
+   */
+  void compress_bc1 (const PixelBlock& pixels, std::uint8_t* out);
+
+  //! Encodes one block as BC3 (DXT5), 16 bytes, interpolated alpha followed by BC1 color
+  void compress_bc3 (const PixelBlock& pixels, std::uint8_t* out);
+
+  /*! Encodes one block as BC7 (BPTC), 16 bytes
+   *
+   *  Only uses mode 6, a single subset with RGBA endpoints of 7 bits plus a
+   *  shared bit and 16 interpolation steps. Good for smooth images and
+   *  alpha, blocks holding two distinct colors look better with a full
+   *  BC7 encoder that searches the partitioned modes.
+   */
+  void compress_bc7 (const PixelBlock& pixels, std::uint8_t* out);
+}
@@ -0,0 +1,171 @@
+// Converts images to block compressed KTX files the engine loads directly
+//
+//   kvant_texture_compressor [--format auto|bc1|bc3|bc7] input.png [output.ktx]
+//
+// auto picks BC1 for opaque images and BC3 for the rest. Every mip level
+// down to 1x1 is filtered in linear space, weighted by alpha, and compressed.
+
+// c++ standard libraries
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// SDL2 Headers
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <KvantEngine/util/PixelKernels.hpp>
+
+#include "BlockCompressor.hpp"
+
+using namespace Kvant;
+namespace fs = boost::filesystem;
+
+// Same values as the GL enums, so the tool doesn't need GL headers
+enum : std::uint32_t {
+  GL_RGB = 0x1907,
+  GL_RGBA = 0x1908,
+  GL_COMPRESSED_RGB_S3TC_DXT1_EXT = 0x83F0,
+  GL_COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3,
+  GL_COMPRESSED_RGBA_BPTC_UNORM = 0x8E8C
+};
+
+struct Image {
+  int width, height;
+  std::vector<std::uint8_t> pixels;
+};
+
+struct Format {
+  std::string name;
+  std::uint32_t internal_format, base_internal_format;
+  std::size_t block_bytes;
+  void (*compress) (const PixelBlock&, std::uint8_t*);
+};
+
+const Format FORMATS[] = {
+  {"bc1", GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_RGB, 8, compress_bc1},
+  {"bc3", GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_RGBA, 16, compress_bc3},
+  {"bc7", GL_COMPRESSED_RGBA_BPTC_UNORM, GL_RGBA, 16, compress_bc7}
+};
+
+bool load_image (const std::string& file, Image& image) {
+  SDL_Surface* surface = IMG_Load(file.c_str());
+  if (!surface) {
+    std::cerr << "Failed to load " << file << ": " << IMG_GetError() << std::endl;
+    return false;
+  }
+  SDL_Surface* rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+  SDL_FreeSurface(surface);
+  if (!rgba) {
+    std::cerr << "Failed to convert " << file << ": " << SDL_GetError() << std::endl;
+    return false;
+  }
+
+  image.width = rgba->w;
+  image.height = rgba->h;
+  image.pixels.resize(image.width * image.height * 4);
+  SDL_LockSurface(rgba);
+  for (int y = 0; y < rgba->h; y++) {
+    std::memcpy(&image.pixels[y * image.width * 4], static_cast<std::uint8_t*>(rgba->pixels) + y * rgba->pitch, image.width * 4);
+  }
+  SDL_UnlockSurface(rgba);
+  SDL_FreeSurface(rgba);
+  return true;
+}
+
+// Filtered like the engine's build_mip_chain, so compressed and decoded textures get the same mips
+Image downsample (const Image& source) {
+  Image level{std::max(1, source.width / 2), std::max(1, source.height / 2), {}};
+  level.pixels.resize(level.width * level.height * 4);
+  downsample_srgb(source.pixels.data(), source.width, source.height, level.pixels.data(), level.width, level.height);
+  return level;
+}
+
+std::vector<std::uint8_t> compress (const Image& image, const Format& format) {
+  int blocks_x = (image.width + 3) / 4, blocks_y = (image.height + 3) / 4;
+  std::vector<std::uint8_t> data(blocks_x * blocks_y * format.block_bytes);
+
+  for (int by = 0; by < blocks_y; by++) {
+    for (int bx = 0; bx < blocks_x; bx++) {
+      // Blocks past the edge repeat the last row and column
+      PixelBlock block;
+      for (int i = 0; i < 16; i++) {
+        int x = std::min(bx * 4 + i % 4, image.width - 1), y = std::min(by * 4 + i / 4, image.height - 1);
+        std::memcpy(block[i], &image.pixels[(y * image.width + x) * 4], 4);
+      }
+      format.compress(block, &data[(by * blocks_x + bx) * format.block_bytes]);
+    }
+  }
+  return data;
+}
+
+bool write_ktx (const std::string& file, const Format& format, const std::vector<Image>& levels) {
+  std::ofstream stream(file, std::ios::binary);
+  if (!stream) {
+    std::cerr << "Failed to open " << file << " for writing" << std::endl;
+    return false;
+  }
+
+  const std::uint8_t identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+  const std::uint32_t header[13] = {
+    0x04030201,
+    0, 1, 0,  // type, type size and format are unused for compressed data
+    format.internal_format, format.base_internal_format,
+    (std::uint32_t)levels[0].width, (std::uint32_t)levels[0].height, 0,
+    0, 1, (std::uint32_t)levels.size(),
+    0         // no key/value data
+  };
+  stream.write(reinterpret_cast<const char*>(identifier), sizeof(identifier));
+  stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+  for (auto& level : levels) {
+    auto data = compress(level, format);
+    std::uint32_t size = data.size();
+    stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+  }
+  return bool(stream);
+}
+
+int main (int argc, char** argv) {
+  std::string format_name = "auto";
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--format" && i + 1 < argc) format_name = argv[++i];
+    else files.push_back(arg);
+  }
+  if (files.empty() || files.size() > 2) {
+    std::cerr << "Usage: " << argv[0] << " [--format auto|bc1|bc3|bc7] input.png [output.ktx]" << std::endl;
+    return 1;
+  }
+
+  Image image;
+  if (!load_image(files[0], image)) return 1;
+
+  if (format_name == "auto") {
+    bool opaque = true;
+    for (std::size_t i = 3; i < image.pixels.size() && opaque; i += 4) opaque = image.pixels[i] == 255;
+    format_name = opaque ? "bc1" : "bc3";
+  }
+  auto format = std::find_if(std::begin(FORMATS), std::end(FORMATS), [&] (const Format& f) { return f.name == format_name; });
+  if (format == std::end(FORMATS)) {
+    std::cerr << "Unknown format " << format_name << std::endl;
+    return 1;
+  }
+
+  std::vector<Image> levels{image};
+  while (levels.back().width > 1 || levels.back().height > 1) levels.push_back(downsample(levels.back()));
+
+  std::string output = files.size() > 1 ? files[1] : fs::path(files[0]).replace_extension(".ktx").string();
+  if (!write_ktx(output, *format, levels)) return 1;
+
+  std::cout << files[0] << " -> " << output << " (" << format->name << ", " << levels.size() << " levels)" << std::endl;
+  return 0;
+}